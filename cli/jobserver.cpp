@@ -0,0 +1,177 @@
+#include "jobserver.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <cstdio>
+
+#include "subdivision/subdivider.h"
+
+/**
+ * @brief JobServer::JobServer Creates a new job server.
+ * @param maxJobs The maximum number of jobs that run at the same time.
+ * @param threadsPerJob The number of threads every job may use to parse and
+ * initialize its mesh.
+ * @param memoryLimit The predicted memory, in bytes, above which a job is
+ * refused; 0 for no limit.
+ */
+JobServer::JobServer(int maxJobs, int threadsPerJob, qint64 memoryLimit)
+    : freeSlots(2 * maxJobs),
+      threadsPerJob(threadsPerJob),
+      memoryLimit(memoryLimit),
+      numSubmitted(0),
+      numFailed(0) {
+  pool.setMaxThreadCount(maxJobs);
+  output.open(stdout, QIODevice::WriteOnly);
+}
+
+/**
+ * @brief JobServer::~JobServer Deconstructor. Waits for all running jobs.
+ */
+JobServer::~JobServer() { pool.waitForDone(); }
+
+/**
+ * @brief JobServer::exec Reads and runs jobs until the standard input is
+ * closed, then waits for the remaining jobs to finish.
+ * @return Exit code; 0 if all jobs succeeded and 1 otherwise.
+ */
+int JobServer::exec() {
+  QElapsedTimer timer;
+  timer.start();
+
+  QFile input;
+  input.open(stdin, QIODevice::ReadOnly);
+  int lineNumber = 0;
+  while (true) {
+    QByteArray line = input.readLine();
+    if (line.isEmpty()) {
+      break;
+    }
+    lineNumber++;
+    if (!line.trimmed().isEmpty()) {
+      submit(line, lineNumber);
+    }
+  }
+  pool.waitForDone();
+
+  report(QJsonObject{{"status", "finished"},
+                     {"jobs", numSubmitted},
+                     {"failed", numFailed.load()},
+                     {"totalMs", timer.nsecsElapsed() / 1.0e6}});
+  return numFailed.load() == 0 ? 0 : 1;
+}
+
+/**
+ * @brief JobServer::submit Parses a job line and queues the job. Blocks while
+ * too many jobs are waiting.
+ * @param line The line containing the job.
+ * @param lineNumber Number of the line, used to report invalid jobs.
+ */
+void JobServer::submit(const QByteArray& line, int lineNumber) {
+  SubdivisionJob job;
+  QString error;
+  numSubmitted++;
+  if (!parseJob(line, job, error)) {
+    numFailed++;
+    report(QJsonObject{
+        {"status", "rejected"}, {"line", lineNumber}, {"error", error}});
+    return;
+  }
+  if (job.id.isEmpty()) {
+    job.id = QString::number(numSubmitted);
+  }
+  report(QJsonObject{{"id", job.id}, {"status", "queued"}});
+
+  freeSlots.acquire();
+  pool.start([this, job]() {
+    runJob(job);
+    freeSlots.release();
+  });
+}
+
+/**
+ * @brief JobServer::parseJob Reads a job from a JSON line.
+ * @param line The line containing the job.
+ * @param job Is set to the parsed job.
+ * @param error Is set to the reason the line is invalid.
+ * @return True if the line contains a valid job; false otherwise.
+ */
+bool JobServer::parseJob(const QByteArray& line, SubdivisionJob& job,
+                         QString& error) const {
+  QJsonParseError parseError;
+  QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+  if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+    error = "invalid JSON";
+    return false;
+  }
+  QJsonObject object = document.object();
+  QJsonValue id = object.value("id");
+  job.id = id.isDouble() ? QString::number(id.toInteger()) : id.toString();
+  job.input = object.value("input").toString();
+  job.output = object.value("output").toString();
+  job.format = object.value("format").toString();
+  job.levels = object.value("levels").toInt(1);
+  job.normals = object.value("normals").toBool(false);
+  job.adaptiveTolerance = float(object.value("adaptive").toDouble(0.0));
+  job.blocked = object.value("blocked").toBool(false);
+  job.numThreads = threadsPerJob;
+  job.memoryLimit = memoryLimit;
+  if (job.input.isEmpty()) {
+    error = "missing input";
+    return false;
+  }
+  // Levels that overflow the mesh indices for this particular mesh, or that
+  // exceed the memory limit, are refused by the runner once it is loaded.
+  if (job.levels < 0 || job.levels > MAX_SUBDIVISION_LEVELS) {
+    error = "invalid number of levels";
+    return false;
+  }
+  if (job.adaptiveTolerance < 0.0f) {
+    error = "invalid adaptive tolerance";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief JobServer::runJob Runs a single job and reports its outcome. Called
+ * from the worker threads.
+ * @param job The job to run.
+ */
+void JobServer::runJob(const SubdivisionJob& job) {
+  report(QJsonObject{{"id", job.id}, {"status", "running"}});
+  SubdivisionResult result = runner.run(job);
+
+  QJsonArray stages;
+  for (const QPair<QString, double>& stage : result.stageMilliseconds) {
+    stages.append(QJsonObject{{"stage", stage.first}, {"ms", stage.second}});
+  }
+  QJsonObject message{{"id", job.id},
+                      {"stages", stages},
+                      {"totalMs", result.totalMilliseconds}};
+  if (result.success) {
+    message["status"] = "done";
+    message["vertices"] = result.numVertices;
+    message["edges"] = result.numEdges;
+    message["faces"] = result.numFaces;
+  } else {
+    numFailed++;
+    message["status"] = "failed";
+    message["error"] = result.error;
+  }
+  report(message);
+}
+
+/**
+ * @brief JobServer::report Writes a status message as a single JSON line.
+ * Safe to call from multiple threads.
+ * @param message The message to write.
+ */
+void JobServer::report(const QJsonObject& message) {
+  QByteArray line = QJsonDocument(message).toJson(QJsonDocument::Compact);
+  line.append('\n');
+  QMutexLocker locker(&outputMutex);
+  output.write(line);
+  output.flush();
+}
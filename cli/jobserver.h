@@ -0,0 +1,53 @@
+#ifndef JOB_SERVER_H
+#define JOB_SERVER_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <atomic>
+
+#include "subdivisionjob.h"
+
+/**
+ * @brief The JobServer class reads subdivision jobs as JSON lines from the
+ * standard input and runs them on a bounded pool of worker threads. Status
+ * updates and timings are written as JSON lines to the standard output as
+ * soon as they are known, so results arrive in order of completion.
+ *
+ * A job line looks like
+ * {"id": "a", "input": "in.obj", "levels": 3, "output": "out.ply",
+ *  "format": "ply", "normals": true, "adaptive": 0.001, "blocked": false}
+ * where only "input" is required. Jobs whose result would not fit in the mesh
+ * indices or in the memory limit fail with an error of their own, before any
+ * subdivision is done, so they cannot take down the other jobs.
+ */
+class JobServer {
+ public:
+  JobServer(int maxJobs, int threadsPerJob, qint64 memoryLimit = 0);
+  ~JobServer();
+
+  int exec();
+
+ private:
+  void submit(const QByteArray& line, int lineNumber);
+  bool parseJob(const QByteArray& line, SubdivisionJob& job,
+                QString& error) const;
+  void runJob(const SubdivisionJob& job);
+  void report(const QJsonObject& message);
+
+  QThreadPool pool;
+  // Limits the number of jobs that have been read but not finished, so that
+  // a long job list is not read into memory at once.
+  QSemaphore freeSlots;
+  QMutex outputMutex;
+  QFile output;
+  SubdivisionJobRunner runner;
+  int threadsPerJob;
+  qint64 memoryLimit;
+  int numSubmitted;
+  std::atomic<int> numFailed;
+};
+
+#endif  // JOB_SERVER_H
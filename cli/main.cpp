@@ -0,0 +1,151 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QThread>
+#include <climits>
+
+#include "jobserver.h"
+#include "subdivision/subdivider.h"
+#include "subdivisionjob.h"
+
+/**
+ * @brief reportStage Prints the time spent in a stage.
+ * @param out The stream to print to.
+ * @param stage Name of the stage.
+ * @param milliseconds The time spent in the stage.
+ */
+static void reportStage(QTextStream& out, const QString& stage,
+                        double milliseconds) {
+  out << QString("%1 %2 ms").arg(stage, -24).arg(milliseconds, 10, 'f', 3)
+      << Qt::endl;
+}
+
+/**
+ * @brief main Subdivides a single mesh, or runs a job server that reads jobs
+ * from the standard input, without creating any windows or OpenGL contexts.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return Exit code.
+ */
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("loopsubdiv-cli");
+  QCoreApplication::setApplicationVersion("1.0");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Applies Loop subdivision to a mesh.");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addPositionalArgument("input",
+                               "Mesh to subdivide (.obj, .ply, .stl or "
+                               ".hemesh).");
+  QCommandLineOption levelsOption(QStringList{"l", "levels"},
+                                  "Number of subdivision steps.", "levels",
+                                  "1");
+  QCommandLineOption outputOption(
+      QStringList{"o", "output"},
+      "Writes the result to <file> (.ply, .glb, .obj or .hemesh).", "file");
+  QCommandLineOption normalsOption(
+      QStringList{"n", "normals"},
+      "Recomputes the vertex normals of the result and includes them in the "
+      "output.");
+  QCommandLineOption adaptiveOption(
+      QStringList{"a", "adaptive"},
+      "Refines only the faces that deviate more than <tolerance> from the "
+      "limit surface, up to the given number of levels.",
+      "tolerance", "0");
+  QCommandLineOption blockedOption(
+      QStringList{"b", "blocked"},
+      "Subdivides depth-first in cache-sized blocks, without keeping the "
+      "intermediate levels in memory.");
+  QCommandLineOption memoryLimitOption(
+      QStringList{"m", "memory-limit"},
+      "Refuses to subdivide when the result is predicted to need more than "
+      "<MB> megabytes (per job with --serve); 0 means no limit.",
+      "MB", "0");
+  QCommandLineOption threadsOption(
+      QStringList{"t", "threads"},
+      "Number of threads per mesh; 0 uses all cores, or an equal share of "
+      "them per job in server mode.",
+      "threads", "0");
+  QCommandLineOption serveOption(
+      "serve",
+      "Reads jobs as JSON lines from the standard input and reports their "
+      "progress as JSON lines on the standard output.");
+  QCommandLineOption jobsOption(
+      QStringList{"j", "jobs"},
+      "Number of jobs that run at the same time in server mode; 0 uses one "
+      "per core.",
+      "jobs", "0");
+  parser.addOption(levelsOption);
+  parser.addOption(outputOption);
+  parser.addOption(normalsOption);
+  parser.addOption(adaptiveOption);
+  parser.addOption(blockedOption);
+  parser.addOption(memoryLimitOption);
+  parser.addOption(threadsOption);
+  parser.addOption(serveOption);
+  parser.addOption(jobsOption);
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  bool levelsValid, adaptiveValid, memoryLimitValid, threadsValid, jobsValid;
+  int levels = parser.value(levelsOption).toInt(&levelsValid);
+  float adaptiveTolerance =
+      parser.value(adaptiveOption).toFloat(&adaptiveValid);
+  qint64 memoryLimit =
+      parser.value(memoryLimitOption).toLongLong(&memoryLimitValid);
+  int numThreads = parser.value(threadsOption).toInt(&threadsValid);
+  int maxJobs = parser.value(jobsOption).toInt(&jobsValid);
+  if (!levelsValid || levels < 0 || levels > MAX_SUBDIVISION_LEVELS ||
+      !adaptiveValid || adaptiveTolerance < 0.0f || !memoryLimitValid ||
+      memoryLimit < 0 || memoryLimit > (LLONG_MAX >> 20) || !threadsValid ||
+      !jobsValid) {
+    err << "Invalid number of levels, tolerance, memory limit, threads or jobs"
+        << Qt::endl;
+    return 1;
+  }
+
+  if (parser.isSet(serveOption)) {
+    int numCores = QThread::idealThreadCount();
+    if (maxJobs < 1) {
+      maxJobs = numCores;
+    }
+    if (numThreads < 1) {
+      numThreads = qMax(1, numCores / maxJobs);
+    }
+    JobServer server(maxJobs, numThreads, memoryLimit << 20);
+    return server.exec();
+  }
+
+  const QStringList arguments = parser.positionalArguments();
+  if (arguments.size() != 1) {
+    parser.showHelp(1);
+  }
+
+  SubdivisionJob job;
+  job.input = arguments[0];
+  job.output = parser.value(outputOption);
+  job.levels = levels;
+  job.normals = parser.isSet(normalsOption);
+  job.adaptiveTolerance = adaptiveTolerance;
+  job.blocked = parser.isSet(blockedOption);
+  job.numThreads = numThreads;
+  job.memoryLimit = memoryLimit << 20;
+
+  SubdivisionJobRunner runner;
+  SubdivisionResult result = runner.run(job);
+  for (const QPair<QString, double>& stage : result.stageMilliseconds) {
+    reportStage(out, stage.first, stage.second);
+  }
+  if (!result.success) {
+    err << "Failed: " << result.error << Qt::endl;
+    return 1;
+  }
+  out << "result: " << result.numVertices << " vertices, " << result.numEdges
+      << " edges, " << result.numFaces << " faces" << Qt::endl;
+  reportStage(out, "total", result.totalMilliseconds);
+  return 0;
+}
@@ -0,0 +1,216 @@
+#include "subdivisionjob.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <climits>
+
+#include "exporters/meshexporter.h"
+#include "initialization/meshcache.h"
+#include "initialization/meshfile.h"
+#include "initialization/meshinitializer.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/blockedsubdivider.h"
+#include "subdivision/loopsubdivider.h"
+
+/**
+ * @brief finishStage Records the time spent in a stage and restarts the timer
+ * for the next stage.
+ * @param result The result to record the time in.
+ * @param stage Name of the stage.
+ * @param timer Timer that was started at the beginning of the stage.
+ */
+static void finishStage(SubdivisionResult& result, const QString& stage,
+                        QElapsedTimer& timer) {
+  result.stageMilliseconds.append({stage, timer.nsecsElapsed() / 1.0e6});
+  timer.restart();
+}
+
+/**
+ * @brief outputSuffix Determines the extension of the output format of a job.
+ * @param job The job.
+ * @return The extension of the output format, e.g. "ply".
+ */
+static QString outputSuffix(const SubdivisionJob& job) {
+  QString suffix =
+      job.format.isEmpty() ? QFileInfo(job.output).suffix() : job.format;
+  return suffix.toLower();
+}
+
+/**
+ * @brief SubdivisionJobRunner::SubdivisionJobRunner Creates a new job runner.
+ */
+SubdivisionJobRunner::SubdivisionJobRunner() {}
+
+/**
+ * @brief SubdivisionJobRunner::run Loads the mesh of the job, subdivides it,
+ * optionally recomputes the normals and writes the result.
+ * @param job The job to run.
+ * @return The outcome of the job, including the time spent in every stage.
+ */
+SubdivisionResult SubdivisionJobRunner::run(const SubdivisionJob& job) const {
+  SubdivisionResult result;
+  QElapsedTimer totalTimer;
+  totalTimer.start();
+
+  // Reject unsupported formats before doing any of the work.
+  MeshExporter::Format format;
+  if (!job.output.isEmpty() && outputSuffix(job) != "hemesh" &&
+      !MeshExporter::formatFromSuffix(outputSuffix(job), format)) {
+    result.error = "unsupported output format " + outputSuffix(job);
+    return result;
+  }
+
+  Mesh mesh;
+  if (loadMesh(job, mesh, result) && checkSize(job, mesh, result)) {
+    QElapsedTimer timer;
+    timer.start();
+    if (job.adaptiveTolerance > 0.0f) {
+      AdaptiveSubdivider subdivider;
+      subdivider.setNumThreads(job.numThreads);
+      subdivider.setMaxLevel(job.levels);
+      subdivider.setFlatnessTolerance(job.adaptiveTolerance);
+      mesh = subdivider.subdivide(mesh);
+      finishStage(result, "adaptive subdivision", timer);
+    } else if (job.blocked) {
+      BlockedSubdivider subdivider;
+      subdivider.setNumThreads(job.numThreads);
+      subdivider.setLevels(job.levels);
+      mesh = subdivider.subdivide(mesh);
+      finishStage(result, "blocked subdivision", timer);
+    } else {
+      LoopSubdivider subdivider;
+      subdivider.setNumThreads(job.numThreads);
+      for (int k = 1; k <= job.levels; k++) {
+        mesh = subdivider.subdivide(mesh);
+        finishStage(result, QString("subdivide level %1").arg(k), timer);
+      }
+    }
+    if (job.normals) {
+      mesh.recalculateNormals();
+      finishStage(result, "recalculate normals", timer);
+    }
+    result.numVertices = mesh.numVerts();
+    result.numEdges = mesh.numEdges();
+    result.numFaces = mesh.numFaces();
+    result.success = job.output.isEmpty() || saveMesh(job, mesh, result);
+  }
+
+  result.totalMilliseconds = totalTimer.nsecsElapsed() / 1.0e6;
+  return result;
+}
+
+/**
+ * @brief SubdivisionJobRunner::loadMesh Loads the input mesh of the job from a
+ * mesh file or a binary mesh cache.
+ * @param job The job.
+ * @param mesh Is set to the loaded mesh.
+ * @param result The result to record the timings or the error in.
+ * @return True if the mesh was loaded successfully; false otherwise.
+ */
+bool SubdivisionJobRunner::loadMesh(const SubdivisionJob& job, Mesh& mesh,
+                                    SubdivisionResult& result) const {
+  QElapsedTimer timer;
+  timer.start();
+  if (QFileInfo(job.input).suffix().toLower() == "hemesh") {
+    MeshCache meshCache;
+    if (!meshCache.load(job.input, mesh)) {
+      result.error = "could not load " + job.input;
+      return false;
+    }
+    finishStage(result, "load cache", timer);
+    return true;
+  }
+
+  // Unlike the viewer, keep the coordinates of the file.
+  std::unique_ptr<MeshFile> meshFile =
+      MeshFile::open(job.input, job.numThreads, false);
+  if (!meshFile || !meshFile->loadedSuccessfully()) {
+    result.error = "could not load " + job.input;
+    return false;
+  }
+  finishStage(result, "read file", timer);
+
+  MeshInitializer meshInitializer;
+  meshInitializer.setNumThreads(job.numThreads);
+  mesh = meshInitializer.constructHalfEdgeMesh(*meshFile);
+  finishStage(result, "build half-edge mesh", timer);
+  return true;
+}
+
+/**
+ * @brief SubdivisionJobRunner::checkSize Checks whether the result of a job
+ * can be represented and fits in its memory limit, before any subdivision is
+ * done. The uniformly subdivided mesh is an upper bound for all subdivision
+ * modes; level by level, its parent is kept in memory along with it.
+ * @param job The job.
+ * @param mesh The loaded mesh.
+ * @param result The result to record the error in.
+ * @return True if the job can be run; false otherwise.
+ */
+bool SubdivisionJobRunner::checkSize(const SubdivisionJob& job,
+                                     const Mesh& mesh,
+                                     SubdivisionResult& result) const {
+  if (job.levels == 0) {
+    return true;
+  }
+  LoopSubdivider::ElementCounts counts =
+      LoopSubdivider::predictCounts(mesh, job.levels);
+  if (counts.numHalfEdges > INT_MAX) {
+    result.error = QString("%1 levels exceed the maximum mesh size")
+                       .arg(job.levels);
+    return false;
+  }
+  qint64 required = Mesh::predictFootprint(
+      counts.numVertices, counts.numHalfEdges, counts.numFaces, true);
+  if (job.levels == 1) {
+    required += mesh.memoryFootprint();
+  } else {
+    LoopSubdivider::ElementCounts parentCounts =
+        LoopSubdivider::predictCounts(mesh, job.levels - 1);
+    required +=
+        Mesh::predictFootprint(parentCounts.numVertices,
+                               parentCounts.numHalfEdges,
+                               parentCounts.numFaces, true);
+  }
+  if (job.memoryLimit > 0 && required > job.memoryLimit) {
+    result.error = QString("%1 levels need about %2 MB, the limit is %3 MB")
+                       .arg(job.levels)
+                       .arg(required >> 20)
+                       .arg(job.memoryLimit >> 20);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief SubdivisionJobRunner::saveMesh Writes the subdivided mesh in the
+ * requested format.
+ * @param job The job.
+ * @param mesh The subdivided mesh.
+ * @param result The result to record the timings or the error in.
+ * @return True if the mesh was written successfully; false otherwise.
+ */
+bool SubdivisionJobRunner::saveMesh(const SubdivisionJob& job, Mesh& mesh,
+                                    SubdivisionResult& result) const {
+  QElapsedTimer timer;
+  timer.start();
+  QString suffix = outputSuffix(job);
+  bool success;
+  MeshExporter::Format format;
+  if (suffix == "hemesh") {
+    success = MeshCache().save(mesh, job.output);
+  } else if (MeshExporter::formatFromSuffix(suffix, format)) {
+    MeshExporter exporter;
+    exporter.setIncludeNormals(job.normals);
+    success = exporter.save(mesh, job.output, format);
+  } else {
+    result.error = "unsupported output format " + suffix;
+    return false;
+  }
+  if (!success) {
+    result.error = "could not write " + job.output;
+    return false;
+  }
+  finishStage(result, "write output", timer);
+  return true;
+}
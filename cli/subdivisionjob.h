@@ -0,0 +1,70 @@
+#ifndef SUBDIVISION_JOB_H
+#define SUBDIVISION_JOB_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The SubdivisionJob struct describes a single batch job: the mesh to
+ * load, the number of subdivision steps and where to write the result.
+ */
+struct SubdivisionJob {
+  QString id;
+  QString input;
+  // The result is not written if the output is empty.
+  QString output;
+  // Extension of the output format, e.g. "ply". Empty to use the extension of
+  // the output file.
+  QString format;
+  int levels = 1;
+  bool normals = false;
+  // Flatness tolerance of adaptive subdivision, which then refines faces up
+  // to the given number of levels; 0 subdivides uniformly.
+  float adaptiveTolerance = 0.0f;
+  // Subdivides depth-first in cache-sized blocks instead of level by level,
+  // which never holds an intermediate level in memory.
+  bool blocked = false;
+  // Threads used to parse, initialize and subdivide the mesh; 0 uses all
+  // cores.
+  int numThreads = 0;
+  // Jobs whose result is predicted to need more memory than this, in bytes,
+  // are refused; 0 for no limit.
+  qint64 memoryLimit = 0;
+};
+
+/**
+ * @brief The SubdivisionResult struct holds the outcome of a job and the time
+ * spent in every stage.
+ */
+struct SubdivisionResult {
+  bool success = false;
+  QString error;
+  int numVertices = 0;
+  int numEdges = 0;
+  int numFaces = 0;
+  QVector<QPair<QString, double>> stageMilliseconds;
+  double totalMilliseconds = 0.0;
+};
+
+/**
+ * @brief The SubdivisionJobRunner class runs subdivision jobs. It holds no
+ * state, so a single runner can be used by multiple threads at once.
+ */
+class SubdivisionJobRunner {
+ public:
+  SubdivisionJobRunner();
+  SubdivisionResult run(const SubdivisionJob& job) const;
+
+ private:
+  bool loadMesh(const SubdivisionJob& job, Mesh& mesh,
+                SubdivisionResult& result) const;
+  bool checkSize(const SubdivisionJob& job, const Mesh& mesh,
+                 SubdivisionResult& result) const;
+  bool saveMesh(const SubdivisionJob& job, Mesh& mesh,
+                SubdivisionResult& result) const;
+};
+
+#endif  // SUBDIVISION_JOB_H
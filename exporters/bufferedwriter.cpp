@@ -0,0 +1,89 @@
+#include "bufferedwriter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+/**
+ * @brief BufferedWriter::BufferedWriter Creates a writer for the provided
+ * device.
+ * @param device An opened device to write to.
+ * @param bufferSize Size of the buffer in bytes.
+ */
+BufferedWriter::BufferedWriter(QIODevice* device, qint64 bufferSize)
+    : device(device), buffer(bufferSize), used(0), error(false) {}
+
+/**
+ * @brief BufferedWriter::~BufferedWriter Deconstructor. Writes the remaining
+ * contents of the buffer.
+ */
+BufferedWriter::~BufferedWriter() { flush(); }
+
+/**
+ * @brief BufferedWriter::write Writes a block of data. Blocks larger than the
+ * buffer are passed on to the device directly.
+ * @param data The data to write.
+ * @param size Size of the data in bytes.
+ */
+void BufferedWriter::write(const char* data, qint64 size) {
+  if (size > qint64(buffer.size())) {
+    flush();
+    error = error || device->write(data, size) != size;
+    return;
+  }
+  std::memcpy(reserve(size), data, size);
+}
+
+/**
+ * @brief BufferedWriter::write Writes the contents of a byte array.
+ * @param data The data to write.
+ */
+void BufferedWriter::write(const QByteArray& data) {
+  write(data.constData(), data.size());
+}
+
+/**
+ * @brief BufferedWriter::writeZeros Writes a number of zero bytes, e.g. for
+ * padding.
+ * @param size Number of bytes to write.
+ */
+void BufferedWriter::writeZeros(qint64 size) {
+  while (size > 0) {
+    qint64 blockSize = std::min(size, qint64(buffer.size()));
+    std::memset(reserve(blockSize), 0, blockSize);
+    size -= blockSize;
+  }
+}
+
+/**
+ * @brief BufferedWriter::writeInt Writes an integer in decimal notation.
+ * @param value The value to write.
+ */
+void BufferedWriter::writeInt(qint64 value) {
+  char digits[24];
+  char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+  write(digits, end - digits);
+}
+
+/**
+ * @brief BufferedWriter::writeFloat Writes a float in the shortest notation
+ * that reads back to the same value.
+ * @param value The value to write.
+ */
+void BufferedWriter::writeFloat(float value) {
+  char digits[32];
+  char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+  write(digits, end - digits);
+}
+
+/**
+ * @brief BufferedWriter::flush Hands the contents of the buffer to the device.
+ * @return True if no write has failed so far; false otherwise.
+ */
+bool BufferedWriter::flush() {
+  if (used > 0) {
+    error = error || device->write(buffer.data(), used) != used;
+    used = 0;
+  }
+  return !error;
+}
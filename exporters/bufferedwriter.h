@@ -0,0 +1,73 @@
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <QIODevice>
+#include <QtEndian>
+#include <vector>
+
+// Size of the buffer that is filled before anything is handed to the device.
+#define DEFAULT_WRITE_BUFFER_SIZE (8 << 20)
+
+/**
+ * @brief The BufferedWriter class collects small writes in a large buffer and
+ * hands the buffer to the device in big blocks. Numbers are formatted in
+ * place, without any temporary strings.
+ */
+class BufferedWriter {
+ public:
+  BufferedWriter(QIODevice* device,
+                 qint64 bufferSize = DEFAULT_WRITE_BUFFER_SIZE);
+  ~BufferedWriter();
+
+  void write(const char* data, qint64 size);
+  void write(const QByteArray& data);
+  void writeZeros(qint64 size);
+  void writeInt(qint64 value);
+  void writeFloat(float value);
+  bool flush();
+
+  /**
+   * @brief BufferedWriter::writeChar Writes a single character.
+   * @param c The character to write.
+   */
+  inline void writeChar(char c) { *reserve(1) = c; }
+
+  /**
+   * @brief BufferedWriter::writeLittleEndian Writes a value in little endian
+   * byte order.
+   * @param value The value to write.
+   */
+  template <typename T>
+  inline void writeLittleEndian(T value) {
+    qToLittleEndian(value, reserve(sizeof(T)));
+  }
+
+  /**
+   * @brief BufferedWriter::hasError Checks whether any write to the device
+   * failed.
+   * @return True if data was lost; false otherwise.
+   */
+  inline bool hasError() const { return error; }
+
+ private:
+  /**
+   * @brief BufferedWriter::reserve Makes room for size bytes in the buffer.
+   * @param size Number of bytes to reserve. Must not exceed the buffer size.
+   * @return Pointer to the reserved bytes.
+   */
+  inline char* reserve(qint64 size) {
+    if (used + size > qint64(buffer.size())) {
+      flush();
+    }
+    char* p = buffer.data() + used;
+    used += size;
+    return p;
+  }
+
+  QIODevice* device;
+  std::vector<char> buffer;
+  qint64 used;
+  bool error;
+};
+
+#endif  // BUFFERED_WRITER_H
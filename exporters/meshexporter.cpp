@@ -0,0 +1,350 @@
+#include "meshexporter.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+
+#include "bufferedwriter.h"
+
+#define GLB_MAGIC 0x46546C67u
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+#define GL_FLOAT 5126
+#define GL_UNSIGNED_INT 5125
+#define GL_ARRAY_BUFFER 34962
+#define GL_ELEMENT_ARRAY_BUFFER 34963
+
+/**
+ * @brief MeshExporter::MeshExporter Creates a new exporter. Vertex normals are
+ * included by default.
+ */
+MeshExporter::MeshExporter() : includeNormals(true) {}
+
+/**
+ * @brief MeshExporter::setIncludeNormals Sets whether the vertex normals are
+ * written along with the positions.
+ * @param includeNormals True to write the normals.
+ */
+void MeshExporter::setIncludeNormals(bool includeNormals) {
+  this->includeNormals = includeNormals;
+}
+
+/**
+ * @brief MeshExporter::formatFromFileName Determines the export format from
+ * the extension of a file name.
+ * @param fileName The file name.
+ * @param format Is set to the format of the file.
+ * @return True if the extension belongs to a supported format; false
+ * otherwise.
+ */
+bool MeshExporter::formatFromFileName(const QString& fileName,
+                                      Format& format) {
+  return formatFromSuffix(QFileInfo(fileName).suffix(), format);
+}
+
+/**
+ * @brief MeshExporter::formatFromSuffix Determines the export format from a
+ * file extension.
+ * @param suffix The extension without the dot, e.g. "ply".
+ * @param format Is set to the matching format.
+ * @return True if the extension belongs to a supported format; false
+ * otherwise.
+ */
+bool MeshExporter::formatFromSuffix(const QString& suffix, Format& format) {
+  QString lowerSuffix = suffix.toLower();
+  if (lowerSuffix == "ply") {
+    format = Format::PLY;
+  } else if (lowerSuffix == "glb") {
+    format = Format::GLB;
+  } else if (lowerSuffix == "obj") {
+    format = Format::OBJ;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief MeshExporter::save Writes the mesh in the format that matches the
+ * extension of the file name.
+ * @param mesh The mesh to write.
+ * @param fileName Path of the .ply, .glb or .obj file to write.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshExporter::save(const Mesh& mesh, const QString& fileName) const {
+  Format format;
+  if (!formatFromFileName(fileName, format)) {
+    qDebug() << ":: Unsupported export format" << fileName;
+    return false;
+  }
+  return save(mesh, fileName, format);
+}
+
+/**
+ * @brief MeshExporter::save Writes the mesh in the provided format.
+ * @param mesh The mesh to write.
+ * @param fileName Path of the file to write.
+ * @param format The format to write the mesh in.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshExporter::save(const Mesh& mesh, const QString& fileName,
+                        Format format) const {
+  if (includeNormals && mesh.getVertexNorms().size() != mesh.numVerts()) {
+    // A copy shares all arrays with the original mesh; only the normals are
+    // allocated.
+    Mesh meshWithNormals = mesh;
+    meshWithNormals.recalculateNormals();
+    return save(meshWithNormals, fileName, format);
+  }
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qDebug() << ":: Could not write" << fileName;
+    return false;
+  }
+
+  BufferedWriter writer(&file);
+  bool written = true;
+  switch (format) {
+    case Format::PLY:
+      writePLY(mesh, writer);
+      break;
+    case Format::GLB:
+      written = writeGLB(mesh, writer);
+      break;
+    case Format::OBJ:
+      writeOBJ(mesh, writer);
+      break;
+  }
+  bool success = writer.flush() && written;
+  file.close();
+  if (!success) {
+    qDebug() << ":: Could not write" << fileName;
+    QFile::remove(fileName);
+  }
+  return success;
+}
+
+/**
+ * @brief MeshExporter::writePLY Writes the mesh as a binary little endian
+ * .ply file with one list of vertex indices per face.
+ * @param mesh The mesh to write.
+ * @param writer The writer to write to.
+ */
+void MeshExporter::writePLY(const Mesh& mesh, BufferedWriter& writer) const {
+  int maxValence = 0;
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    maxValence = std::max(maxValence, mesh.faceValence(f));
+  }
+  // Nearly all meshes fit the compact count type that most readers expect.
+  bool compactCount = maxValence < 256;
+
+  QByteArray header = "ply\nformat binary_little_endian 1.0\n";
+  header += "element vertex " + QByteArray::number(mesh.numVerts()) + "\n";
+  header += "property float x\nproperty float y\nproperty float z\n";
+  if (includeNormals) {
+    header += "property float nx\nproperty float ny\nproperty float nz\n";
+  }
+  header += "element face " + QByteArray::number(mesh.numFaces()) + "\n";
+  header += compactCount ? "property list uchar int vertex_indices\n"
+                         : "property list int int vertex_indices\n";
+  header += "end_header\n";
+  writer.write(header);
+
+  const QVector<QVector3D>& normals = mesh.getVertexNorms();
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    writer.writeLittleEndian(mesh.vertexX[v]);
+    writer.writeLittleEndian(mesh.vertexY[v]);
+    writer.writeLittleEndian(mesh.vertexZ[v]);
+    if (includeNormals) {
+      writer.writeLittleEndian(normals[v].x());
+      writer.writeLittleEndian(normals[v].y());
+      writer.writeLittleEndian(normals[v].z());
+    }
+  }
+
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    int valence = mesh.faceValence(f);
+    if (compactCount) {
+      writer.writeLittleEndian(quint8(valence));
+    } else {
+      writer.writeLittleEndian(qint32(valence));
+    }
+    for (int h = mesh.side(f); h < mesh.side(f) + valence; h++) {
+      writer.writeLittleEndian(qint32(mesh.origin(h)));
+    }
+  }
+}
+
+/**
+ * @brief MeshExporter::writeGLB Writes the mesh as a binary glTF 2.0 file with
+ * a single triangle primitive. Faces with more than three sides are split
+ * into triangle fans. The container stores its sizes in 32 bits, so meshes
+ * that do not fit in 4 GiB are refused before anything is written.
+ * @param mesh The mesh to write.
+ * @param writer The writer to write to.
+ * @return True if the mesh was written; false if it is too large.
+ */
+bool MeshExporter::writeGLB(const Mesh& mesh, BufferedWriter& writer) const {
+  int numVertices = mesh.numVerts();
+  qint64 numIndices = 0;
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    numIndices += 3 * (mesh.faceValence(f) - 2);
+  }
+
+  QVector3D minCoords(FLT_MAX, FLT_MAX, FLT_MAX);
+  QVector3D maxCoords(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  for (int v = 0; v < numVertices; v++) {
+    QVector3D coords = mesh.coords(v);
+    for (int i = 0; i < 3; i++) {
+      minCoords[i] = std::min(minCoords[i], coords[i]);
+      maxCoords[i] = std::max(maxCoords[i], coords[i]);
+    }
+  }
+
+  qint64 attributeSize = qint64(numVertices) * 3 * sizeof(float);
+  qint64 indicesOffset = includeNormals ? 2 * attributeSize : attributeSize;
+  qint64 binarySize = indicesOffset + numIndices * sizeof(quint32);
+
+  QJsonArray bufferViews;
+  QJsonArray accessors;
+  QJsonObject attributes;
+  auto addView = [&](qint64 offset, qint64 size, int target) {
+    bufferViews.append(QJsonObject{{"buffer", 0},
+                                   {"byteOffset", offset},
+                                   {"byteLength", size},
+                                   {"target", target}});
+    return bufferViews.size() - 1;
+  };
+  QJsonObject positions{{"bufferView", addView(0, attributeSize,
+                                               GL_ARRAY_BUFFER)},
+                        {"componentType", GL_FLOAT},
+                        {"count", numVertices},
+                        {"type", "VEC3"},
+                        {"min", QJsonArray{minCoords.x(), minCoords.y(),
+                                           minCoords.z()}},
+                        {"max", QJsonArray{maxCoords.x(), maxCoords.y(),
+                                           maxCoords.z()}}};
+  attributes["POSITION"] = accessors.size();
+  accessors.append(positions);
+  if (includeNormals) {
+    attributes["NORMAL"] = accessors.size();
+    accessors.append(QJsonObject{
+        {"bufferView", addView(attributeSize, attributeSize, GL_ARRAY_BUFFER)},
+        {"componentType", GL_FLOAT},
+        {"count", numVertices},
+        {"type", "VEC3"}});
+  }
+  int indicesAccessor = accessors.size();
+  accessors.append(QJsonObject{
+      {"bufferView", addView(indicesOffset, binarySize - indicesOffset,
+                             GL_ELEMENT_ARRAY_BUFFER)},
+      {"componentType", GL_UNSIGNED_INT},
+      {"count", numIndices},
+      {"type", "SCALAR"}});
+
+  QJsonObject primitive{
+      {"attributes", attributes}, {"indices", indicesAccessor}, {"mode", 4}};
+  QJsonObject root{
+      {"asset", QJsonObject{{"version", "2.0"}, {"generator", "LoopSubdiv"}}},
+      {"scene", 0},
+      {"scenes", QJsonArray{QJsonObject{{"nodes", QJsonArray{0}}}}},
+      {"nodes", QJsonArray{QJsonObject{{"mesh", 0}}}},
+      {"meshes",
+       QJsonArray{QJsonObject{{"primitives", QJsonArray{primitive}}}}},
+      {"buffers", QJsonArray{QJsonObject{{"byteLength", binarySize}}}},
+      {"bufferViews", bufferViews},
+      {"accessors", accessors}};
+
+  // Both chunks have to be padded to a multiple of 4 bytes; JSON with spaces
+  // and binary data with zeros.
+  QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+  while (json.size() % 4 != 0) {
+    json.append(' ');
+  }
+  qint64 binaryPadding = (4 - binarySize % 4) % 4;
+  qint64 totalSize = 12 + 8 + json.size() + 8 + binarySize + binaryPadding;
+  if (totalSize > qint64(UINT32_MAX)) {
+    qDebug() << ":: Mesh too large for a .glb file:" << totalSize << "bytes";
+    return false;
+  }
+
+  writer.writeLittleEndian(quint32(GLB_MAGIC));
+  writer.writeLittleEndian(quint32(2));
+  writer.writeLittleEndian(quint32(totalSize));
+  writer.writeLittleEndian(quint32(json.size()));
+  writer.writeLittleEndian(quint32(GLB_CHUNK_JSON));
+  writer.write(json);
+  writer.writeLittleEndian(quint32(binarySize + binaryPadding));
+  writer.writeLittleEndian(quint32(GLB_CHUNK_BIN));
+
+  for (int v = 0; v < numVertices; v++) {
+    writer.writeLittleEndian(mesh.vertexX[v]);
+    writer.writeLittleEndian(mesh.vertexY[v]);
+    writer.writeLittleEndian(mesh.vertexZ[v]);
+  }
+  if (includeNormals) {
+    for (const QVector3D& normal : mesh.getVertexNorms()) {
+      writer.writeLittleEndian(normal.x());
+      writer.writeLittleEndian(normal.y());
+      writer.writeLittleEndian(normal.z());
+    }
+  }
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    int side = mesh.side(f);
+    quint32 first = mesh.origin(side);
+    for (int i = 2; i < mesh.faceValence(f); i++) {
+      writer.writeLittleEndian(first);
+      writer.writeLittleEndian(quint32(mesh.origin(side + i - 1)));
+      writer.writeLittleEndian(quint32(mesh.origin(side + i)));
+    }
+  }
+  writer.writeZeros(binaryPadding);
+  return true;
+}
+
+/**
+ * @brief MeshExporter::writeOBJ Writes the mesh as an .obj file. Normals share
+ * the indices of the positions.
+ * @param mesh The mesh to write.
+ * @param writer The writer to write to.
+ */
+void MeshExporter::writeOBJ(const Mesh& mesh, BufferedWriter& writer) const {
+  auto writeVector = [&writer](const char* descriptor, const QVector3D& v) {
+    writer.write(descriptor, qstrlen(descriptor));
+    writer.writeFloat(v.x());
+    writer.writeChar(' ');
+    writer.writeFloat(v.y());
+    writer.writeChar(' ');
+    writer.writeFloat(v.z());
+    writer.writeChar('\n');
+  };
+
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    writeVector("v ", mesh.coords(v));
+  }
+  if (includeNormals) {
+    for (const QVector3D& normal : mesh.getVertexNorms()) {
+      writeVector("vn ", normal);
+    }
+  }
+
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    writer.writeChar('f');
+    for (int h = mesh.side(f); h < mesh.side(f) + mesh.faceValence(f); h++) {
+      int index = mesh.origin(h) + 1;
+      writer.writeChar(' ');
+      writer.writeInt(index);
+      if (includeNormals) {
+        writer.write("//", 2);
+        writer.writeInt(index);
+      }
+    }
+    writer.writeChar('\n');
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef MESH_EXPORTER_H
+#define MESH_EXPORTER_H
+
+#include <QString>
+
+#include "mesh/mesh.h"
+
+class BufferedWriter;
+
+/**
+ * @brief The MeshExporter class writes meshes of any subdivision level to
+ * binary PLY, binary glTF (.glb) or OBJ files. The data is streamed from the
+ * half-edge arrays through a BufferedWriter, so no intermediate copies of the
+ * mesh are made.
+ */
+class MeshExporter {
+ public:
+  enum class Format { PLY, GLB, OBJ };
+
+  MeshExporter();
+  void setIncludeNormals(bool includeNormals);
+
+  bool save(const Mesh& mesh, const QString& fileName) const;
+  bool save(const Mesh& mesh, const QString& fileName, Format format) const;
+  static bool formatFromFileName(const QString& fileName, Format& format);
+  static bool formatFromSuffix(const QString& suffix, Format& format);
+
+ private:
+  void writePLY(const Mesh& mesh, BufferedWriter& writer) const;
+  bool writeGLB(const Mesh& mesh, BufferedWriter& writer) const;
+  void writeOBJ(const Mesh& mesh, BufferedWriter& writer) const;
+
+  bool includeNormals;
+};
+
+#endif  // MESH_EXPORTER_H
@@ -0,0 +1,308 @@
+#include "meshcache.h"
+
+#include <QDebug>
+#include <QFile>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "util/parallel.h"
+
+#define MESH_CACHE_VERSION 3
+#define MESH_CACHE_BYTE_ORDER_MARK 0x01020304u
+
+// Set in the header flags if the mesh is a triangle mesh, in which case the
+// face arrays are left out.
+#define MESH_CACHE_TRIANGLES 0x1u
+
+/**
+ * @brief The MeshCacheHeader struct is stored at the start of every cached
+ * mesh file.
+ */
+struct MeshCacheHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrderMark;
+  qint32 numVertices;
+  qint32 numHalfEdges;
+  qint32 numFaces;
+  qint32 numEdges;
+  quint32 flags;
+};
+
+static const char meshCacheMagic[8] = {'L', 'O', 'O', 'P', 'M', 'E', 'S', 'H'};
+
+/**
+ * @brief expectedFileSize Computes the size of a cached mesh file.
+ * @param header The header of the file.
+ * @return The size of the file in bytes.
+ */
+static qint64 expectedFileSize(const MeshCacheHeader& header) {
+  qint64 numVertices = header.numVertices;
+  qint64 numHalfEdges = header.numHalfEdges;
+  qint64 numFaces = header.numFaces;
+  qint64 size = sizeof(MeshCacheHeader) +
+                numVertices * (3 * sizeof(float) + 2 * sizeof(qint32)) +
+                numHalfEdges * 3 * sizeof(qint32);
+  if (!(header.flags & MESH_CACHE_TRIANGLES)) {
+    size += numHalfEdges * sizeof(qint32) + (numFaces + 1) * sizeof(qint32);
+  }
+  return size;
+}
+
+/**
+ * @brief writeSection Writes the contents of a vector to the file.
+ * @param file The file to write to.
+ * @param data The data to write.
+ * @return True if all data was written.
+ */
+template <typename T>
+static bool writeSection(QFile& file, const QVector<T>& data) {
+  qint64 size = qint64(data.size()) * sizeof(T);
+  return file.write(reinterpret_cast<const char*>(data.constData()), size) ==
+         size;
+}
+
+/**
+ * @brief readSection Copies an array from the file contents into a vector.
+ * @param section Position of the array in the file contents. Advanced past the
+ * array.
+ * @param data Receives the array.
+ * @param size Number of elements in the array.
+ */
+template <typename T>
+static void readSection(const char*& section, QVector<T>& data, int size) {
+  data.resize(size);
+  memcpy(data.data(), section, size_t(size) * sizeof(T));
+  section += size_t(size) * sizeof(T);
+}
+
+/**
+ * @brief MeshCache::MeshCache Creates a new mesh cache reader/writer.
+ */
+MeshCache::MeshCache() {}
+
+/**
+ * @brief MeshCache::save Writes the mesh to a binary cache file. Works for
+ * meshes of any subdivision level.
+ * @param mesh The mesh to write.
+ * @param fileName Path of the file to write.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool MeshCache::save(const Mesh& mesh, const QString& fileName) const {
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qDebug() << ":: Could not write mesh cache" << fileName;
+    return false;
+  }
+
+  MeshCacheHeader header;
+  memcpy(header.magic, meshCacheMagic, sizeof(header.magic));
+  header.version = MESH_CACHE_VERSION;
+  header.byteOrderMark = MESH_CACHE_BYTE_ORDER_MARK;
+  header.numVertices = mesh.numVerts();
+  header.numHalfEdges = mesh.numHalfEdges();
+  header.numFaces = mesh.numFaces();
+  header.numEdges = mesh.numEdges();
+  header.flags = mesh.isTriangleMesh() ? MESH_CACHE_TRIANGLES : 0;
+  bool success = file.write(reinterpret_cast<const char*>(&header),
+                            sizeof(header)) == qint64(sizeof(header));
+
+  // The arrays of the mesh are written as-is. The face arrays are empty for
+  // triangle meshes.
+  success = success && writeSection(file, mesh.vertexX) &&
+            writeSection(file, mesh.vertexY) &&
+            writeSection(file, mesh.vertexZ) &&
+            writeSection(file, mesh.vertexOut) &&
+            writeSection(file, mesh.vertexValence) &&
+            writeSection(file, mesh.halfEdgeOrigin) &&
+            writeSection(file, mesh.halfEdgeTwin) &&
+            writeSection(file, mesh.halfEdgeEdge) &&
+            writeSection(file, mesh.halfEdgeFace) &&
+            writeSection(file, mesh.faceOffset);
+
+  file.close();
+  if (!success) {
+    qDebug() << ":: Could not write mesh cache" << fileName;
+    QFile::remove(fileName);
+  }
+  return success;
+}
+
+/**
+ * @brief MeshCache::load Loads a mesh from a binary cache file. The file is
+ * memory-mapped and its arrays are copied directly into the mesh. All indices
+ * are range-checked and the connectivity is checked for consistency in
+ * parallel, so corrupted files are rejected instead of producing out-of-range
+ * accesses or endless loops later on.
+ * @param fileName Path of the cache file.
+ * @param mesh Receives the loaded mesh.
+ * @return True if the mesh was loaded successfully; false otherwise.
+ */
+bool MeshCache::load(const QString& fileName, Mesh& mesh) const {
+  qDebug() << ":: Loading" << fileName;
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  qint64 fileSize = file.size();
+  if (fileSize < qint64(sizeof(MeshCacheHeader))) {
+    return false;
+  }
+  uchar* mapped = file.map(0, fileSize);
+  QByteArray contents;
+  const char* data = reinterpret_cast<const char*>(mapped);
+  if (mapped == nullptr) {
+    contents = file.readAll();
+    data = contents.constData();
+  }
+
+  MeshCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, meshCacheMagic, sizeof(header.magic)) != 0 ||
+      header.version != MESH_CACHE_VERSION ||
+      header.byteOrderMark != MESH_CACHE_BYTE_ORDER_MARK ||
+      header.numVertices < 0 || header.numHalfEdges < 0 ||
+      header.numFaces < 0 || (header.flags & ~MESH_CACHE_TRIANGLES) != 0 ||
+      ((header.flags & MESH_CACHE_TRIANGLES) &&
+       qint64(header.numHalfEdges) != 3 * qint64(header.numFaces)) ||
+      expectedFileSize(header) != fileSize) {
+    qDebug() << ":: Unsupported or corrupted mesh cache" << fileName;
+    return false;
+  }
+
+  int numVertices = header.numVertices;
+  int numHalfEdges = header.numHalfEdges;
+  int numFaces = header.numFaces;
+  bool triangles = header.flags & MESH_CACHE_TRIANGLES;
+  mesh.resize(0, 0, 0, triangles);
+  const char* section = data + sizeof(MeshCacheHeader);
+  readSection(section, mesh.vertexX, numVertices);
+  readSection(section, mesh.vertexY, numVertices);
+  readSection(section, mesh.vertexZ, numVertices);
+  readSection(section, mesh.vertexOut, numVertices);
+  readSection(section, mesh.vertexValence, numVertices);
+  readSection(section, mesh.halfEdgeOrigin, numHalfEdges);
+  readSection(section, mesh.halfEdgeTwin, numHalfEdges);
+  readSection(section, mesh.halfEdgeEdge, numHalfEdges);
+  if (!triangles) {
+    readSection(section, mesh.halfEdgeFace, numHalfEdges);
+    readSection(section, mesh.faceOffset, numFaces + 1);
+  }
+  mesh.edgeCount = header.numEdges;
+  if (mapped != nullptr) {
+    file.unmap(mapped);
+  }
+
+  std::atomic<bool> valid(true);
+  auto inRange = [](qint32 index, int count) {
+    return index >= 0 && index < count;
+  };
+  const int* faceOffsets = mesh.faceOffset.constData();
+  if (!triangles) {
+    if (faceOffsets[0] != 0 || faceOffsets[numFaces] != numHalfEdges) {
+      valid = false;
+    }
+    parallelFor(0, numFaces, 0, [&](int begin, int end, int) {
+      for (int f = begin; f < end; f++) {
+        if (faceOffsets[f] >= faceOffsets[f + 1]) {
+          valid = false;
+          return;
+        }
+      }
+    });
+  }
+  parallelFor(0, numVertices, 0, [&](int begin, int end, int) {
+    for (int v = begin; v < end; v++) {
+      int out = mesh.vertexOut.at(v);
+      if (out != -1 && !inRange(out, numHalfEdges)) {
+        valid = false;
+        return;
+      }
+    }
+  });
+  parallelFor(0, numHalfEdges, 0, [&](int begin, int end, int) {
+    for (int h = begin; h < end; h++) {
+      int twin = mesh.halfEdgeTwin.at(h);
+      if (!inRange(mesh.halfEdgeOrigin.at(h), numVertices) ||
+          !inRange(mesh.halfEdgeEdge.at(h), mesh.edgeCount) ||
+          (twin != -1 && !inRange(twin, numHalfEdges))) {
+        valid = false;
+        return;
+      }
+      if (!triangles) {
+        int f = mesh.halfEdgeFace.at(h);
+        if (!inRange(f, numFaces) || h < faceOffsets[f] ||
+            h >= faceOffsets[f + 1]) {
+          valid = false;
+          return;
+        }
+      }
+    }
+  });
+  if (valid) {
+    valid = consistentConnectivity(mesh);
+  }
+  if (!valid) {
+    qDebug() << ":: Corrupted mesh cache" << fileName;
+    mesh = Mesh();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief MeshCache::consistentConnectivity Checks the connectivity of a mesh
+ * whose indices are known to be in range. Twins have to be symmetric and
+ * share their edge, the outgoing half-edge of a vertex has to originate from
+ * it, and the valence has to match the number of outgoing half-edges
+ * (boundary vertices may count their extra neighbour as well). Without these,
+ * walking around a vertex may never terminate, and a zero valence divides by
+ * zero in the subdivision stencils.
+ * @param mesh The loaded mesh.
+ * @return True if the connectivity is consistent; false otherwise.
+ */
+bool MeshCache::consistentConnectivity(const Mesh& mesh) const {
+  int numVertices = mesh.numVerts();
+  int numHalfEdges = mesh.numHalfEdges();
+  std::atomic<bool> valid(true);
+  std::vector<std::atomic<int>> outgoing(numVertices);
+  parallelFor(0, numVertices, 0, [&](int begin, int end, int) {
+    for (int v = begin; v < end; v++) {
+      outgoing[v].store(0, std::memory_order_relaxed);
+    }
+  });
+  parallelFor(0, numHalfEdges, 0, [&](int begin, int end, int) {
+    for (int h = begin; h < end; h++) {
+      int twin = mesh.twin(h);
+      if (twin != -1 &&
+          (twin == h || mesh.twin(twin) != h ||
+           mesh.edge(twin) != mesh.edge(h))) {
+        valid = false;
+        return;
+      }
+      outgoing[mesh.origin(h)].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  if (!valid) {
+    return false;
+  }
+  // The circulators terminate once the twins are symmetric.
+  parallelFor(0, numVertices, 0, [&](int begin, int end, int) {
+    for (int v = begin; v < end; v++) {
+      int out = mesh.out(v);
+      int count = outgoing[v].load(std::memory_order_relaxed);
+      int valence = mesh.valence(v);
+      bool consistent =
+          out == -1 ? count == 0 && valence == 0
+                    : mesh.origin(out) == v &&
+                          (valence == count ||
+                           (valence == count + 1 && mesh.isBoundaryVertex(v)));
+      if (!consistent) {
+        valid = false;
+        return;
+      }
+    }
+  });
+  return valid;
+}
@@ -0,0 +1,34 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <QString>
+
+#include "../mesh/mesh.h"
+
+/**
+ * @brief The MeshCache class reads and writes fully connected half-edge meshes
+ * in a flat binary format. The file holds the index arrays of the mesh as-is,
+ * so loading a cached mesh only copies them out of the mapped file and checks
+ * the indices and their consistency; no text is parsed and no twins have to
+ * be matched.
+ *
+ * The format is versioned and stored in native (little-endian) byte order. It
+ * consists of a header, followed by these arrays:
+ *  - per vertex: x, y and z coordinates (3 separate float arrays), outgoing
+ *    half-edge, valence
+ *  - per half-edge: origin, twin (-1 on boundaries), edge index
+ *  - per half-edge: face (polygon meshes only)
+ *  - per face, plus one: offset of the first half-edge (polygon meshes only)
+ */
+class MeshCache {
+ public:
+  MeshCache();
+
+  bool save(const Mesh& mesh, const QString& fileName) const;
+  bool load(const QString& fileName, Mesh& mesh) const;
+
+ private:
+  bool consistentConnectivity(const Mesh& mesh) const;
+};
+
+#endif  // MESH_CACHE_H
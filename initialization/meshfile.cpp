@@ -0,0 +1,130 @@
+#include "meshfile.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <cmath>
+
+#include "objfile.h"
+#include "plyfile.h"
+#include "stlfile.h"
+#include "util/util.h"
+
+/**
+ * @brief MeshFile::MeshFile Creates an empty mesh file.
+ */
+MeshFile::MeshFile() : loadSuccess(false) {}
+
+/**
+ * @brief MeshFile::~MeshFile Deconstructor.
+ */
+MeshFile::~MeshFile() {}
+
+/**
+ * @brief MeshFile::open Reads the provided file with the reader that matches
+ * its extension.
+ * @param fileName Path of an .obj, .ply or .stl file.
+ * @param numThreads The number of threads used by readers that parse in
+ * parallel. Values smaller than 1 use all cores.
+ * @param normalize Whether to scale the mesh to the size the viewer expects,
+ * see normalizeMesh. Tools that write the mesh back out keep the coordinates
+ * of the file.
+ * @return The read file, or nullptr if the format is not supported. Check
+ * loadedSuccessfully() to see whether reading succeeded.
+ */
+std::unique_ptr<MeshFile> MeshFile::open(const QString& fileName,
+                                         int numThreads, bool normalize) {
+  QString suffix = QFileInfo(fileName).suffix().toLower();
+  if (suffix == "obj") {
+    return std::unique_ptr<MeshFile>(new OBJFile(
+        fileName, OBJFile::ParseMode::MemoryMapped, numThreads, normalize));
+  } else if (suffix == "ply") {
+    return std::unique_ptr<MeshFile>(new PLYFile(fileName, normalize));
+  } else if (suffix == "stl") {
+    return std::unique_ptr<MeshFile>(new STLFile(fileName, normalize));
+  }
+  qDebug() << ":: Unsupported mesh format" << fileName;
+  return nullptr;
+}
+
+/**
+ * @brief MeshFile::isSupported Checks whether open() has a reader for the
+ * provided file.
+ * @param fileName Path of the file.
+ * @return True if the extension of the file is supported; false otherwise.
+ */
+bool MeshFile::isSupported(const QString& fileName) {
+  QString suffix = QFileInfo(fileName).suffix().toLower();
+  return suffix == "obj" || suffix == "ply" || suffix == "stl";
+}
+
+/**
+ * @brief MeshFile::readMapped Maps the file into memory and passes its
+ * contents to parseContents. Files that cannot be mapped (e.g. compressed
+ * resources) are read into a single buffer instead.
+ * @param fileName Path of the file.
+ * @return True if the file was opened and parsed successfully; false
+ * otherwise.
+ */
+bool MeshFile::readMapped(const QString& fileName) {
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  bool success;
+  qint64 size = file.size();
+  uchar* mapped = size > 0 ? file.map(0, size) : nullptr;
+  if (mapped != nullptr) {
+    const char* data = reinterpret_cast<const char*>(mapped);
+    success = parseContents(data, data + size);
+    file.unmap(mapped);
+  } else {
+    QByteArray contents = file.readAll();
+    success = parseContents(contents.constData(),
+                            contents.constData() + contents.size());
+  }
+  file.close();
+  return success;
+}
+
+/**
+ * @brief MeshFile::validIndices Checks whether all face indices refer to an
+ * existing vertex.
+ * @return True if all indices are valid; false otherwise.
+ */
+bool MeshFile::validIndices() const {
+  const int numVertices = vertexCoords.size();
+  for (int index : faceCoordInd) {
+    if (index < 0 || index >= numVertices) {
+      qDebug() << " * Face refers to a missing vertex" << index;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief MeshFile::loadedSuccessfully Checks whether the model was loaded from
+ * the file successfully.
+ * @return True if the load was successful, false otherwise.
+ */
+bool MeshFile::loadedSuccessfully() const { return loadSuccess; }
+
+/**
+ * @brief MeshFile::normalizeMesh Scales the vertex coordinates in such a way
+ * that the mesh fits inside a bounding box of desiredScale. Flat meshes,
+ * whose bounding box has no width or height, are left as they are.
+ * @param desiredScale The desired scale.
+ */
+void MeshFile::normalizeMesh(float desiredScale) {
+  if (vertexCoords.isEmpty()) {
+    return;
+  }
+  float scale = calcBoundingBoxScale(vertexCoords, desiredScale);
+  if (!std::isfinite(scale)) {
+    return;
+  }
+  for (int i = 0; i < vertexCoords.size(); ++i) {
+    vertexCoords[i] *= scale;
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <QString>
+#include <QVector3D>
+#include <QVector>
+#include <memory>
+
+class QFile;
+
+#define DESIRED_SCALE 2.0
+
+/**
+ * @brief The MeshFile class is the base class of the mesh file readers. It
+ * stores the polygon data that the MeshInitializer turns into a half-edge
+ * mesh.
+ */
+class MeshFile {
+ public:
+  virtual ~MeshFile();
+
+  static std::unique_ptr<MeshFile> open(const QString& fileName,
+                                        int numThreads = 0,
+                                        bool normalize = true);
+  static bool isSupported(const QString& fileName);
+
+  bool loadedSuccessfully() const;
+  void normalizeMesh(float desiredScale);
+
+ protected:
+  MeshFile();
+
+  bool readMapped(const QString& fileName);
+  /**
+   * @brief parseContents Parses the complete contents of the file.
+   * @param begin Start of the file contents.
+   * @param end End of the file contents.
+   * @return True if the contents describe a valid mesh; false otherwise.
+   */
+  virtual bool parseContents(const char* begin, const char* end) = 0;
+  bool validIndices() const;
+
+  QVector<QVector3D> vertexCoords;
+  QVector<int> faceValences;
+  // The indices of all faces are stored back to back; face f occupies
+  // faceValences[f] consecutive entries.
+  QVector<int> faceCoordInd;
+
+  bool loadSuccess;
+
+  friend class MeshInitializer;
+};
+
+#endif  // MESHFILE_H
@@ -1,45 +1,98 @@
 #include "meshinitializer.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <atomic>
+
+#include "util/parallel.h"
+
+// Meshes with fewer half-edges than this are always constructed serially; the
+// cost of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_HALF_EDGES 65536
 
 /**
  * @brief MeshInitializer::MeshInitializer Initializes an empty mesh
- * initializer.
+ * initializer. By default, large meshes are constructed using all cores.
+ */
+MeshInitializer::MeshInitializer() : numThreads(0) {}
+
+/**
+ * @brief MeshInitializer::setNumThreads Sets the number of threads used to
+ * construct the half-edge topology.
+ * @param numThreads The number of threads. 1 forces serial construction;
+ * values smaller than 1 use all cores.
+ */
+void MeshInitializer::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief createUndirectedEdge Creates an undirected edge key from two vertex
+ * indices.
+ * @param v1 First vertex index.
+ * @param v2 Second vertex index.
+ * @return A 64-bit key with the lower index in the upper 32 bits and the
+ * higher index in the lower 32 bits. Two indices always produce the same key,
+ * regardless of their ordering.
  */
-MeshInitializer::MeshInitializer() {}
+static quint64 createUndirectedEdge(int v1, int v2) {
+  // to ensure that edges are consistent, always put the lower index first
+  if (v1 > v2) {
+    std::swap(v1, v2);
+  }
+  return (quint64(quint32(v1)) << 32) | quint32(v2);
+}
 
 /**
  * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
- * from the provided obj file. The half-edge data structure uses smart indexing
+ * from the provided mesh file. The half-edge data structure uses smart indexing
  * to do the initialization in a clean manner. This indexing is based on the
  * following paper:
  * https://diglib.eg.org/bitstream/handle/10.1111/cgf14381/v40i8pp057-070.pdf?sequence=1&isAllowed=y
- * @param loadedOBJFile The OBJFile containing all the data of the mesh to
+ * @param loadedFile The file containing all the data of the mesh to
  * construct.
  * @return A half-edge representation of the provided mesh.
  */
-Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile& loadedOBJFile) {
-  int numVertices = loadedOBJFile.vertexCoords.size();
-  int numFaces = loadedOBJFile.faceValences.size();
-  int numHalfEdges = 0;
-  for (int f = 0; f < numFaces; f++) {
-    numHalfEdges += loadedOBJFile.faceValences[f];
-  }
+Mesh MeshInitializer::constructHalfEdgeMesh(const MeshFile& loadedFile) {
+  return constructHalfEdgeMesh(loadedFile.vertexCoords,
+                               loadedFile.faceValences,
+                               loadedFile.faceCoordInd);
+}
 
+/**
+ * @brief MeshInitializer::constructHalfEdgeMesh Constructs a half-edge mesh
+ * from polygon data, laid out like the data of a mesh file.
+ * @param vertexCoords The vertex coordinates.
+ * @param faceValences The number of vertices of every face.
+ * @param faceCoordInd The vertex indices of all faces, back to back.
+ * @return A half-edge representation of the polygons.
+ */
+Mesh MeshInitializer::constructHalfEdgeMesh(
+    const QVector<QVector3D>& vertexCoords, const QVector<int>& faceValences,
+    const QVector<int>& faceCoordInd) {
+  int numVertices = vertexCoords.size();
+  int numFaces = faceValences.size();
+  int numHalfEdges = faceCoordInd.size();
+
+  // Meshes consisting of only triangles need no face data.
+  bool triangles =
+      std::all_of(faceValences.cbegin(), faceValences.cend(),
+                  [](int valence) { return valence == 3; });
   Mesh mesh;
-  mesh.vertices.resize(numVertices);
-  mesh.faces.resize(numFaces);
-  mesh.halfEdges.resize(numHalfEdges);
-  mesh.halfEdges.reserve(2 * numHalfEdges);
+  mesh.resize(numVertices, numHalfEdges, numFaces, triangles);
 
-  initGeometry(mesh, numVertices, loadedOBJFile.vertexCoords);
-  initTopology(mesh, numFaces, loadedOBJFile.faceCoordInd);
+  initGeometry(mesh, numVertices, vertexCoords);
+  int threads = resolveThreadCount(numThreads);
+  if (threads > 1 && numHalfEdges >= MIN_PARALLEL_HALF_EDGES) {
+    initTopologyParallel(mesh, faceValences, faceCoordInd, threads);
+  } else {
+    initTopology(mesh, faceValences, faceCoordInd);
+  }
   return mesh;
 }
 
 /**
- * @brief MeshInitializer::initGeometry Initializes the vertex coordinates and
- * their indices.
+ * @brief MeshInitializer::initGeometry Initializes the vertex coordinates.
  * @param mesh The mesh to initialize.
  * @param numVertices The number of vertices to initialize.
  * @param vertexCoords The vertex coordinates.
@@ -47,9 +100,7 @@ Mesh MeshInitializer::constructHalfEdgeMesh(const OBJFile& loadedOBJFile) {
 void MeshInitializer::initGeometry(Mesh& mesh, int numVertices,
                                    const QVector<QVector3D>& vertexCoords) {
   for (int v = 0; v < numVertices; v++) {
-    Vertex* vertex = &mesh.vertices[v];
-    vertex->coords = vertexCoords[v];
-    vertex->index = v;
+    mesh.setCoords(v, vertexCoords[v]);
   }
 }
 
@@ -57,112 +108,268 @@ void MeshInitializer::initGeometry(Mesh& mesh, int numVertices,
  * @brief MeshInitializer::initTopology Initializes the half-edges and face
  * data. Makes sure that all the connections are set up correctly.
  * @param mesh The mesh to initialize.
- * @param numFaces The number of faces the mesh will have.
- * @param faceCoordInd A vector containing, for each face, the indices of the
- * vertices.
+ * @param faceValences The number of vertices of every face.
+ * @param faceCoordInd The indices of the vertices of all faces, stored back
+ * to back.
  */
-void MeshInitializer::initTopology(Mesh& mesh, int numFaces,
-                                   const QVector<QVector<int>>& faceCoordInd) {
+void MeshInitializer::initTopology(Mesh& mesh, const QVector<int>& faceValences,
+                                   const QVector<int>& faceCoordInd) {
+  // Maps every undirected edge to the first half-edge that was found on it.
+  // Local to this call, so that successive meshes do not share any state.
+  QHash<quint64, int> edgeMap;
+  edgeMap.reserve(mesh.numHalfEdges());
+
   int h = 0;
-  for (int f = 0; f < numFaces; ++f) {
-    QVector<int> faceIndices = faceCoordInd[f];
+  for (int f = 0; f < faceValences.size(); ++f) {
+    const int* faceIndices = faceCoordInd.constData() + h;
     // Each face ends up with a number of half edges equal to its number of
     // vertices.
-    Face* face = &mesh.faces[f];
-    face->index = f;
-    face->valence = faceIndices.size();
-    face->side = &mesh.halfEdges[h];
-    for (int i = 0; i < face->valence; ++i) {
-      addHalfEdge(mesh, h, face, faceIndices, i);
+    int faceValence = faceValences[f];
+    if (!mesh.isTriangleMesh()) {
+      mesh.faceOffset[f] = h;
+    }
+    for (int i = 0; i < faceValence; ++i) {
+      addHalfEdge(mesh, h, f, faceIndices[i]);
+      mesh.vertexOut[faceIndices[i]] = h;
+      setTwins(mesh, edgeMap, h, faceIndices[i],
+               faceIndices[(i + 1) % faceValence]);
       // The valence of a vertex is equal to the number of faces it belongs to,
       // so for every face, increment the valence of all its vertices by 1.
-      mesh.vertices[faceIndices[i]].valence++;
+      mesh.vertexValence[faceIndices[i]]++;
       h++;
     }
   }
-  mesh.edgeCount = edgeList.size();
+  mesh.edgeCount = edgeMap.size();
 }
 
 /**
- * @brief MeshInitializer::addHalfEdge Initializes the data of single half-edge
- * in the mesh.
- * @param mesh The mesh to initialize the half-edge in.
- * @param h Index of the half-edge.
- * @param face Face that the half-edge belongs to.
- * @param vertIndices Indices of the vertices that belong to the face this
- * half-edge belongs to.
- * @param i Index within vertIndices vector.
+ * @brief atomicMax Atomically raises target to value if value is larger.
+ * @param target The value to update.
+ * @param value The candidate maximum.
  */
-void MeshInitializer::addHalfEdge(Mesh& mesh, int h, Face* face,
-                                  const QVector<int>& vertIndices, int i) {
-  int faceValence = vertIndices.size();
-  int vertIdx = vertIndices[i];
-  int nextVertIdx = vertIndices[(i + 1) % faceValence];
-  // prev and next
-  int prev = h - 1;
-  int next = h + 1;
-  if (i == 0) {
-    // prev = h - 1 + faceValency
-    prev += faceValence;
-  } else if (i == faceValence - 1) {
-    // next = h + 1 - faceValency
-    next -= faceValence;
+static void atomicMax(std::atomic<int>& target, int value) {
+  int current = target.load(std::memory_order_relaxed);
+  while (current < value &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
   }
-  HalfEdge* halfEdge = &mesh.halfEdges[h];
-  halfEdge->index = h;
-  halfEdge->origin = &mesh.vertices[vertIdx];
-  halfEdge->prev = &mesh.halfEdges[prev];
-  halfEdge->next = &mesh.halfEdges[next];
-  halfEdge->face = face;
-  mesh.vertices[vertIdx].out = halfEdge;
-
-  setTwins(mesh, h, vertIdx, nextVertIdx);
 }
 
 /**
- * @brief createUndirectedEdge Creates an undirected edge from two vertex
- * indices.
- * @param v1 First vertex index.
- * @param v2 Second vertex index.
- * @return A pair of v1-v2. Two indices always produce the same pair, regardless
- * of their ordering.
+ * @brief MeshInitializer::initTopologyParallel Parallel version of
+ * initTopology that produces exactly the same mesh. The half-edges of every
+ * face are set up independently, as their indices follow from a prefix sum
+ * over the face valences. Valences and outgoing half-edges are gathered with
+ * atomics, after which the twins are resolved by sorting edge keys.
+ * @param mesh The mesh to initialize.
+ * @param faceValences The number of vertices of every face.
+ * @param faceCoordInd The indices of the vertices of all faces, stored back
+ * to back.
+ * @param numThreads The number of threads to use.
  */
-QPair<int, int> createUndirectedEdge(int v1, int v2) {
-  // to ensure that edges are consistent, always put the lower index first
-  if (v1 > v2) {
-    return QPair<int, int>(v2, v1);
+void MeshInitializer::initTopologyParallel(Mesh& mesh,
+                                           const QVector<int>& faceValences,
+                                           const QVector<int>& faceCoordInd,
+                                           int numThreads) {
+  int numFaces = faceValences.size();
+  int numVertices = mesh.numVerts();
+  int numHalfEdges = mesh.numHalfEdges();
+
+  QVector<int> faceOffsets(numFaces + 1);
+  faceOffsets[0] = 0;
+  for (int f = 0; f < numFaces; ++f) {
+    faceOffsets[f + 1] = faceOffsets[f] + faceValences[f];
+  }
+
+  if (!mesh.isTriangleMesh()) {
+    mesh.faceOffset = faceOffsets;
+  }
+
+  std::vector<std::atomic<int>> valences(numVertices);
+  std::vector<std::atomic<int>> outEdges(numVertices);
+  parallelFor(0, numVertices, numThreads, [&](int begin, int end, int) {
+    for (int v = begin; v < end; ++v) {
+      valences[v].store(0, std::memory_order_relaxed);
+      outEdges[v].store(-1, std::memory_order_relaxed);
+    }
+  });
+
+  std::vector<HalfEdgeKey> edgeKeys(numHalfEdges);
+  parallelFor(0, numFaces, numThreads, [&](int begin, int end, int) {
+    for (int f = begin; f < end; ++f) {
+      int h = faceOffsets[f];
+      const int* faceIndices = faceCoordInd.constData() + h;
+      int faceValence = faceValences[f];
+      for (int i = 0; i < faceValence; ++i, ++h) {
+        int vertIdx = faceIndices[i];
+        int nextVertIdx = faceIndices[(i + 1) % faceValence];
+        addHalfEdge(mesh, h, f, vertIdx);
+        valences[vertIdx].fetch_add(1, std::memory_order_relaxed);
+        // The serial version ends up with the last outgoing half-edge.
+        atomicMax(outEdges[vertIdx], h);
+        edgeKeys[h] = {createUndirectedEdge(vertIdx, nextVertIdx), h};
+      }
+    }
+  });
+
+  parallelFor(0, numVertices, numThreads, [&](int begin, int end, int) {
+    for (int v = begin; v < end; ++v) {
+      mesh.vertexValence[v] = valences[v].load(std::memory_order_relaxed);
+      mesh.vertexOut[v] = outEdges[v].load(std::memory_order_relaxed);
+    }
+  });
+
+  resolveTwinsParallel(mesh, edgeKeys, numThreads);
+}
+
+/**
+ * @brief MeshInitializer::resolveTwinsParallel Sets the twins and edge indices
+ * of all half-edges. The edge keys are sorted in parallel (per-thread sorts
+ * followed by pairwise merges), after which every run of equal keys holds the
+ * half-edges of one undirected edge. Edges are numbered in the order of their
+ * first half-edge, which matches the numbering of setTwins.
+ * @param mesh The mesh the half-edges belong to.
+ * @param edgeKeys For every half-edge, its undirected edge key. Sorted in
+ * place.
+ * @param numThreads The number of threads to use.
+ */
+void MeshInitializer::resolveTwinsParallel(Mesh& mesh,
+                                           std::vector<HalfEdgeKey>& edgeKeys,
+                                           int numThreads) {
+  int numHalfEdges = edgeKeys.size();
+  auto keyLess = [](const HalfEdgeKey& a, const HalfEdgeKey& b) {
+    return a.edge < b.edge || (a.edge == b.edge && a.halfEdge < b.halfEdge);
+  };
+
+  QVector<int> chunks(numThreads + 1);
+  for (int c = 0; c <= numThreads; ++c) {
+    chunks[c] = int(qint64(numHalfEdges) * c / numThreads);
+  }
+  parallelFor(0, numThreads, numThreads, [&](int begin, int end, int) {
+    for (int c = begin; c < end; ++c) {
+      std::sort(edgeKeys.begin() + chunks[c], edgeKeys.begin() + chunks[c + 1],
+                keyLess);
+    }
+  });
+  for (int width = 1; width < numThreads; width *= 2) {
+    int numMerges = (numThreads + 2 * width - 1) / (2 * width);
+    parallelFor(0, numMerges, numThreads, [&](int begin, int end, int) {
+      for (int m = begin; m < end; ++m) {
+        int first = chunks[2 * m * width];
+        int middle = chunks[std::min(2 * m * width + width, numThreads)];
+        int last = chunks[std::min(2 * m * width + 2 * width, numThreads)];
+        std::inplace_merge(edgeKeys.begin() + first, edgeKeys.begin() + middle,
+                           edgeKeys.begin() + last, keyLess);
+      }
+    });
+  }
+
+  // For every half-edge, the first (lowest) half-edge on the same edge. A run
+  // of equal keys is handled by the chunk in which it starts.
+  QVector<int> firstHalfEdges(numHalfEdges);
+  parallelFor(0, numHalfEdges, numThreads, [&](int begin, int end, int) {
+    int i = begin;
+    while (i > 0 && i < end && edgeKeys[i].edge == edgeKeys[i - 1].edge) {
+      i++;
+    }
+    while (i < end) {
+      int runEnd = i + 1;
+      while (runEnd < numHalfEdges &&
+             edgeKeys[runEnd].edge == edgeKeys[i].edge) {
+        runEnd++;
+      }
+      int first = edgeKeys[i].halfEdge;
+      firstHalfEdges[first] = first;
+      for (int j = i + 1; j < runEnd; ++j) {
+        int h = edgeKeys[j].halfEdge;
+        firstHalfEdges[h] = first;
+        mesh.halfEdgeTwin[h] = first;
+      }
+      if (runEnd - i > 1) {
+        // Like setTwins, the first half-edge keeps the last one as its twin.
+        mesh.halfEdgeTwin[first] = edgeKeys[runEnd - 1].halfEdge;
+      }
+      i = runEnd;
+    }
+  });
+
+  // Number the edges through a prefix sum over their first half-edges.
+  QVector<int> edgeOffsets(numThreads + 1, 0);
+  parallelFor(0, numThreads, numThreads, [&](int begin, int end, int) {
+    for (int c = begin; c < end; ++c) {
+      int count = 0;
+      for (int h = chunks[c]; h < chunks[c + 1]; ++h) {
+        count += firstHalfEdges[h] == h;
+      }
+      edgeOffsets[c + 1] = count;
+    }
+  });
+  for (int c = 0; c < numThreads; ++c) {
+    edgeOffsets[c + 1] += edgeOffsets[c];
+  }
+  parallelFor(0, numThreads, numThreads, [&](int begin, int end, int) {
+    for (int c = begin; c < end; ++c) {
+      int edgeIdx = edgeOffsets[c];
+      for (int h = chunks[c]; h < chunks[c + 1]; ++h) {
+        if (firstHalfEdges[h] == h) {
+          mesh.halfEdgeEdge[h] = edgeIdx++;
+        }
+      }
+    }
+  });
+  parallelFor(0, numHalfEdges, numThreads, [&](int begin, int end, int) {
+    for (int h = begin; h < end; ++h) {
+      mesh.halfEdgeEdge[h] = mesh.halfEdgeEdge[firstHalfEdges[h]];
+    }
+  });
+  mesh.edgeCount = edgeOffsets[numThreads];
+}
+
+/**
+ * @brief MeshInitializer::addHalfEdge Initializes the data of single half-edge
+ * in the mesh. The next and previous half-edges follow from the face offsets
+ * (or, for triangle meshes, from the index itself); the twin and the vertex
+ * data are handled by the caller.
+ * @param mesh The mesh to initialize the half-edge in.
+ * @param h Index of the half-edge.
+ * @param f Index of the face that the half-edge belongs to.
+ * @param vertIdx Index of the vertex the half-edge originates from.
+ */
+void MeshInitializer::addHalfEdge(Mesh& mesh, int h, int f, int vertIdx) {
+  mesh.halfEdgeOrigin[h] = vertIdx;
+  if (!mesh.isTriangleMesh()) {
+    mesh.halfEdgeFace[h] = f;
   }
-  return QPair<int, int>(v1, v2);
 }
 
 /**
  * @brief MeshInitializer::setTwins Set the twin properties of the half-edge.
  * Simultaneously updates the edge indices by keeping track of all the edges
- * that have been (partially) covered.
+ * that have been (partially) covered. Edges are numbered in the order in which
+ * they are first encountered.
  * @param mesh The mesh the half-edge belongs to.
+ * @param edgeMap Map from undirected edge keys to the first half-edge found on
+ * that edge.
  * @param h Index of the half-edge.
  * @param vertIdx1 Index of the first vertex of the edge the half-edge belongs
  * to.
  * @param vertIdx2 Index of the second vertex of the edge the half-edge belongs
  * to.
  */
-void MeshInitializer::setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2) {
-  QPair<int, int> currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
+void MeshInitializer::setTwins(Mesh& mesh, QHash<quint64, int>& edgeMap, int h,
+                               int vertIdx1, int vertIdx2) {
+  quint64 currentEdge = createUndirectedEdge(vertIdx1, vertIdx2);
 
-  int edgeIdx = edgeList.indexOf(currentEdge);
+  int twinIdx = edgeMap.value(currentEdge, -1);
   // edge does not exist yet
-  if (edgeIdx == -1) {
-    // same as doing this after appending and adding -1
-    edgeIndices.append(edgeList.size());
-    mesh.halfEdges[h].edgeIndex = edgeList.size();
-    edgeList.append(currentEdge);
+  if (twinIdx == -1) {
+    mesh.halfEdgeEdge[h] = edgeMap.size();
+    edgeMap.insert(currentEdge, h);
   } else {
-    edgeIndices.append(edgeIdx);
-    mesh.halfEdges[h].edgeIndex = edgeIdx;
     // edge already existed, meaning there is a twin somewhere earlier in the
-    // list of edges
-    HalfEdge* twinEdge = &mesh.halfEdges[edgeIndices.indexOf(edgeIdx)];
-    mesh.halfEdges[h].twin = twinEdge;
-    twinEdge->twin = &mesh.halfEdges[h];
+    // list of half-edges
+    mesh.halfEdgeEdge[h] = mesh.halfEdgeEdge[twinIdx];
+    mesh.halfEdgeTwin[h] = twinIdx;
+    mesh.halfEdgeTwin[twinIdx] = h;
   }
 }
@@ -1,28 +1,48 @@
 #ifndef MESH_INITIALIZER_H
 #define MESH_INITIALIZER_H
 
+#include <QHash>
+#include <vector>
+
 #include "../mesh/mesh.h"
-#include "objfile.h"
+#include "meshfile.h"
 
 /**
- * @brief The MeshInitializer class initializes half-edge meshes from OBJFiles.
+ * @brief The MeshInitializer class initializes half-edge meshes from mesh
+ * files.
  */
 class MeshInitializer {
  public:
   MeshInitializer();
-  Mesh constructHalfEdgeMesh(const OBJFile& loadedOBJFile);
+  void setNumThreads(int numThreads);
+  Mesh constructHalfEdgeMesh(const MeshFile& loadedFile);
+  Mesh constructHalfEdgeMesh(const QVector<QVector3D>& vertexCoords,
+                             const QVector<int>& faceValences,
+                             const QVector<int>& faceCoordInd);
 
  private:
+  /**
+   * @brief The HalfEdgeKey struct pairs a half-edge with the key of the
+   * undirected edge it lies on.
+   */
+  struct HalfEdgeKey {
+    quint64 edge;
+    int halfEdge;
+  };
+
   void initGeometry(Mesh& mesh, int numVertices,
                     const QVector<QVector3D>& vertexCoords);
-  void initTopology(Mesh& mesh, int numFaces,
-                     const QVector<QVector<int>>& faceCoordInd);
-  void addHalfEdge(Mesh& mesh, int h, Face* face,
-                   const QVector<int>& faceIndices, int i);
-  void setTwins(Mesh& mesh, int h, int vertIdx1, int vertIdx2);
+  void initTopology(Mesh& mesh, const QVector<int>& faceValences,
+                    const QVector<int>& faceCoordInd);
+  void initTopologyParallel(Mesh& mesh, const QVector<int>& faceValences,
+                            const QVector<int>& faceCoordInd, int numThreads);
+  void resolveTwinsParallel(Mesh& mesh, std::vector<HalfEdgeKey>& edgeKeys,
+                            int numThreads);
+  void addHalfEdge(Mesh& mesh, int h, int f, int vertIdx);
+  void setTwins(Mesh& mesh, QHash<quint64, int>& edgeMap, int h, int vertIdx1,
+                int vertIdx2);
 
-  QList<QPair<int, int>> edgeList;
-  QVector<int> edgeIndices;
+  int numThreads;
 };
 
 #endif  // MESH_INITIALIZER_H
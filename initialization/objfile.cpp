@@ -2,46 +2,43 @@
 
 #include <QDebug>
 #include <QFile>
-#include <QMatrix4x4>
+#include <QTextStream>
+#include <climits>
+#include <cmath>
+#include <cstring>
 
-#include "util/util.h"
+#include "util/parallel.h"
 
-#define DESIRED_SCALE 2.0
+// Mapped files smaller than this are always parsed by a single thread.
+#define MIN_PARALLEL_PARSE_BYTES (1 << 20)
 
 /**
  * @brief OBJFile::OBJFile Reads information from the provided .obj file and
  * stores it in this class.
  * @param fileName The path of the .obj file
+ * @param parseMode The way the file is read. Both modes produce the same
+ * data.
+ * @param numThreads The number of threads used to parse large files in
+ * MemoryMapped mode. Values smaller than 1 use all cores.
+ * @param normalize Whether to scale the mesh, see MeshFile::normalizeMesh.
  */
-OBJFile::OBJFile(const QString& fileName) {
+OBJFile::OBJFile(const QString& fileName, ParseMode parseMode, int numThreads,
+                 bool normalize)
+    : numThreads(numThreads) {
   qDebug() << ":: Loading" << fileName;
-  QFile newModel(fileName);
-
-  if (newModel.open(QIODevice::ReadOnly)) {
-    QTextStream fileContents(&newModel);
-
-    while (!fileContents.atEnd()) {
-      QString currentLine = fileContents.readLine();
-      QStringList values = currentLine.split(" ");
-
-      const QString descriptor = values[0];
-      if (descriptor == "v") {
-        handleVertex(values);
-      } else if (descriptor == "vt") {
-        handleVertexTexCoords(values);
-      } else if (descriptor == "vn") {
-        handleVertexNormal(values);
-      } else if (descriptor == "f") {
-        handleFace(values);
-      } else {
-        qDebug() << " * Line contents ignored," << currentLine;
-      }
+
+  if (parseMode == ParseMode::MemoryMapped) {
+    loadSuccess = readMapped(fileName);
+  } else {
+    QFile newModel(fileName);
+    if (newModel.open(QIODevice::ReadOnly)) {
+      readTextStream(newModel);
+      newModel.close();
+      loadSuccess = validIndices();
     }
-    newModel.close();
+  }
+  if (loadSuccess && normalize) {
     normalizeMesh(DESIRED_SCALE);
-    loadSuccess = true;
-  } else {
-    loadSuccess = false;
   }
 }
 
@@ -50,6 +47,432 @@ OBJFile::OBJFile(const QString& fileName) {
  */
 OBJFile::~OBJFile() {}
 
+/**
+ * @brief OBJFile::readTextStream Reads the file line by line, splitting every
+ * line into its separate values.
+ * @param file The opened .obj file.
+ */
+void OBJFile::readTextStream(QFile& file) {
+  QTextStream fileContents(&file);
+
+  while (!fileContents.atEnd()) {
+    QString currentLine = fileContents.readLine();
+    QStringList values = currentLine.split(" ");
+
+    const QString descriptor = values[0];
+    if (descriptor == "v") {
+      handleVertex(values);
+    } else if (descriptor == "vt") {
+      handleVertexTexCoords(values);
+    } else if (descriptor == "vn") {
+      handleVertexNormal(values);
+    } else if (descriptor == "f") {
+      handleFace(values);
+    } else {
+      qDebug() << " * Line contents ignored," << currentLine;
+    }
+  }
+}
+
+/**
+ * @brief OBJFile::parseContents Parses the mapped contents of the .obj file.
+ * @param begin Start of the file contents.
+ * @param end End of the file contents.
+ * @return True if all faces refer to existing vertices; false otherwise.
+ * Malformed lines are ignored.
+ */
+bool OBJFile::parseContents(const char* begin, const char* end) {
+  parseBuffer(begin, end, numThreads);
+  return validIndices();
+}
+
+/**
+ * @brief OBJFile::parseBuffer Parses the contents of an .obj file in place.
+ * Large buffers are split into one chunk per thread. The split points are
+ * moved to the next line boundary, so every line lives in exactly one chunk.
+ * The chunks are parsed concurrently and merged in file order afterwards.
+ * @param begin Start of the file contents.
+ * @param end End of the file contents.
+ * @param numThreads The number of threads to parse with.
+ */
+void OBJFile::parseBuffer(const char* begin, const char* end, int numThreads) {
+  qint64 size = end - begin;
+  int numChunks = size < MIN_PARALLEL_PARSE_BYTES
+                      ? 1
+                      : resolveThreadCount(numThreads);
+
+  QVector<const char*> splits(numChunks + 1);
+  splits[0] = begin;
+  for (int c = 1; c < numChunks; c++) {
+    const char* split = std::max(begin + size * c / numChunks, splits[c - 1]);
+    const char* lineEnd =
+        static_cast<const char*>(memchr(split, '\n', size_t(end - split)));
+    splits[c] = lineEnd == nullptr ? end : lineEnd + 1;
+  }
+  splits[numChunks] = end;
+
+  QVector<Chunk> chunks(numChunks);
+  parallelFor(0, numChunks, numChunks, [&](int first, int last, int) {
+    for (int c = first; c < last; c++) {
+      parseChunk(splits[c], splits[c + 1], chunks[c]);
+    }
+  });
+  mergeChunks(chunks, numThreads);
+}
+
+/**
+ * @brief OBJFile::mergeChunks Concatenates the records of all chunks in file
+ * order. The vertex, texture and normal counts of the preceding chunks are
+ * added to the relative indices of every chunk.
+ * @param chunks The parsed chunks. Emptied in the process.
+ * @param numThreads The number of threads used for copying.
+ */
+void OBJFile::mergeChunks(QVector<Chunk>& chunks, int numThreads) {
+  int numChunks = chunks.size();
+  int ignoredLines = 0;
+  for (int c = 0; c < numChunks; c++) {
+    ignoredLines += chunks[c].ignoredLines;
+  }
+  if (ignoredLines > 0) {
+    qDebug() << " * Lines ignored:" << ignoredLines;
+  }
+
+  if (numChunks == 1) {
+    Chunk& chunk = chunks[0];
+    vertexCoords = std::move(chunk.vertexCoords);
+    textureCoords = std::move(chunk.textureCoords);
+    vertexNormals = std::move(chunk.vertexNormals);
+    faceValences = std::move(chunk.faceValences);
+    faceCoordInd = std::move(chunk.faceCoordInd);
+    faceTexInd = std::move(chunk.faceTexInd);
+    faceNormalInd = std::move(chunk.faceNormalInd);
+    return;
+  }
+
+  struct Offsets {
+    int vertices = 0;
+    int texCoords = 0;
+    int normals = 0;
+    int faces = 0;
+    int corners = 0;
+  };
+  QVector<Offsets> offsets(numChunks + 1);
+  for (int c = 0; c < numChunks; c++) {
+    offsets[c + 1].vertices = offsets[c].vertices + chunks[c].vertexCoords.size();
+    offsets[c + 1].texCoords =
+        offsets[c].texCoords + chunks[c].textureCoords.size();
+    offsets[c + 1].normals = offsets[c].normals + chunks[c].vertexNormals.size();
+    offsets[c + 1].faces = offsets[c].faces + chunks[c].faceValences.size();
+    offsets[c + 1].corners = offsets[c].corners + chunks[c].faceCoordInd.size();
+  }
+  const Offsets& total = offsets[numChunks];
+  vertexCoords.resize(total.vertices);
+  textureCoords.resize(total.texCoords);
+  vertexNormals.resize(total.normals);
+  faceValences.resize(total.faces);
+  faceCoordInd.resize(total.corners);
+  faceTexInd.resize(total.corners);
+  faceNormalInd.resize(total.corners);
+
+  QVector3D* vertexData = vertexCoords.data();
+  QVector2D* texCoordData = textureCoords.data();
+  QVector3D* normalData = vertexNormals.data();
+  int* valenceData = faceValences.data();
+  int* coordIndData = faceCoordInd.data();
+  int* texIndData = faceTexInd.data();
+  int* normalIndData = faceNormalInd.data();
+  parallelFor(0, numChunks, numThreads, [&](int first, int last, int) {
+    for (int c = first; c < last; c++) {
+      Chunk& chunk = chunks[c];
+      const Offsets& offset = offsets[c];
+      std::copy(chunk.vertexCoords.cbegin(), chunk.vertexCoords.cend(),
+                vertexData + offset.vertices);
+      std::copy(chunk.textureCoords.cbegin(), chunk.textureCoords.cend(),
+                texCoordData + offset.texCoords);
+      std::copy(chunk.vertexNormals.cbegin(), chunk.vertexNormals.cend(),
+                normalData + offset.normals);
+      std::copy(chunk.faceValences.cbegin(), chunk.faceValences.cend(),
+                valenceData + offset.faces);
+
+      int* coordInd = coordIndData + offset.corners;
+      int* texInd = texIndData + offset.corners;
+      int* normalInd = normalIndData + offset.corners;
+      std::copy(chunk.faceCoordInd.cbegin(), chunk.faceCoordInd.cend(),
+                coordInd);
+      std::copy(chunk.faceTexInd.cbegin(), chunk.faceTexInd.cend(), texInd);
+      std::copy(chunk.faceNormalInd.cbegin(), chunk.faceNormalInd.cend(),
+                normalInd);
+      for (int i : chunk.relativeCoordInd) {
+        coordInd[i] += offset.vertices;
+      }
+      for (int i : chunk.relativeTexInd) {
+        texInd[i] += offset.texCoords;
+      }
+      for (int i : chunk.relativeNormalInd) {
+        normalInd[i] += offset.normals;
+      }
+      chunk = Chunk();
+    }
+  });
+}
+
+/**
+ * @brief isBlank Checks whether the character separates values on a line.
+ * @param c The character to check.
+ * @return True if the character is a space, tab or carriage return.
+ */
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * @brief skipBlanks Skips over any separating characters.
+ * @param p Current position.
+ * @param end End of the line.
+ * @return The position of the first non-blank character, or end.
+ */
+static inline const char* skipBlanks(const char* p, const char* end) {
+  while (p < end && isBlank(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/**
+ * @brief isDigit Checks whether the character is a decimal digit.
+ * @param c The character to check.
+ * @return True if the character is in the range 0-9.
+ */
+static inline bool isDigit(char c) { return unsigned(c - '0') < 10; }
+
+/**
+ * @brief parseInt Parses a (signed) decimal integer. Values that do not fit in
+ * an int saturate, so that they are rejected as out of range later on.
+ * @param p Start of the integer.
+ * @param end End of the line.
+ * @param value Receives the parsed integer.
+ * @return The position right after the integer, or nullptr if there is no
+ * integer at p.
+ */
+static const char* parseInt(const char* p, const char* end, int& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p == end || !isDigit(*p)) {
+    return nullptr;
+  }
+  int result = 0;
+  while (p < end && isDigit(*p)) {
+    result = result <= (INT_MAX - 9) / 10 ? result * 10 + (*p - '0') : INT_MAX;
+    p++;
+  }
+  value = negative ? -result : result;
+  return p;
+}
+
+/**
+ * @brief parseFloat Parses a decimal floating point number with an optional
+ * exponent. Up to 18 significant digits are accumulated in an integer and
+ * scaled by an exact power of ten, which yields correctly rounded results for
+ * all coordinates written by common exporters.
+ * @param p Start of the number.
+ * @param end End of the line.
+ * @param value Receives the parsed number.
+ * @return The position right after the number, or nullptr if there is no
+ * number at p.
+ */
+static const char* parseFloat(const char* p, const char* end, float& value) {
+  static const double powersOfTen[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const quint64 maxMantissa = 1000000000000000000ull;
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  quint64 mantissa = 0;
+  int exponent = 0;
+  bool hasDigits = false;
+  while (p < end && isDigit(*p)) {
+    if (mantissa < maxMantissa) {
+      mantissa = mantissa * 10 + (*p - '0');
+    } else {
+      exponent++;
+    }
+    hasDigits = true;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && isDigit(*p)) {
+      if (mantissa < maxMantissa) {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+      hasDigits = true;
+      p++;
+    }
+  }
+  if (!hasDigits) {
+    return nullptr;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int exponentPart;
+    const char* afterExponent = parseInt(p + 1, end, exponentPart);
+    if (afterExponent != nullptr) {
+      exponent += exponentPart;
+      p = afterExponent;
+    }
+  }
+
+  double result = double(mantissa);
+  if (exponent < 0) {
+    result = exponent >= -22 ? result / powersOfTen[-exponent]
+                             : result * pow(10.0, exponent);
+  } else if (exponent > 0) {
+    result = exponent <= 22 ? result * powersOfTen[exponent]
+                            : result * pow(10.0, exponent);
+  }
+  value = float(negative ? -result : result);
+  return p;
+}
+
+/**
+ * @brief parseFloats Parses a number of blank-separated floats. Values that
+ * are missing from the line are set to 0.
+ * @param p Start of the first value.
+ * @param end End of the line.
+ * @param values Receives the parsed values.
+ * @param count The number of values to parse.
+ */
+static void parseFloats(const char* p, const char* end, float* values,
+                        int count) {
+  for (int i = 0; i < count; i++) {
+    values[i] = 0.0f;
+    p = skipBlanks(p, end);
+    const char* next = p != end ? parseFloat(p, end, values[i]) : nullptr;
+    if (next == nullptr) {
+      return;
+    }
+    p = next;
+  }
+}
+
+/**
+ * @brief appendIndex Converts an .obj index to a 0-based index and appends it.
+ * @param index The index as it appears in the file. OBJ starts indexing from
+ * 1, negative indices count back from the last element read so far and 0
+ * denotes a missing index (stored as -1).
+ * @param count The number of elements read so far in this chunk.
+ * @param indices The indices to append to.
+ * @param relative Receives the position of the index if it is relative, so
+ * that it can be shifted by the element count of the preceding chunks.
+ */
+static inline void appendIndex(int index, int count, QVector<int>& indices,
+                               QVector<int>& relative) {
+  if (index > 0) {
+    indices.append(index - 1);
+  } else if (index < 0) {
+    relative.append(indices.size());
+    indices.append(count + index);
+  } else {
+    indices.append(-1);
+  }
+}
+
+/**
+ * @brief OBJFile::parseChunk Parses a part of an .obj file in place. Lines are
+ * located with memchr and their values are converted directly from the bytes,
+ * so no strings are allocated.
+ * @param begin Start of the chunk. Must be the start of a line.
+ * @param end End of the chunk. Must be the end of a line.
+ * @param chunk Receives the parsed records.
+ */
+void OBJFile::parseChunk(const char* begin, const char* end, Chunk& chunk) {
+  float values[3];
+  const char* p = begin;
+  while (p < end) {
+    const char* lineEnd =
+        static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+    if (lineEnd == nullptr) {
+      lineEnd = end;
+    }
+    const char* q = skipBlanks(p, lineEnd);
+    qint64 length = lineEnd - q;
+
+    if (length >= 2 && q[0] == 'v' && isBlank(q[1])) {
+      parseFloats(q + 2, lineEnd, values, 3);
+      chunk.vertexCoords.append(QVector3D(values[0], values[1], values[2]));
+    } else if (length >= 3 && q[0] == 'v' && q[1] == 't' && isBlank(q[2])) {
+      parseFloats(q + 3, lineEnd, values, 2);
+      chunk.textureCoords.append(QVector2D(values[0], values[1]));
+    } else if (length >= 3 && q[0] == 'v' && q[1] == 'n' && isBlank(q[2])) {
+      parseFloats(q + 3, lineEnd, values, 3);
+      chunk.vertexNormals.append(QVector3D(values[0], values[1], values[2]));
+    } else if (length >= 2 && q[0] == 'f' && isBlank(q[1])) {
+      if (!parseFace(q + 2, lineEnd, chunk)) {
+        chunk.ignoredLines++;
+      }
+    } else if (length > 0) {
+      chunk.ignoredLines++;
+    }
+    p = lineEnd + 1;
+  }
+}
+
+/**
+ * @brief OBJFile::parseFace Parses the index data of a single face line. Every
+ * corner is of the form v, v/vt, v//vn or v/vt/vn.
+ * @param p Start of the first corner.
+ * @param end End of the line.
+ * @param chunk The chunk the face is added to.
+ * @return True if the face has at least one corner; false otherwise.
+ */
+bool OBJFile::parseFace(const char* p, const char* end, Chunk& chunk) {
+  int valence = 0;
+  p = skipBlanks(p, end);
+  while (p < end) {
+    int coordIdx;
+    int texIdx = 0;
+    int normalIdx = 0;
+    const char* next = parseInt(p, end, coordIdx);
+    if (next == nullptr) {
+      break;
+    }
+    p = next;
+    if (p < end && *p == '/') {
+      p++;
+      next = parseInt(p, end, texIdx);
+      p = next != nullptr ? next : p;
+      if (p < end && *p == '/') {
+        p++;
+        next = parseInt(p, end, normalIdx);
+        p = next != nullptr ? next : p;
+      }
+    }
+    appendIndex(coordIdx, chunk.vertexCoords.size(), chunk.faceCoordInd,
+                chunk.relativeCoordInd);
+    appendIndex(texIdx, chunk.textureCoords.size(), chunk.faceTexInd,
+                chunk.relativeTexInd);
+    appendIndex(normalIdx, chunk.vertexNormals.size(), chunk.faceNormalInd,
+                chunk.relativeNormalInd);
+    valence++;
+
+    while (p < end && !isBlank(*p)) {
+      p++;
+    }
+    p = skipBlanks(p, end);
+  }
+  if (valence > 0) {
+    chunk.faceValences.append(valence);
+  }
+  return valence > 0;
+}
+
 /**
  * @brief OBJFile::handleVertex Handles vertex coordinate data. Invoked when the
  * line starts with "v".
@@ -89,53 +512,27 @@ void OBJFile::handleVertexNormal(const QStringList& values) {
  * @param values Line contents split by whitespace.
  */
 void OBJFile::handleFace(const QStringList& values) {
-  QVector<int> faceCoordsIndices;
-  QVector<int> faceTexIndices;
-  QVector<int> faceNormalIndices;
   for (int k = 1; k < values.size(); k++) {
     QStringList indices = values[k].split("/");
 
     // Note -1, OBJ starts indexing from 1.
-    faceCoordsIndices.append(indices[0].toInt() - 1);
+    faceCoordInd.append(indices[0].toInt() - 1);
 
+    int texIdx = -1;
+    int normalIdx = -1;
     if (indices.size() > 1) {
       if (!indices[1].isEmpty()) {
-        faceTexIndices.append(indices[1].toInt() - 1);
+        texIdx = indices[1].toInt() - 1;
       }
 
       if (indices.size() > 2) {
         if (!indices[2].isEmpty()) {
-          faceNormalIndices.append(indices[2].toInt() - 1);
+          normalIdx = indices[2].toInt() - 1;
         }
       }
     }
+    faceTexInd.append(texIdx);
+    faceNormalInd.append(normalIdx);
   }
-  faceCoordInd.append(faceCoordsIndices);
-  faceTexIndices.append(faceTexIndices);
-  faceNormalIndices.append(faceNormalIndices);
   faceValences.append(values.size() - 1);
 }
-
-/**
- * @brief OBJFile::loadedSuccessfully Checks whether the model was loaded from
- * the .obj successfully.
- * @return True if the load was successful, false otherwise.
- */
-bool OBJFile::loadedSuccessfully() const { return loadSuccess; }
-
-/**
- * @brief OBJFile::normalizeMesh Scales the information in the obj file in such
- * a way that the mesh fits inside a bounding box of desiredScale.
- * @param desiredScale The desired scale.
- */
-void OBJFile::normalizeMesh(float desiredScale) {
-  float scale = calcBoundingBoxScale(vertexCoords, desiredScale);
-  QMatrix4x4 transformMatrix;
-  transformMatrix.setToIdentity();
-  transformMatrix.scale(scale);
-  for (int i = 0; i < vertexCoords.size(); ++i) {
-    QVector3D coord =
-        QVector3D(transformMatrix * QVector4D(vertexCoords[i], 1));
-    vertexCoords[i] = coord;
-  }
-}
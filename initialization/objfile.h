@@ -6,34 +6,70 @@
 #include <QVector3D>
 #include <QVector>
 
+#include "meshfile.h"
+
 /**
  * @brief The OBJFile class is used for storing info from the .obj files.
  */
-class OBJFile {
+class OBJFile : public MeshFile {
  public:
-  OBJFile(const QString& fileName);
-  ~OBJFile();
+  /**
+   * @brief The ParseMode enum selects how the .obj file is read.
+   * TextStream reads and splits the file line by line through Qt strings.
+   * MemoryMapped maps the file and parses the bytes in place without any
+   * per-line allocations. Large mapped files are split at line boundaries and
+   * parsed by multiple threads.
+   */
+  enum class ParseMode { TextStream, MemoryMapped };
+
+  OBJFile(const QString& fileName,
+          ParseMode parseMode = ParseMode::MemoryMapped, int numThreads = 0,
+          bool normalize = true);
+  ~OBJFile() override;
 
-  bool loadedSuccessfully() const;
-  void normalizeMesh(float desiredScale);
+ protected:
+  bool parseContents(const char* begin, const char* end) override;
 
  private:
+  /**
+   * @brief The Chunk struct holds the records parsed from one part of the
+   * file. Relative (negative) indices can refer to elements of earlier
+   * chunks, so they are resolved against the chunk-local counts and their
+   * positions are remembered until the chunk offsets are known.
+   */
+  struct Chunk {
+    QVector<QVector3D> vertexCoords;
+    QVector<QVector2D> textureCoords;
+    QVector<QVector3D> vertexNormals;
+    QVector<int> faceValences;
+    QVector<int> faceCoordInd;
+    QVector<int> faceTexInd;
+    QVector<int> faceNormalInd;
+    QVector<int> relativeCoordInd;
+    QVector<int> relativeTexInd;
+    QVector<int> relativeNormalInd;
+    int ignoredLines = 0;
+  };
+
+  void readTextStream(QFile& file);
+  void parseBuffer(const char* begin, const char* end, int numThreads);
+  void mergeChunks(QVector<Chunk>& chunks, int numThreads);
+  static void parseChunk(const char* begin, const char* end, Chunk& chunk);
+  static bool parseFace(const char* p, const char* end, Chunk& chunk);
+
   void handleVertex(const QStringList& values);
   void handleVertexTexCoords(const QStringList& values);
   void handleVertexNormal(const QStringList& values);
   void handleFace(const QStringList& values);
 
-  QVector<QVector3D> vertexCoords;
   QVector<QVector2D> textureCoords;
   QVector<QVector3D> vertexNormals;
-  QVector<int> faceValences;
-  QVector<QVector<int>> faceCoordInd;
-  QVector<QVector<int>> faceTexInd;
-  QVector<QVector<int>> faceNormalInd;
-
-  bool loadSuccess;
+  // Texture and normal indices share the layout of faceCoordInd. Missing
+  // indices are stored as -1.
+  QVector<int> faceTexInd;
+  QVector<int> faceNormalInd;
 
-  friend class MeshInitializer;
+  int numThreads;
 };
 
 #endif  // OBJFILE_H
@@ -0,0 +1,513 @@
+#include "plyfile.h"
+
+#include <QDebug>
+#include <QList>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+static_assert(sizeof(QVector3D) == 3 * sizeof(float),
+              "QVector3D must be three tightly packed floats");
+
+/**
+ * @brief PLYFile::PLYFile Reads the vertex positions and faces from the
+ * provided binary .ply file.
+ * @param fileName The path of the .ply file.
+ * @param normalize Whether to scale the mesh, see MeshFile::normalizeMesh.
+ */
+PLYFile::PLYFile(const QString& fileName, bool normalize) : bigEndian(false) {
+  qDebug() << ":: Loading" << fileName;
+  loadSuccess = readMapped(fileName);
+  if (loadSuccess) {
+    if (normalize) {
+      normalizeMesh(DESIRED_SCALE);
+    }
+  } else {
+    qDebug() << " * Could not read" << fileName;
+  }
+}
+
+/**
+ * @brief PLYFile::~PLYFile Deconstructor.
+ */
+PLYFile::~PLYFile() {}
+
+/**
+ * @brief PLYFile::parseContents Parses the header and then reads the binary
+ * body element by element.
+ * @param begin Start of the file contents.
+ * @param end End of the file contents.
+ * @return True if the file describes a valid mesh; false otherwise.
+ */
+bool PLYFile::parseContents(const char* begin, const char* end) {
+  const char* p = begin;
+  if (!parseHeader(p, end)) {
+    return false;
+  }
+  for (const Element& element : elements) {
+    bool success;
+    if (element.name == "vertex") {
+      success = readVertices(element, p, end);
+    } else if (element.name == "face") {
+      success = readFaces(element, p, end);
+    } else {
+      success = skipElement(element, p, end);
+    }
+    if (!success) {
+      qDebug() << " * Unexpected end of file in element" << element.name;
+      return false;
+    }
+  }
+  return validIndices();
+}
+
+/**
+ * @brief PLYFile::parseHeader Parses the element and property declarations in
+ * the ASCII header of the file.
+ * @param p Start of the file. Is set to the start of the binary body.
+ * @param end End of the file contents.
+ * @return True if the header is valid and describes a binary file; false
+ * otherwise.
+ */
+bool PLYFile::parseHeader(const char*& p, const char* end) {
+  elements.clear();
+  bool formatFound = false;
+  bool firstLine = true;
+  while (p < end) {
+    const char* lineEnd =
+        static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (lineEnd == nullptr) {
+      return false;
+    }
+    QByteArray line = QByteArray(p, lineEnd - p).simplified();
+    p = lineEnd + 1;
+
+    if (firstLine) {
+      if (line != "ply") {
+        qDebug() << " * Not a .ply file";
+        return false;
+      }
+      firstLine = false;
+      continue;
+    }
+
+    QList<QByteArray> tokens = line.split(' ');
+    const QByteArray& keyword = tokens[0];
+    if (keyword == "format" && tokens.size() >= 2) {
+      if (tokens[1] == "binary_little_endian") {
+        bigEndian = false;
+      } else if (tokens[1] == "binary_big_endian") {
+        bigEndian = true;
+      } else {
+        qDebug() << " * Unsupported .ply format" << tokens[1];
+        return false;
+      }
+      formatFound = true;
+    } else if (keyword == "element" && tokens.size() == 3) {
+      bool ok;
+      qint64 count = tokens[2].toLongLong(&ok);
+      if (!ok || count < 0 || count > INT_MAX) {
+        return false;
+      }
+      elements.append({tokens[1], count, {}});
+    } else if (keyword == "property" && !elements.isEmpty()) {
+      Property property;
+      if (tokens.size() == 5 && tokens[1] == "list") {
+        property = {tokens[4], parseType(tokens[3]), true,
+                    parseType(tokens[2])};
+        if (property.countType == Type::Invalid) {
+          return false;
+        }
+      } else if (tokens.size() == 3) {
+        property = {tokens[2], parseType(tokens[1]), false, Type::Invalid};
+      } else {
+        return false;
+      }
+      if (property.type == Type::Invalid) {
+        return false;
+      }
+      elements.last().properties.append(property);
+    } else if (keyword == "end_header") {
+      return formatFound;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief PLYFile::readVertices Reads the positions of all vertices. When the
+ * positions are stored as consecutive native floats, they are copied in bulk.
+ * @param element The vertex element.
+ * @param p Start of the vertex data. Is set to the end of the vertex data.
+ * @param end End of the file contents.
+ * @return True if the data was read; false if the file is truncated or the
+ * vertices have no position.
+ */
+bool PLYFile::readVertices(const Element& element, const char*& p,
+                           const char* end) {
+  int xIdx = -1, yIdx = -1, zIdx = -1;
+  for (int i = 0; i < element.properties.size(); ++i) {
+    const Property& property = element.properties[i];
+    if (property.isList) {
+      continue;
+    }
+    if (property.name == "x") {
+      xIdx = i;
+    } else if (property.name == "y") {
+      yIdx = i;
+    } else if (property.name == "z") {
+      zIdx = i;
+    }
+  }
+  if (xIdx < 0 || yIdx < 0 || zIdx < 0) {
+    return false;
+  }
+
+  // Check the count against the file size before allocating; the header
+  // alone can claim any number of vertices.
+  if (minimumSize(element) * element.count > end - p) {
+    return false;
+  }
+  int numVertices = element.count;
+  vertexCoords.resize(numVertices);
+
+  qint64 stride = fixedSize(element);
+  if (stride >= 0) {
+    int offset = 0;
+    QVector<int> offsets(element.properties.size());
+    for (int i = 0; i < element.properties.size(); ++i) {
+      offsets[i] = offset;
+      offset += typeSize(element.properties[i].type);
+    }
+    bool nativeFloats =
+        !bigEndian && Q_BYTE_ORDER == Q_LITTLE_ENDIAN &&
+        element.properties[xIdx].type == Type::Float32 &&
+        element.properties[yIdx].type == Type::Float32 &&
+        element.properties[zIdx].type == Type::Float32 &&
+        offsets[yIdx] == offsets[xIdx] + 4 && offsets[zIdx] == offsets[xIdx] + 8;
+
+    if (nativeFloats && stride == sizeof(QVector3D)) {
+      std::memcpy(vertexCoords.data(), p, stride * numVertices);
+    } else if (nativeFloats) {
+      QVector3D* coords = vertexCoords.data();
+      const char* record = p + offsets[xIdx];
+      for (int v = 0; v < numVertices; ++v, record += stride) {
+        std::memcpy(&coords[v], record, sizeof(QVector3D));
+      }
+    } else {
+      const Type xType = element.properties[xIdx].type;
+      const Type yType = element.properties[yIdx].type;
+      const Type zType = element.properties[zIdx].type;
+      const char* record = p;
+      for (int v = 0; v < numVertices; ++v, record += stride) {
+        vertexCoords[v] = QVector3D(readValue(xType, record + offsets[xIdx]),
+                                    readValue(yType, record + offsets[yIdx]),
+                                    readValue(zType, record + offsets[zIdx]));
+      }
+    }
+    p += stride * numVertices;
+    return true;
+  }
+
+  // Vertices with list properties have a variable size and are walked
+  // property by property.
+  for (int v = 0; v < numVertices; ++v) {
+    float coords[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < element.properties.size(); ++i) {
+      const Property& property = element.properties[i];
+      if (property.isList) {
+        if (!skipProperty(property, p, end)) {
+          return false;
+        }
+        continue;
+      }
+      int size = typeSize(property.type);
+      if (size > end - p) {
+        return false;
+      }
+      if (i == xIdx) {
+        coords[0] = readValue(property.type, p);
+      } else if (i == yIdx) {
+        coords[1] = readValue(property.type, p);
+      } else if (i == zIdx) {
+        coords[2] = readValue(property.type, p);
+      }
+      p += size;
+    }
+    vertexCoords[v] = QVector3D(coords[0], coords[1], coords[2]);
+  }
+  return true;
+}
+
+/**
+ * @brief PLYFile::readFaces Reads the vertex indices of all faces. Faces of
+ * which only the index list is stored as native 32-bit integers are copied
+ * face by face without conversion. Faces with fewer than three vertices are
+ * dropped.
+ * @param element The face element.
+ * @param p Start of the face data. Is set to the end of the face data.
+ * @param end End of the file contents.
+ * @return True if the data was read; false if the file is truncated or the
+ * faces have no index list.
+ */
+bool PLYFile::readFaces(const Element& element, const char*& p,
+                        const char* end) {
+  int indicesIdx = -1;
+  for (int i = 0; i < element.properties.size(); ++i) {
+    const Property& property = element.properties[i];
+    if (property.isList && (property.name == "vertex_indices" ||
+                            property.name == "vertex_index")) {
+      indicesIdx = i;
+    }
+  }
+  if (indicesIdx < 0) {
+    return false;
+  }
+
+  if (minimumSize(element) * element.count > end - p) {
+    return false;
+  }
+  int numFaces = element.count;
+
+  const Property& indices = element.properties[indicesIdx];
+  const int indexSize = typeSize(indices.type);
+  const int countSize = typeSize(indices.countType);
+
+  // Most faces are triangles, but no more indices can be stored than fit in
+  // the remaining bytes.
+  faceValences.reserve(numFaces);
+  faceCoordInd.reserve(std::min(3 * qint64(numFaces), (end - p) / indexSize));
+
+  bool nativeIndices = element.properties.size() == 1 && !bigEndian &&
+                       Q_BYTE_ORDER == Q_LITTLE_ENDIAN &&
+                       indices.countType == Type::UInt8 &&
+                       (indices.type == Type::Int32 ||
+                        indices.type == Type::UInt32);
+  if (nativeIndices) {
+    for (int f = 0; f < numFaces; ++f) {
+      if (p >= end) {
+        return false;
+      }
+      int valence = static_cast<uchar>(*p++);
+      if (qint64(valence) * 4 > end - p) {
+        return false;
+      }
+      if (valence >= 3) {
+        int offset = faceCoordInd.size();
+        faceCoordInd.resize(offset + valence);
+        std::memcpy(faceCoordInd.data() + offset, p, 4 * valence);
+        faceValences.append(valence);
+      }
+      p += 4 * valence;
+    }
+    return true;
+  }
+
+  for (int f = 0; f < numFaces; ++f) {
+    for (int i = 0; i < element.properties.size(); ++i) {
+      const Property& property = element.properties[i];
+      if (i != indicesIdx) {
+        if (!skipProperty(property, p, end)) {
+          return false;
+        }
+        continue;
+      }
+      if (countSize > end - p) {
+        return false;
+      }
+      qint64 valence = readValue(property.countType, p);
+      p += countSize;
+      if (valence < 0 || valence * indexSize > end - p) {
+        return false;
+      }
+      if (valence >= 3) {
+        for (int j = 0; j < valence; ++j) {
+          // Range-check before narrowing; unsigned and floating point indices
+          // do not necessarily fit in an int.
+          double index = readValue(property.type, p + j * indexSize);
+          if (!(index >= 0.0 && index <= INT_MAX)) {
+            qDebug() << " * Face refers to a missing vertex" << index;
+            return false;
+          }
+          faceCoordInd.append(int(index));
+        }
+        faceValences.append(valence);
+      }
+      p += valence * indexSize;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief PLYFile::skipElement Skips over all data of an element that is not
+ * used.
+ * @param element The element to skip.
+ * @param p Start of the element data. Is set to the end of the element data.
+ * @param end End of the file contents.
+ * @return True if the element fits in the file; false otherwise.
+ */
+bool PLYFile::skipElement(const Element& element, const char*& p,
+                          const char* end) const {
+  qint64 size = fixedSize(element);
+  if (size >= 0) {
+    if (size * element.count > end - p) {
+      return false;
+    }
+    p += size * element.count;
+    return true;
+  }
+  for (qint64 i = 0; i < element.count; ++i) {
+    for (const Property& property : element.properties) {
+      if (!skipProperty(property, p, end)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief PLYFile::skipProperty Skips over the value(s) of a single property.
+ * @param property The property to skip.
+ * @param p Start of the property. Is set to the end of the property.
+ * @param end End of the file contents.
+ * @return True if the property fits in the file; false otherwise.
+ */
+bool PLYFile::skipProperty(const Property& property, const char*& p,
+                           const char* end) const {
+  qint64 count = 1;
+  if (property.isList) {
+    int countSize = typeSize(property.countType);
+    if (countSize > end - p) {
+      return false;
+    }
+    count = readValue(property.countType, p);
+    p += countSize;
+  }
+  qint64 size = count * typeSize(property.type);
+  if (count < 0 || size > end - p) {
+    return false;
+  }
+  p += size;
+  return true;
+}
+
+/**
+ * @brief PLYFile::readValue Reads a single value in the byte order of the
+ * file.
+ * @param type The type of the value.
+ * @param p Location of the value. Does not need to be aligned.
+ * @return The value.
+ */
+double PLYFile::readValue(Type type, const char* p) const {
+  switch (type) {
+    case Type::Int8:
+      return static_cast<qint8>(*p);
+    case Type::UInt8:
+      return static_cast<quint8>(*p);
+    case Type::Int16:
+      return bigEndian ? qFromBigEndian<qint16>(p)
+                       : qFromLittleEndian<qint16>(p);
+    case Type::UInt16:
+      return bigEndian ? qFromBigEndian<quint16>(p)
+                       : qFromLittleEndian<quint16>(p);
+    case Type::Int32:
+      return bigEndian ? qFromBigEndian<qint32>(p)
+                       : qFromLittleEndian<qint32>(p);
+    case Type::UInt32:
+      return bigEndian ? qFromBigEndian<quint32>(p)
+                       : qFromLittleEndian<quint32>(p);
+    case Type::Float32:
+      return bigEndian ? qFromBigEndian<float>(p) : qFromLittleEndian<float>(p);
+    case Type::Float64:
+      return bigEndian ? qFromBigEndian<double>(p)
+                       : qFromLittleEndian<double>(p);
+    case Type::Invalid:
+      break;
+  }
+  return 0.0;
+}
+
+/**
+ * @brief PLYFile::parseType Converts the name of a type in the header.
+ * @param name Name of the type, e.g. "uchar" or "float32".
+ * @return The type, or Type::Invalid if the name is unknown.
+ */
+PLYFile::Type PLYFile::parseType(const QByteArray& name) {
+  if (name == "char" || name == "int8") {
+    return Type::Int8;
+  } else if (name == "uchar" || name == "uint8") {
+    return Type::UInt8;
+  } else if (name == "short" || name == "int16") {
+    return Type::Int16;
+  } else if (name == "ushort" || name == "uint16") {
+    return Type::UInt16;
+  } else if (name == "int" || name == "int32") {
+    return Type::Int32;
+  } else if (name == "uint" || name == "uint32") {
+    return Type::UInt32;
+  } else if (name == "float" || name == "float32") {
+    return Type::Float32;
+  } else if (name == "double" || name == "float64") {
+    return Type::Float64;
+  }
+  return Type::Invalid;
+}
+
+/**
+ * @brief PLYFile::typeSize Gives the size of a type in bytes.
+ * @param type The type.
+ * @return The size of the type in bytes.
+ */
+int PLYFile::typeSize(Type type) {
+  switch (type) {
+    case Type::Int8:
+    case Type::UInt8:
+      return 1;
+    case Type::Int16:
+    case Type::UInt16:
+      return 2;
+    case Type::Int32:
+    case Type::UInt32:
+    case Type::Float32:
+      return 4;
+    case Type::Float64:
+      return 8;
+    case Type::Invalid:
+      break;
+  }
+  return 0;
+}
+
+/**
+ * @brief PLYFile::fixedSize Gives the size of a single item of an element.
+ * @param element The element.
+ * @return The size in bytes, or -1 if the element contains list properties
+ * and therefore has no fixed size.
+ */
+qint64 PLYFile::fixedSize(const Element& element) {
+  qint64 size = 0;
+  for (const Property& property : element.properties) {
+    if (property.isList) {
+      return -1;
+    }
+    size += typeSize(property.type);
+  }
+  return size;
+}
+
+/**
+ * @brief PLYFile::minimumSize Gives the smallest size a single item of an
+ * element can have, which is reached when all of its lists are empty.
+ * @param element The element.
+ * @return The size in bytes.
+ */
+qint64 PLYFile::minimumSize(const Element& element) {
+  qint64 size = 0;
+  for (const Property& property : element.properties) {
+    size += typeSize(property.isList ? property.countType : property.type);
+  }
+  return size;
+}
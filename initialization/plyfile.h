@@ -0,0 +1,71 @@
+#ifndef PLYFILE_H
+#define PLYFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "meshfile.h"
+
+/**
+ * @brief The PLYFile class reads binary (little or big endian) .ply files.
+ * Only the vertex positions and the vertex indices of the faces are kept; all
+ * other elements and properties are skipped.
+ */
+class PLYFile : public MeshFile {
+ public:
+  PLYFile(const QString& fileName, bool normalize = true);
+  ~PLYFile() override;
+
+ protected:
+  bool parseContents(const char* begin, const char* end) override;
+
+ private:
+  enum class Type {
+    Invalid,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+  };
+
+  /**
+   * @brief The Property struct describes a single property of an element.
+   * List properties store their length (of countType) in front of the values.
+   */
+  struct Property {
+    QByteArray name;
+    Type type;
+    bool isList;
+    Type countType;
+  };
+
+  struct Element {
+    QByteArray name;
+    qint64 count;
+    QVector<Property> properties;
+  };
+
+  bool parseHeader(const char*& p, const char* end);
+  bool readVertices(const Element& element, const char*& p, const char* end);
+  bool readFaces(const Element& element, const char*& p, const char* end);
+  bool skipElement(const Element& element, const char*& p,
+                   const char* end) const;
+  bool skipProperty(const Property& property, const char*& p,
+                    const char* end) const;
+
+  double readValue(Type type, const char* p) const;
+  static Type parseType(const QByteArray& name);
+  static int typeSize(Type type);
+  static qint64 fixedSize(const Element& element);
+  static qint64 minimumSize(const Element& element);
+
+  QVector<Element> elements;
+  bool bigEndian;
+};
+
+#endif  // PLYFILE_H
@@ -0,0 +1,145 @@
+#include "stlfile.h"
+
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+// An 80 byte header followed by the number of triangles.
+#define STL_HEADER_SIZE 84
+// A normal, three corners and a 16-bit attribute.
+#define STL_TRIANGLE_SIZE 50
+
+/**
+ * @brief STLFile::STLFile Reads the triangles from the provided binary .stl
+ * file and welds their corners into a shared vertex list.
+ * @param fileName The path of the .stl file.
+ * @param normalize Whether to scale the mesh, see MeshFile::normalizeMesh.
+ */
+STLFile::STLFile(const QString& fileName, bool normalize) {
+  qDebug() << ":: Loading" << fileName;
+  loadSuccess = readMapped(fileName);
+  if (loadSuccess) {
+    if (normalize) {
+      normalizeMesh(DESIRED_SCALE);
+    }
+  } else {
+    qDebug() << " * Could not read" << fileName;
+  }
+}
+
+/**
+ * @brief STLFile::~STLFile Deconstructor.
+ */
+STLFile::~STLFile() {}
+
+/**
+ * @brief STLFile::parseContents Reads the corner positions of all triangles
+ * and welds them. The stored facet normals are ignored.
+ * @param begin Start of the file contents.
+ * @param end End of the file contents.
+ * @return True if the file is a valid binary .stl file; false otherwise.
+ */
+bool STLFile::parseContents(const char* begin, const char* end) {
+  qint64 size = end - begin;
+  if (size < STL_HEADER_SIZE) {
+    return false;
+  }
+  qint64 numTriangles = qFromLittleEndian<quint32>(begin + 80);
+  if (size < STL_HEADER_SIZE + numTriangles * STL_TRIANGLE_SIZE ||
+      3 * numTriangles > INT_MAX) {
+    if (std::strncmp(begin, "solid", 5) == 0) {
+      qDebug() << " * ASCII .stl files are not supported";
+    }
+    return false;
+  }
+
+  QVector<QVector3D> corners(3 * numTriangles);
+  const char* triangle = begin + STL_HEADER_SIZE;
+  for (int t = 0; t < numTriangles; ++t, triangle += STL_TRIANGLE_SIZE) {
+    // Skip the facet normal.
+    const char* p = triangle + 12;
+    for (int c = 0; c < 3; ++c, p += 12) {
+      // Adding zero turns -0 into +0, so that both weld together.
+      corners[3 * t + c] = QVector3D(qFromLittleEndian<float>(p) + 0.0f,
+                                     qFromLittleEndian<float>(p + 4) + 0.0f,
+                                     qFromLittleEndian<float>(p + 8) + 0.0f);
+    }
+  }
+  weldVertices(corners);
+  return true;
+}
+
+/**
+ * @brief STLFile::weldVertices Merges corners with bitwise identical positions
+ * into a single vertex and builds the triangles on top of the merged
+ * vertices. The corners are sorted by position, so that equal positions end
+ * up next to each other. Vertices are numbered in order of first appearance,
+ * which keeps the result independent of the sort. Triangles that collapse
+ * because two of their corners were welded together are dropped.
+ * @param corners The corner positions of all triangles, three per triangle.
+ */
+void STLFile::weldVertices(const QVector<QVector3D>& corners) {
+  const int numCorners = corners.size();
+  std::vector<int> order(numCorners);
+  for (int c = 0; c < numCorners; ++c) {
+    order[c] = c;
+  }
+  auto key = [&corners](int c) {
+    quint32 bits[3];
+    std::memcpy(bits, &corners[c], sizeof(bits));
+    return std::make_tuple(bits[0], bits[1], bits[2]);
+  };
+  std::sort(order.begin(), order.end(),
+            [&key](int a, int b) { return key(a) < key(b); });
+
+  std::vector<int> group(numCorners);
+  int numGroups = 0;
+  for (int i = 0; i < numCorners; ++i) {
+    if (i > 0 && key(order[i]) != key(order[i - 1])) {
+      ++numGroups;
+    }
+    group[order[i]] = numGroups;
+  }
+  if (numCorners > 0) {
+    ++numGroups;
+  }
+
+  std::vector<int> vertexOfGroup(numGroups, -1);
+  std::vector<int> vertexOfCorner(numCorners);
+  vertexCoords.clear();
+  vertexCoords.reserve(numGroups);
+  for (int c = 0; c < numCorners; ++c) {
+    int& vertex = vertexOfGroup[group[c]];
+    if (vertex < 0) {
+      vertex = vertexCoords.size();
+      vertexCoords.append(corners[c]);
+    }
+    vertexOfCorner[c] = vertex;
+  }
+
+  faceValences.clear();
+  faceCoordInd.clear();
+  faceValences.reserve(numCorners / 3);
+  faceCoordInd.reserve(numCorners);
+  int numDegenerate = 0;
+  for (int c = 0; c < numCorners; c += 3) {
+    int v0 = vertexOfCorner[c];
+    int v1 = vertexOfCorner[c + 1];
+    int v2 = vertexOfCorner[c + 2];
+    if (v0 == v1 || v1 == v2 || v2 == v0) {
+      ++numDegenerate;
+      continue;
+    }
+    faceCoordInd.append(v0);
+    faceCoordInd.append(v1);
+    faceCoordInd.append(v2);
+    faceValences.append(3);
+  }
+  if (numDegenerate > 0) {
+    qDebug() << " * Dropped" << numDegenerate << "degenerate triangles";
+  }
+}
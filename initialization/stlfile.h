@@ -0,0 +1,25 @@
+#ifndef STLFILE_H
+#define STLFILE_H
+
+#include <QString>
+
+#include "meshfile.h"
+
+/**
+ * @brief The STLFile class reads binary .stl files. STL stores every triangle
+ * with its own copy of the corner positions, so corners with identical
+ * positions are welded into shared vertices to recover the connectivity.
+ */
+class STLFile : public MeshFile {
+ public:
+  STLFile(const QString& fileName, bool normalize = true);
+  ~STLFile() override;
+
+ protected:
+  bool parseContents(const char* begin, const char* end) override;
+
+ private:
+  void weldVertices(const QVector<QVector3D>& corners);
+};
+
+#endif  // STLFILE_H
@@ -92,12 +92,34 @@ void MainView::updateMatrices() {
 }
 
 /**
- * @brief MainView::updateBuffers Updates the buffers of the renderers.
- * @param mesh The mesh used to update the buffer content with.
+ * @brief MainView::updateBuffers Displays the provided mesh. The buffers of
+ * the renderers are only updated if the mesh differs from the one that is
+ * currently displayed.
+ * @param mesh Snapshot of the mesh to display. Its attributes have to be
+ * extracted already. Null handles are ignored.
  */
-void MainView::updateBuffers(Mesh& mesh) {
-    mesh.extractAttributes();
-    meshRenderer.updateBuffers(mesh);
+void MainView::updateBuffers(const MeshHandle& mesh) {
+    if (!mesh.isNull() && mesh != currentMesh) {
+        currentMesh = mesh;
+        meshRenderer.updateBuffers(*mesh);
+    }
+    update();
+}
+
+/**
+ * @brief MainView::updateVertices Displays an edited copy of the displayed
+ * mesh, re-uploading only the vertices in which the two differ.
+ * @param mesh The edited mesh, with the connectivity of the displayed one.
+ * @param vertices Indices of the changed vertices, in ascending order.
+ */
+void MainView::updateVertices(const MeshHandle& mesh,
+                              const QVector<int>& vertices) {
+    if (!mesh.isNull()) {
+        currentMesh = mesh;
+        makeCurrent();
+        meshRenderer.updateVertices(*currentMesh, vertices);
+        doneCurrent();
+    }
     update();
 }
 
@@ -143,7 +165,8 @@ QVector2D MainView::toNormalizedScreenCoordinates(float x, float y) {
 
 /**
  * @brief MainView::mouseMoveEvent Handles the dragging and rotating of the mesh
- * by looking at the mouse movement.
+ * by looking at the mouse movement. In vertex selection mode, the selected
+ * vertex is dragged instead.
  * @param event Mouse event.
  */
 void MainView::mouseMoveEvent(QMouseEvent* event) {
@@ -189,16 +212,54 @@ void MainView::mouseMoveEvent(QMouseEvent* event) {
             dragging = false;
             oldVec = QVector3D();
         }
+    } else {
+        dragSelectedVertex(event);
     }
 }
 
 /**
- * @brief MainView::mousePressEvent Handles presses by the mouse. Currently does
- * nothing except setting focus.
+ * @brief MainView::dragSelectedVertex Drags the selected vertex along with the
+ * mouse, within the plane through the vertex that is parallel to the screen.
+ * Emits the movement since the previous event as vertexDragged.
+ * @param event Mouse event.
+ */
+void MainView::dragSelectedVertex(QMouseEvent* event) {
+    int vertex = settings.selectedVertex;
+    if (event->buttons() != Qt::LeftButton || vertex < 0 ||
+        currentMesh.isNull() || vertex >= currentMesh->numVerts()) {
+        dragging = false;
+        return;
+    }
+    QVector3D mouse = toNormalizedDeviceCoordinates(event->position().x(),
+                                                    event->position().y());
+    if (!dragging) {
+        dragging = true;
+        oldVec = mouse;
+        return;
+    }
+    QMatrix4x4 transform = settings.projectionMatrix * settings.modelViewMatrix;
+    QVector4D clip = transform * QVector4D(currentMesh->coords(vertex), 1.0f);
+    float depth = clip.z() / clip.w();
+    QMatrix4x4 inverse = transform.inverted();
+    QVector3D from =
+        (inverse * QVector4D(oldVec.x(), oldVec.y(), depth, 1.0f))
+            .toVector3DAffine();
+    QVector3D to =
+        (inverse * QVector4D(mouse.x(), mouse.y(), depth, 1.0f))
+            .toVector3DAffine();
+    oldVec = mouse;
+    emit vertexDragged(vertex, to - from);
+}
+
+/**
+ * @brief MainView::mousePressEvent Handles presses by the mouse. Sets focus
+ * and, in vertex selection mode, selects the vertex closest to the cursor.
  * @param event Mouse event.
  */
 void MainView::mousePressEvent(QMouseEvent* event) {
     setFocus();
+    // Every press starts a new drag
+    dragging = false;
     // Only works when vertex selection is checked
     if (settings.renderVertexSelection){
         if (event->buttons() == Qt::LeftButton) {
@@ -228,6 +289,7 @@ void MainView::mousePressEvent(QMouseEvent* event) {
             int indexPos = findClosest(ray_wor,0.4f);
             // Update index of the point
             settings.selectedVertex = indexPos;
+            emit vertexSelected(indexPos);
 
             updateMatrices();
             update();
@@ -310,9 +372,12 @@ QVector3D MainView::toNormalizedDeviceCoordinates(int mouse_x, int mouse_y){
 int MainView::findClosest(const QVector3D& p, const float maxDist) {
   int ptIndex = -1;
   float currentDist, minDist = 4;
-  QVector<QVector3D> vertices = currentVertices;
+  if (currentMesh.isNull()) {
+    return -1;
+  }
+  const QVector<QVector3D>& vertices = currentMesh->getVertexCoords();
 
-  for (int k = 0; k < currentVertices.size(); k++) {
+  for (int k = 0; k < vertices.size(); k++) {
     currentDist = vertices[k].distanceToPoint(p);
     if (currentDist < minDist) {
       minDist = currentDist;
@@ -324,7 +389,3 @@ int MainView::findClosest(const QVector3D& p, const float maxDist) {
   }
   return ptIndex;
 }
-
-void MainView::updateCurrentMesh(const QVector<QVector3D> newVertice){
-    currentVertices = newVertice;
-}
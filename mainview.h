@@ -26,13 +26,16 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
 
   void updateMatrices();
   void updateUniforms();
-  void updateBuffers(Mesh& mesh);
+  void updateBuffers(const MeshHandle& mesh);
+  void updateVertices(const MeshHandle& mesh, const QVector<int>& vertices);
   float angleBetweenVectors(const QVector2D& vec1, const QVector2D& vec2);
   int findClosest(const QVector3D& p, const float maxDist);
-  QVector<QVector3D> currentVertices;
-  void updateCurrentMesh(QVector<QVector3D> newVertice);
   void resizeGL(int newWidth, int newHeight);
 
+ signals:
+  void vertexSelected(int vertex);
+  void vertexDragged(int vertex, const QVector3D& offset);
+
 
 
  protected:
@@ -47,6 +50,7 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
  private:
   QVector2D toNormalizedScreenCoordinates(float x, float y);
   QVector3D toNormalizedDeviceCoordinates(int mouse_x, int mouse_y);
+  void dragSelectedVertex(QMouseEvent* event);
 
   QOpenGLDebugLogger debugLogger;
 
@@ -57,6 +61,8 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_1_Core {
   bool dragging;
 
   MeshRenderer meshRenderer;
+  // The mesh that is currently displayed and picked from.
+  MeshHandle currentMesh;
 
   Settings settings;
 
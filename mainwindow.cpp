@@ -1,22 +1,58 @@
 #include "mainwindow.h"
 
+#include <QFileInfo>
+#include <QMessageBox>
+#include <algorithm>
+#include <climits>
+
+#include "exporters/meshexporter.h"
+#include "initialization/meshcache.h"
 #include "initialization/meshinitializer.h"
-#include "initialization/objfile.h"
-#include "subdivision/loopsubdivider.h"
+#include "initialization/meshfile.h"
 #include "ui_mainwindow.h"
 #include "settings.h"
 
+// Maximum distance between an adaptive tessellation and the limit surface,
+// relative to the bounding box diagonal of the base mesh.
+#define ADAPTIVE_FLATNESS_TOLERANCE 0.0005f
+
+/**
+ * @brief boundingBoxDiagonal Computes the length of the diagonal of the
+ * axis-aligned bounding box of a mesh.
+ * @param mesh The mesh.
+ * @return The length of the diagonal; 0 for an empty mesh.
+ */
+static float boundingBoxDiagonal(const Mesh& mesh) {
+    if (mesh.numVerts() == 0) {
+        return 0.0f;
+    }
+    QVector3D minCoords = mesh.coords(0);
+    QVector3D maxCoords = minCoords;
+    for (int v = 1; v < mesh.numVerts(); v++) {
+        QVector3D coords = mesh.coords(v);
+        for (int i = 0; i < 3; i++) {
+            minCoords[i] = std::min(minCoords[i], coords[i]);
+            maxCoords[i] = std::max(maxCoords[i], coords[i]);
+        }
+    }
+    return (maxCoords - minCoords).length();
+}
 
 /**
  * @brief MainWindow::MainWindow Creates a new Main Window UI.
  * @param parent Qt parent widget.
  */
 MainWindow::MainWindow(QWidget* parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow) {
+    : QMainWindow(parent),
+      ui(new Ui::MainWindow),
+      adaptiveLevel(0),
+      adaptiveRegionVertex(-1) {
     ui->setupUi(this);
     ui->MeshGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->IsophotesGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->RendererGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
+    ui->ExportMesh->setEnabled(ui->MainDisplay->settings.modelLoaded);
+    ui->MemoryBudget->setValue(int(levelCache.memoryBudget() >> 20));
 }
 
 /**
@@ -24,24 +60,50 @@ MainWindow::MainWindow(QWidget* parent)
  */
 MainWindow::~MainWindow() {
     delete ui;
-    meshes.clear();
-    meshes.squeeze();
+    levelCache.clear();
 }
 
 /**
- * @brief MainWindow::importOBJ Imports an obj file and adds the constructed
- * half-edge to the collection of meshes.
- * @param fileName Path of the .obj file.
+ * @brief MainWindow::loadBaseMesh Loads the base mesh from an .obj, .ply or
+ * .stl file or a binary mesh cache (.hemesh) and makes it the base mesh of the
+ * level cache.
+ * @param fileName Path of the mesh file.
+ * @return True if the mesh was loaded successfully; false otherwise.
+ */
+bool MainWindow::loadBaseMesh(const QString& fileName) {
+    levelCache.clear();
+    limitSource.clear();
+    limitMesh.clear();
+    adaptiveMesh.clear();
+    incrementalSubdivider.clear();
+
+    if (QFileInfo(fileName).suffix().toLower() == "hemesh") {
+        MeshCache meshCache;
+        Mesh mesh;
+        if (!meshCache.load(fileName, mesh)) {
+            return false;
+        }
+        levelCache.setBaseMesh(std::move(mesh));
+        return true;
+    }
+
+    std::unique_ptr<MeshFile> newModel = MeshFile::open(fileName);
+    if (!newModel || !newModel->loadedSuccessfully()) {
+        return false;
+    }
+    MeshInitializer meshInitializer;
+    levelCache.setBaseMesh(meshInitializer.constructHalfEdgeMesh(*newModel));
+    return true;
+}
+
+/**
+ * @brief MainWindow::importOBJ Imports a mesh file (or a binary mesh cache)
+ * and makes the constructed half-edge mesh the base mesh.
+ * @param fileName Path of the mesh file.
  */
 void MainWindow::importOBJ(const QString& fileName) {
-  OBJFile newModel = OBJFile(fileName);
-    meshes.clear();
-    meshes.squeeze();
-
-    if (newModel.loadedSuccessfully()) {
-        MeshInitializer meshInitializer;
-        meshes.append(meshInitializer.constructHalfEdgeMesh(newModel));
-        ui->MainDisplay->updateBuffers(meshes[0]);
+    if (loadBaseMesh(fileName)) {
+        ui->MainDisplay->updateBuffers(displayMesh(0));
         ui->MainDisplay->settings.modelLoaded = true;
         ui->MainDisplay->settings.renderBasicModel = true;
         ui->MainDisplay->settings.selectedVertex = -1;
@@ -69,30 +131,213 @@ void MainWindow::importOBJ(const QString& fileName) {
 
     ui->IsophotesGroupBox->setEnabled(ui->MainDisplay->settings.isophotesRender);
     ui->RendererGroupBox->setEnabled(ui->MainDisplay->settings.modelLoaded);
+    ui->ExportMesh->setEnabled(ui->MainDisplay->settings.modelLoaded);
     ui->SubdivSteps->setValue(0);
     ui->frequencySteps->setValue(0);
     ui->MainDisplay->update();
 }
 
 /**
- * @brief MainWindow::importOBJ Imports an obj file and adds the constructed
- * half-edge to the collection of meshes.
+ * @brief MainWindow::importOBJ Imports an obj file and makes the constructed
+ * half-edge mesh the base mesh.
  * @param fileName Path of the .obj file.
  */
 void MainWindow::importOBJVertexSelection(const QString& fileName) {
-  OBJFile newModel = OBJFile(fileName);
-    meshes.clear();
-    meshes.squeeze();
-
-    if (newModel.loadedSuccessfully()) {
-        MeshInitializer meshInitializer;
-        meshes.append(meshInitializer.constructHalfEdgeMesh(newModel));
-        ui->MainDisplay->updateBuffers(meshes[0]);
+    if (loadBaseMesh(fileName)) {
+        ui->MainDisplay->updateBuffers(displayMesh(0));
         ui->MainDisplay->settings.modelLoaded = true;
     }
     else {
         ui->MainDisplay->settings.modelLoaded = false;
     }
+    ui->ExportMesh->setEnabled(ui->MainDisplay->settings.modelLoaded);
+    ui->MainDisplay->update();
+}
+
+/**
+ * @brief MainWindow::displayMesh Retrieves the mesh to display for a
+ * subdivision level: the level itself, its projection onto the limit surface,
+ * or a tessellation of the limit surface up to that level that is adaptive or
+ * restricted to the region around the selected vertex, depending on the
+ * enabled options.
+ * @param level The subdivision level.
+ * @return Handle to the mesh. Null if the level does not fit in the memory
+ * budget.
+ */
+MeshHandle MainWindow::displayMesh(int level) {
+    int regionVertex = regionControlVertex();
+    if (ui->adaptiveCheckBox->isChecked() || regionVertex >= 0) {
+        MeshHandle base = levelCache.level(0);
+        bool stale = adaptiveMesh.isNull() || adaptiveLevel != level ||
+                     adaptiveRegionVertex != regionVertex;
+        MeshHandle triangles = stale ? tessellationMesh() : MeshHandle();
+        if (!triangles.isNull()) {
+            configureTessellation(*base, level, regionVertex);
+            adaptiveLevel = level;
+            adaptiveRegionVertex = regionVertex;
+            adaptiveMesh =
+                MeshHandle(new Mesh(adaptiveSubdivider.subdivide(*triangles)));
+        }
+        // Control vertices keep their index in every displayed mesh, so the
+        // selection stays valid.
+        if (regionVertex >= 0) {
+            ui->MainDisplay->settings.selectedVertex = regionVertex;
+        }
+        return adaptiveMesh;
+    }
+    MeshHandle handle = levelCache.level(level);
+    if (handle.isNull() || !ui->limitSurfaceCheckBox->isChecked()) {
+        return handle;
+    }
+    if (handle != limitSource) {
+        limitSource = handle;
+        limitMesh = MeshHandle(new Mesh(limitProjector.project(*handle)));
+    }
+    return limitMesh;
+}
+
+/**
+ * @brief MainWindow::showsTessellation Checks whether displayMesh shows a
+ * tessellation of the limit surface instead of a uniform level.
+ * @return True if adaptive subdivision is enabled, or if refining around the
+ * selection is enabled and a vertex is selected; false otherwise.
+ */
+bool MainWindow::showsTessellation() {
+    return ui->adaptiveCheckBox->isChecked() || regionControlVertex() >= 0;
+}
+
+/**
+ * @brief MainWindow::tessellationMesh Retrieves the triangle mesh that is
+ * tessellated: the base mesh, or the first level if the base mesh has other
+ * faces, since the limit surface is evaluated on triangles.
+ * @return Handle to the mesh. Null if there is no base mesh, or if the first
+ * level does not fit in the memory budget.
+ */
+MeshHandle MainWindow::tessellationMesh() {
+    MeshHandle base = levelCache.level(0);
+    if (base.isNull() || base->isTriangleMesh()) {
+        return base;
+    }
+    return levelCache.level(1);
+}
+
+/**
+ * @brief MainWindow::configureTessellation Sets up the adaptive subdivider
+ * with the current options, for the mesh returned by tessellationMesh.
+ * @param base The base mesh.
+ * @param level The maximum subdivision level.
+ * @param regionVertex The control vertex to refine around; -1 to refine
+ * everywhere.
+ */
+void MainWindow::configureTessellation(const Mesh& base, int level,
+                                       int regionVertex) {
+    adaptiveSubdivider.setMaxLevel(level);
+    float tolerance = ADAPTIVE_FLATNESS_TOLERANCE * boundingBoxDiagonal(base);
+    adaptiveSubdivider.setFlatnessTolerance(
+        ui->adaptiveCheckBox->isChecked() ? tolerance : 0.0f);
+    if (regionVertex >= 0) {
+        QVector<int> region = AdaptiveSubdivider::ringFaces(
+            base, {regionVertex}, ui->RegionRings->value());
+        if (!base.isTriangleMesh()) {
+            region = LoopSubdivider::childFaces(base, region);
+        }
+        adaptiveSubdivider.setRegionOfInterest(region);
+    } else {
+        adaptiveSubdivider.clearRegionOfInterest();
+    }
+}
+
+/**
+ * @brief MainWindow::tessellationFitsBudget Checks whether the tessellation
+ * of a level fits in the memory budget, next to the mesh it is computed from.
+ * Its size is predicted from the levels of the faces, without computing it. A
+ * face at level l has 4^l triangles; shared grid vertices are counted once per
+ * face, so the prediction is an upper bound.
+ * @param level The maximum subdivision level.
+ * @param required Is set to the predicted memory in bytes.
+ * @return True if the tessellation fits; false otherwise.
+ */
+bool MainWindow::tessellationFitsBudget(int level, qint64& required) {
+    MeshHandle base = levelCache.level(0);
+    if (!base->isTriangleMesh() && !levelCache.fitsBudget(1)) {
+        required = levelCache.requiredMemory(1);
+        return false;
+    }
+    MeshHandle triangles = tessellationMesh();
+    configureTessellation(*base, level, regionControlVertex());
+    QVector<int> faceLevels = adaptiveSubdivider.faceLevels(*triangles);
+    qint64 numVerts = 0;
+    qint64 numFaces = 0;
+    for (int faceLevel : faceLevels) {
+        qint64 n = qint64(1) << faceLevel;
+        numVerts += (n + 1) * (n + 2) / 2;
+        numFaces += n * n;
+    }
+    required = base->memoryFootprint() +
+               Mesh::predictFootprint(numVerts, 3 * numFaces, numFaces, true);
+    if (triangles != base) {
+        required += triangles->memoryFootprint();
+    }
+    return 3 * numFaces <= INT_MAX && numVerts <= INT_MAX &&
+           required <= levelCache.memoryBudget();
+}
+
+/**
+ * @brief MainWindow::controlVertex Finds the control vertex that belongs to a
+ * vertex of the displayed mesh: the vertex itself if it is a control vertex,
+ * or otherwise the control vertex closest to it.
+ * @param vertex Index of the vertex in the displayed mesh.
+ * @return Index of the control vertex in the base mesh. -1 if the vertex does
+ * not exist.
+ */
+int MainWindow::controlVertex(int vertex) {
+    MeshHandle base = levelCache.level(0);
+    const MeshHandle& current = ui->MainDisplay->currentMesh;
+    if (base.isNull() || current.isNull() || vertex < 0 ||
+        vertex >= current->numVerts()) {
+        return -1;
+    }
+    // The control vertices come first in every subdivided mesh.
+    if (vertex < base->numVerts()) {
+        return vertex;
+    }
+    QVector3D position = current->coords(vertex);
+    int closest = -1;
+    float minDistance = 0.0f;
+    for (int v = 0; v < base->numVerts(); ++v) {
+        float distance = base->coords(v).distanceToPoint(position);
+        if (closest < 0 || distance < minDistance) {
+            closest = v;
+            minDistance = distance;
+        }
+    }
+    return closest;
+}
+
+/**
+ * @brief MainWindow::regionControlVertex Finds the control vertex to refine
+ * around, see controlVertex.
+ * @return Index of the control vertex in the base mesh. -1 if refining around
+ * the selection is disabled or no vertex is selected.
+ */
+int MainWindow::regionControlVertex() {
+    if (!ui->regionCheckBox->isChecked()) {
+        return -1;
+    }
+    return controlVertex(ui->MainDisplay->settings.selectedVertex);
+}
+
+/**
+ * @brief MainWindow::refreshAdaptiveMesh Discards the last adaptive
+ * tessellation and displays the current level again with the current
+ * options, checking the memory budget like a change of level does.
+ */
+void MainWindow::refreshAdaptiveMesh() {
+    adaptiveMesh.clear();
+    if (levelCache.isEmpty()) {
+        return;
+    }
+    on_SubdivSteps_valueChanged(ui->SubdivSteps->value());
     ui->MainDisplay->update();
 }
 
@@ -100,30 +345,149 @@ void MainWindow::importOBJVertexSelection(const QString& fileName) {
 
 void MainWindow::on_LoadOBJ_pressed() {
   QString filename = QFileDialog::getOpenFileName(
-      this, "Import OBJ File", "../", tr("Obj Files (*.obj)"));
+      this, "Import Mesh File", "../",
+      tr("Meshes (*.obj *.ply *.stl *.hemesh);;Obj Files (*.obj);;"
+         "PLY Files (*.ply);;STL Files (*.stl);;Mesh Cache (*.hemesh)"));
     importOBJ(filename);
 }
 
+void MainWindow::on_ExportMesh_pressed() {
+    if (levelCache.isEmpty()) {
+        return;
+    }
+    QString filename = QFileDialog::getSaveFileName(
+        this, "Export Mesh", "../",
+        tr("PLY Files (*.ply);;glTF Binary (*.glb);;Obj Files (*.obj);;"
+           "Mesh Cache (*.hemesh)"));
+    if (filename.isEmpty()) {
+        return;
+    }
+    MeshHandle handle = displayMesh(ui->SubdivSteps->value());
+    if (handle.isNull()) {
+        return;
+    }
+    const Mesh& mesh = *handle;
+    if (QFileInfo(filename).suffix().toLower() == "hemesh") {
+        MeshCache().save(mesh, filename);
+    } else {
+        MeshExporter().save(mesh, filename);
+    }
+}
+
 void MainWindow::on_MeshPresetComboBox_currentTextChanged(
     const QString& meshName) {
     importOBJ(":/models/" + meshName + ".obj");
 }
 
 void MainWindow::on_SubdivSteps_valueChanged(int value) {
-    Subdivider* subdivider = new LoopSubdivider();
-    for (int k = meshes.size() - 1; k < value; k++) {
-       meshes.append(subdivider->subdivide(meshes[k]));
+    if (levelCache.isEmpty()) {
+        return;
     }
+    // A tessellation only reads the base mesh, or the first level of a mesh
+    // that is not made of triangles, so the uniform levels do not have to
+    // fit; the tessellation itself does.
+    bool fits;
+    qint64 required;
+    if (showsTessellation()) {
+        fits = tessellationFitsBudget(value, required);
+    } else {
+        fits = levelCache.fitsBudget(value);
+        required = levelCache.requiredMemory(value);
+    }
+    if (!fits) {
+        QMessageBox::warning(
+            this, "Memory budget",
+            QString("Subdivision level %1 needs about %2 MB, but the memory "
+                    "budget is %3 MB.")
+                .arg(value)
+                .arg(required >> 20)
+                .arg(levelCache.memoryBudget() >> 20));
+        ui->SubdivSteps->setValue(value - 1);
+        return;
+    }
+    ui->MainDisplay->updateBuffers(displayMesh(value));
+}
 
-    QVector<Vertex> newVertex =  meshes[value].getVertices();
-    QVector<QVector3D>newCoords ;
-    for (int i =0;i<newVertex.count();i++)
-    {
-        newCoords.append(newVertex[i].coords);
+void MainWindow::on_MemoryBudget_valueChanged(int megabytes) {
+    levelCache.setMemoryBudget(qint64(megabytes) << 20);
+}
+
+void MainWindow::on_limitSurfaceCheckBox_toggled(bool checked) {
+    if (!checked) {
+        limitSource.clear();
+        limitMesh.clear();
+    }
+    if (levelCache.isEmpty()) {
+        return;
+    }
+    ui->MainDisplay->updateBuffers(displayMesh(ui->SubdivSteps->value()));
+    ui->MainDisplay->update();
+}
+
+void MainWindow::on_adaptiveCheckBox_toggled(bool checked) {
+    ui->limitSurfaceCheckBox->setEnabled(!checked);
+    refreshAdaptiveMesh();
+}
+
+void MainWindow::on_regionCheckBox_toggled(bool checked) {
+    ui->RegionRings->setEnabled(checked);
+    refreshAdaptiveMesh();
+}
+
+void MainWindow::on_RegionRings_valueChanged(int rings) {
+    if (ui->regionCheckBox->isChecked()) {
+        refreshAdaptiveMesh();
+    }
+}
+
+void MainWindow::on_MainDisplay_vertexSelected(int vertex) {
+    if (ui->regionCheckBox->isChecked() && vertex >= 0) {
+        refreshAdaptiveMesh();
+    }
+}
+
+void MainWindow::on_MainDisplay_vertexDragged(int vertex,
+                                              const QVector3D& offset) {
+    // Only the uniform levels are updated incrementally. The limit projection
+    // and the tessellations would be recomputed in full for every mouse move,
+    // so dragging is disabled while they are shown.
+    if (showsTessellation() || ui->limitSurfaceCheckBox->isChecked()) {
+        return;
+    }
+    int level = ui->SubdivSteps->value();
+    int control = controlVertex(vertex);
+    MeshHandle current = levelCache.level(level);
+    if (control < 0 || current.isNull()) {
+        return;
+    }
+    // Start editing the cached levels, unless they are being edited already.
+    if (incrementalSubdivider.numLevels() != level + 1 ||
+        incrementalSubdivider.level(level) != current) {
+        QVector<MeshHandle> levels;
+        for (int l = 0; l <= level; ++l) {
+            levels.append(levelCache.level(l));
+        }
+        incrementalSubdivider.setLevels(levels);
+    }
+    QVector3D position = incrementalSubdivider.level(0)->coords(control);
+    incrementalSubdivider.moveVertices({control}, {position + offset});
+
+    // The edit publishes new levels and leaves the old snapshots untouched, so
+    // everything derived from them is outdated.
+    levelCache.replaceLevels(incrementalSubdivider.levels());
+    limitSource.clear();
+    limitMesh.clear();
+    adaptiveMesh.clear();
+    ui->MainDisplay->settings.selectedVertex = control;
+
+    MeshHandle edited = incrementalSubdivider.level(level);
+    if (ui->MainDisplay->currentMesh == current) {
+        ui->MainDisplay->updateVertices(
+            edited, incrementalSubdivider.changedVertices(level));
+    } else {
+        ui->MainDisplay->updateBuffers(edited);
+        ui->MainDisplay->update();
     }
-    ui->MainDisplay->updateCurrentMesh(newCoords);
-    ui->MainDisplay->updateBuffers(meshes[value]);
-    delete subdivider;
 }
 
 void MainWindow::on_phongShadingCheckBox_toggled(bool checkedPhong){
@@ -166,14 +530,14 @@ void MainWindow::on_isophotesCheckBox_toggled(bool checkedIsophote){
 
 
     int valueSubDivision = ui->SubdivSteps->value();
-    ui->MainDisplay->updateBuffers(meshes[valueSubDivision]);
+    ui->MainDisplay->updateBuffers(displayMesh(valueSubDivision));
     update();
 }
 void MainWindow::on_frequencySteps_valueChanged(int freq){
     ui->MainDisplay->settings.frequencyIsophotes = freq;
     ui->MainDisplay->settings.uniformUpdateRequired = true;
     int valueSubDivision = ui->SubdivSteps->value();
-    ui->MainDisplay->updateBuffers(meshes[valueSubDivision]);
+    ui->MainDisplay->updateBuffers(displayMesh(valueSubDivision));
     update();
 }
 void MainWindow::on_colorStripesComboBox_currentTextChanged(
@@ -189,7 +553,7 @@ void MainWindow::on_colorStripesComboBox_currentTextChanged(
     }
     ui->MainDisplay->settings.uniformUpdateRequired = true;
     int valueSubDivision = ui->SubdivSteps->value();
-    ui->MainDisplay->updateBuffers(meshes[valueSubDivision]);
+    ui->MainDisplay->updateBuffers(displayMesh(valueSubDivision));
     update();
     update();
 
@@ -208,22 +572,13 @@ void MainWindow::on_vertexSelectionCheckBox_toggled(bool checked)
 
     int valueSubDivision = ui->SubdivSteps->value();
     on_SubdivSteps_valueChanged(valueSubDivision);
-
-    Mesh newMesh = meshes[valueSubDivision];
-    QVector<Vertex> newVertex =  newMesh.getVertices();
-    QVector<QVector3D>newCoords ;
-     for (int   i =0;i<newVertex.count();i++)
-     {
-         newCoords.append(newVertex[i].coords);
-     }
-     ui->MainDisplay->updateCurrentMesh(newCoords);
     }
     else{
        if (ui->MainDisplay->settings.phongShadingRender)
        {
        ui->MainDisplay->settings.selectedVertex = -1;
        int valueSubDivision = ui->SubdivSteps->value();
-       ui->MainDisplay->updateBuffers(meshes[valueSubDivision]);
+       ui->MainDisplay->updateBuffers(displayMesh(valueSubDivision));
        }
     }
     ui->MainDisplay->paintGL();
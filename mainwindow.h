@@ -6,6 +6,10 @@
 
 #include "mesh/mesh.h"
 #include "settings.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/incrementalsubdivider.h"
+#include "subdivision/levelcache.h"
+#include "subdivision/limitprojector.h"
 #include "subdivision/subdivider.h"
 
 namespace Ui {
@@ -24,8 +28,16 @@ class MainWindow : public QMainWindow {
 
  private slots:
   void on_LoadOBJ_pressed();
+  void on_ExportMesh_pressed();
   void on_MeshPresetComboBox_currentTextChanged(const QString &meshName);
   void on_SubdivSteps_valueChanged(int value);
+  void on_MemoryBudget_valueChanged(int megabytes);
+  void on_limitSurfaceCheckBox_toggled(bool checked);
+  void on_adaptiveCheckBox_toggled(bool checked);
+  void on_regionCheckBox_toggled(bool checked);
+  void on_RegionRings_valueChanged(int rings);
+  void on_MainDisplay_vertexSelected(int vertex);
+  void on_MainDisplay_vertexDragged(int vertex, const QVector3D &offset);
 
   void on_phongShadingCheckBox_toggled(bool checked);
 
@@ -38,12 +50,37 @@ class MainWindow : public QMainWindow {
   void on_vertexSelectionCheckBox_toggled(bool checked);
 
 private:
+  bool loadBaseMesh(const QString &fileName);
   void importOBJ(const QString &fileName);
   void importOBJVertexSelection(const QString &fileName);
+  MeshHandle displayMesh(int level);
+  bool showsTessellation();
+  MeshHandle tessellationMesh();
+  void configureTessellation(const Mesh &base, int level, int regionVertex);
+  bool tessellationFitsBudget(int level, qint64 &required);
+  int controlVertex(int vertex);
+  int regionControlVertex();
+  void refreshAdaptiveMesh();
 
   Ui::MainWindow *ui;
   Subdivider *subdivider;
-  QVector<Mesh> meshes;
+  // The subdivision levels of the base mesh, within a memory budget.
+  LevelCache levelCache;
+  // Projects the displayed level onto the limit surface, if enabled. The last
+  // projection is kept, together with the level it was computed from.
+  LimitProjector limitProjector;
+  MeshHandle limitSource;
+  MeshHandle limitMesh;
+  // Tessellates the limit surface adaptively instead, or refines only the
+  // region around the selected vertex, if enabled. The last tessellation is
+  // kept, together with its maximum level and the vertex it refined around.
+  AdaptiveSubdivider adaptiveSubdivider;
+  int adaptiveLevel;
+  int adaptiveRegionVertex;
+  MeshHandle adaptiveMesh;
+  // Keeps the levels up to the displayed one up to date while a control
+  // vertex is dragged, instead of subdividing the base mesh again.
+  IncrementalSubdivider incrementalSubdivider;
   Settings settings;
 };
 
@@ -8,26 +8,115 @@
 /**
  * @brief Mesh::Mesh Initializes an empty mesh.
  */
-Mesh::Mesh() {}
+Mesh::Mesh() : edgeCount(0), triangles(false) {}
 
 /**
- * @brief Mesh::~Mesh Deconstructor. Clears all the data of the half-edge data.
+ * @brief Mesh::resize Resizes the vertex, half-edge and face arrays. Newly
+ * added vertices have no outgoing half-edge and newly added half-edges have no
+ * twin.
+ * @param numVertices The number of vertices.
+ * @param numHalfEdges The number of half-edges.
+ * @param numFaces The number of faces.
+ * @param triangles Whether all faces are triangles. If so, no face data is
+ * stored and numHalfEdges has to be 3 * numFaces.
  */
-Mesh::~Mesh() {
-  vertices.clear();
-  vertices.squeeze();
-  halfEdges.clear();
-  halfEdges.squeeze();
-  faces.clear();
-  faces.squeeze();
+void Mesh::resize(int numVertices, int numHalfEdges, int numFaces,
+                  bool triangles) {
+  this->triangles = triangles;
+  vertexX.resize(numVertices);
+  vertexY.resize(numVertices);
+  vertexZ.resize(numVertices);
+  vertexOut.fill(-1, numVertices);
+  vertexValence.fill(0, numVertices);
+
+  halfEdgeOrigin.resize(numHalfEdges);
+  halfEdgeTwin.fill(-1, numHalfEdges);
+  halfEdgeEdge.resize(numHalfEdges);
+
+  if (triangles) {
+    halfEdgeFace.clear();
+    faceOffset.clear();
+  } else {
+    halfEdgeFace.resize(numHalfEdges);
+    faceOffset.resize(numFaces + 1);
+    faceOffset[numFaces] = numHalfEdges;
+  }
+}
+
+/**
+ * @brief Mesh::nextBoundaryHalfEdge Every boundary vertex should have two
+ * connecting boundary half-edges (provided the mesh is manifold). One of those
+ * originates from the vertex, the other one points to the vertex. This
+ * function retrieves the one that originates from the vertex. Only works if
+ * the vertex is a boundary vertex.
+ * @param v Index of the vertex.
+ * @return A boundary half-edge that originates from the vertex.
+ */
+int Mesh::nextBoundaryHalfEdge(int v) const {
+  for (int h : outgoingHalfEdges(v)) {
+    if (isBoundaryEdge(h)) {
+      return h;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Mesh::prevBoundaryHalfEdge Every boundary vertex should have two
+ * connecting boundary half-edges (provided the mesh is manifold). One of those
+ * originates from the vertex, the other one points to the vertex. This
+ * function retrieves the boundary half-edge that points to the vertex. Only
+ * works if the vertex is a boundary vertex.
+ * @param v Index of the vertex.
+ * @return A boundary half-edge that points to the vertex.
+ */
+int Mesh::prevBoundaryHalfEdge(int v) const {
+  for (int h : outgoingHalfEdges(v)) {
+    if (isBoundaryEdge(prev(h))) {
+      return prev(h);
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Mesh::isBoundaryVertex Determines whether a vertex lies on a
+ * boundary or not.
+ * @param v Index of the vertex.
+ * @return True if the vertex lies on a boundary; false otherwise.
+ */
+bool Mesh::isBoundaryVertex(int v) const {
+  return nextBoundaryHalfEdge(v) >= 0;
+}
+
+/**
+ * @brief Mesh::computeFaceNormal Computes the normal of a face. Note that this
+ * will not give the most accurate normal for non-planar faces. However, this is
+ * not an issue, as the majority of the faces are triangles.
+ * @param f Index of the face.
+ * @return The normal of the face.
+ */
+QVector3D Mesh::computeFaceNormal(int f) const {
+  int h = side(f);
+  QVector3D pPrev = coords(origin(prev(h)));
+  QVector3D pCur = coords(origin(h));
+  QVector3D pNext = coords(origin(next(h)));
+
+  QVector3D edgeA = pPrev - pCur;
+  QVector3D edgeB = pNext - pCur;
+
+  QVector3D faceNormal = QVector3D::crossProduct(edgeB, edgeA);
+  // don't use normalized, since this presents issues with small numbers
+  return faceNormal / faceNormal.length();
 }
 
 /**
  * @brief Mesh::recalculateNormals Recalculates the face and vertex normals.
  */
 void Mesh::recalculateNormals() {
+  faceNormals.resize(numFaces());
   for (int f = 0; f < numFaces(); f++) {
-    faces[f].recalculateNormal();
+    faceNormals[f] = computeFaceNormal(f);
   }
 
   vertexNormals.clear();
@@ -35,10 +124,9 @@ void Mesh::recalculateNormals() {
 
   // normal computation
   for (int h = 0; h < numHalfEdges(); ++h) {
-    HalfEdge* edge = &halfEdges[h];
-    QVector3D pPrev = edge->prev->origin->coords;
-    QVector3D pCur = edge->origin->coords;
-    QVector3D pNext = edge->next->origin->coords;
+    QVector3D pPrev = coords(origin(prev(h)));
+    QVector3D pCur = coords(origin(h));
+    QVector3D pNext = coords(origin(next(h)));
 
     QVector3D edgeA = (pPrev - pCur);
     QVector3D edgeB = (pNext - pCur);
@@ -47,8 +135,8 @@ void Mesh::recalculateNormals() {
     double edgeDot = QVector3D::dotProduct(edgeA, edgeB) / edgeLengths;
     double angle = sqrt(1 - edgeDot * edgeDot);
 
-    vertexNormals[edge->origin->index] +=
-        (angle * edge->face->normal) / edgeLengths;
+    vertexNormals[origin(h)] +=
+        (angle * faceNormals[face(h)]) / edgeLengths;
   }
 
   for (int v = 0; v < numVerts(); ++v) {
@@ -64,42 +152,97 @@ void Mesh::extractAttributes() {
   recalculateNormals();
 
   vertexCoords.clear();
-  vertexCoords.reserve(vertices.size());
-  for (int v = 0; v < vertices.size(); v++) {
-    vertexCoords.append(vertices[v].coords);
+  vertexCoords.reserve(numVerts());
+  for (int v = 0; v < numVerts(); v++) {
+    vertexCoords.append(coords(v));
   }
 
+  // The half-edges of every face are stored consecutively, starting at its
+  // side, so the indices are simply the origins of all half-edges.
   polyIndices.clear();
-  polyIndices.reserve(halfEdges.size() + faces.size());
-  for (int f = 0; f < faces.size(); f++) {
-    HalfEdge* currentEdge = faces[f].side;
-    for (int m = 0; m < faces[f].valence; m++) {
-      polyIndices.append(currentEdge->origin->index);
-      currentEdge = currentEdge->next;
-    }
+  polyIndices.reserve(numHalfEdges());
+  for (int h = 0; h < numHalfEdges(); h++) {
+    polyIndices.append(origin(h));
+  }
+}
+
+/**
+ * @brief arraySize Computes the number of bytes used by the elements of an
+ * array.
+ * @param array The array.
+ * @return The size of the elements in bytes.
+ */
+template <typename T>
+static qint64 arraySize(const QVector<T>& array) {
+  return qint64(array.size()) * sizeof(T);
+}
+
+/**
+ * @brief Mesh::memoryFootprint Computes the memory used by the arrays of this
+ * mesh, including the extracted attributes.
+ * @return The memory footprint in bytes.
+ */
+qint64 Mesh::memoryFootprint() const {
+  return arraySize(vertexX) + arraySize(vertexY) + arraySize(vertexZ) +
+         arraySize(vertexOut) + arraySize(vertexValence) +
+         arraySize(halfEdgeOrigin) + arraySize(halfEdgeTwin) +
+         arraySize(halfEdgeEdge) + arraySize(halfEdgeFace) +
+         arraySize(faceOffset) + arraySize(faceNormals) +
+         arraySize(vertexCoords) + arraySize(vertexNormals) +
+         arraySize(polyIndices);
+}
+
+/**
+ * @brief Mesh::predictFootprint Predicts the memory footprint of a mesh with
+ * the provided number of elements once its attributes have been extracted.
+ * @param numVertices The number of vertices.
+ * @param numHalfEdges The number of half-edges.
+ * @param numFaces The number of faces.
+ * @param triangles Whether the mesh is a triangle mesh.
+ * @return The predicted memory footprint in bytes.
+ */
+qint64 Mesh::predictFootprint(qint64 numVertices, qint64 numHalfEdges,
+                              qint64 numFaces, bool triangles) {
+  // coordinates, outgoing half-edge, valence, extracted coordinates, normal
+  qint64 vertexSize = 3 * sizeof(float) + 2 * sizeof(int) +
+                      2 * sizeof(QVector3D);
+  // origin, twin, edge, poly index
+  qint64 halfEdgeSize = 3 * sizeof(int) + sizeof(unsigned int);
+  // normal
+  qint64 faceSize = sizeof(QVector3D);
+  qint64 size = numVertices * vertexSize + numHalfEdges * halfEdgeSize +
+                numFaces * faceSize;
+  if (!triangles) {
+    size += numHalfEdges * sizeof(int) + (numFaces + 1) * sizeof(int);
   }
+  return size;
 }
 
 /**
  * @brief Mesh::numVerts Retrieves the number of vertices.
  * @return The number of vertices.
  */
-int Mesh::numVerts() { return vertices.size(); }
+int Mesh::numVerts() const { return vertexX.size(); }
 
 /**
  * @brief Mesh::numHalfEdges Retrieves the number of half-edges.
  * @return The number of half-edges.
  */
-int Mesh::numHalfEdges() { return halfEdges.size(); }
+int Mesh::numHalfEdges() const { return halfEdgeOrigin.size(); }
 
 /**
  * @brief Mesh::numFaces Retrieves the number of faces.
  * @return The number of faces.
  */
-int Mesh::numFaces() { return faces.size(); }
+int Mesh::numFaces() const {
+  if (triangles) {
+    return halfEdgeOrigin.size() / 3;
+  }
+  return faceOffset.isEmpty() ? 0 : faceOffset.size() - 1;
+}
 
 /**
  * @brief Mesh::numEdges Retrieves the number of edges.
  * @return The number of edges.
  */
-int Mesh::numEdges() { return edgeCount; }
+int Mesh::numEdges() const { return edgeCount; }
@@ -1,54 +1,232 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <QSharedPointer>
+#include <QVector3D>
 #include <QVector>
 
-#include "face.h"
-#include "halfedge.h"
-#include "vertex.h"
-
 /**
  * @brief The Mesh class Representation of a mesh using the half-edge data
  * structure.
+ *
+ * The mesh is stored as a structure of arrays: every vertex, half-edge and
+ * face is identified by its index, and all connectivity is stored as 32-bit
+ * indices in contiguous arrays. The half-edges of a face are stored
+ * consecutively, so the next and previous half-edges follow from the face
+ * offsets and do not have to be stored. Since no pointers are involved, a mesh
+ * can be copied, moved or written to disk as-is.
+ *
+ * Meshes consisting only of triangles (which includes every subdivided mesh)
+ * do not store any face data at all: face f consists of the half-edges 3f,
+ * 3f + 1 and 3f + 2, so the face of a half-edge and its neighbours within the
+ * face follow from its index.
  */
 class Mesh {
  public:
-  Mesh();
-  ~Mesh();
+  class OutgoingHalfEdges;
 
-  inline QVector<Vertex>& getVertices() { return vertices; }
-  inline QVector<HalfEdge>& getHalfEdges() { return halfEdges; }
-  inline QVector<Face>& getFaces() { return faces; }
+  Mesh();
 
   inline QVector<QVector3D>& getVertexCoords() { return vertexCoords; }
   inline QVector<QVector3D>& getVertexNorms() { return vertexNormals; }
   inline QVector<unsigned int>& getPolyIndices() { return polyIndices; }
+  inline const QVector<QVector3D>& getVertexCoords() const {
+    return vertexCoords;
+  }
+  inline const QVector<QVector3D>& getVertexNorms() const {
+    return vertexNormals;
+  }
+  inline const QVector<unsigned int>& getPolyIndices() const {
+    return polyIndices;
+  }
 
   void extractAttributes();
   void recalculateNormals();
 
-  int numVerts();
-  int numHalfEdges();
-  int numFaces();
-  int numEdges();
-  QVector<QVector3D> vertexCoords;
+  int numVerts() const;
+  int numHalfEdges() const;
+  int numFaces() const;
+  int numEdges() const;
+  inline bool isTriangleMesh() const { return triangles; }
+
+  qint64 memoryFootprint() const;
+  static qint64 predictFootprint(qint64 numVertices, qint64 numHalfEdges,
+                                 qint64 numFaces, bool triangles);
+
+  // Vertices
+  inline QVector3D coords(int v) const {
+    return QVector3D(vertexX[v], vertexY[v], vertexZ[v]);
+  }
+  inline void setCoords(int v, const QVector3D& coords) {
+    vertexX[v] = coords.x();
+    vertexY[v] = coords.y();
+    vertexZ[v] = coords.z();
+  }
+  inline int out(int v) const { return vertexOut[v]; }
+  inline int valence(int v) const { return vertexValence[v]; }
+  bool isBoundaryVertex(int v) const;
+  int nextBoundaryHalfEdge(int v) const;
+  int prevBoundaryHalfEdge(int v) const;
+  inline OutgoingHalfEdges outgoingHalfEdges(int v) const;
+  inline OutgoingHalfEdges outgoingHalfEdgesFrom(int h) const;
+
+  // Half-edges
+  inline int origin(int h) const { return halfEdgeOrigin[h]; }
+  inline int twin(int h) const { return halfEdgeTwin[h]; }
+  inline int edge(int h) const { return halfEdgeEdge[h]; }
+  inline int face(int h) const {
+    return triangles ? h / 3 : halfEdgeFace[h];
+  }
+  inline int next(int h) const {
+    if (triangles) {
+      return h % 3 == 2 ? h - 2 : h + 1;
+    }
+    int f = halfEdgeFace[h];
+    return h + 1 < faceOffset[f + 1] ? h + 1 : faceOffset[f];
+  }
+  inline int prev(int h) const {
+    if (triangles) {
+      return h % 3 == 0 ? h + 2 : h - 1;
+    }
+    int f = halfEdgeFace[h];
+    return h > faceOffset[f] ? h - 1 : faceOffset[f + 1] - 1;
+  }
+  inline bool isBoundaryEdge(int h) const { return halfEdgeTwin[h] < 0; }
+
+  // Faces
+  inline int side(int f) const { return triangles ? 3 * f : faceOffset[f]; }
+  inline int faceValence(int f) const {
+    return triangles ? 3 : faceOffset[f + 1] - faceOffset[f];
+  }
+  inline QVector3D faceNormal(int f) const { return faceNormals[f]; }
+  QVector3D computeFaceNormal(int f) const;
 
+  QVector<QVector3D> vertexCoords;
 
  private:
+  void resize(int numVertices, int numHalfEdges, int numFaces,
+              bool triangles);
+
   QVector<QVector3D> vertexNormals;
   QVector<unsigned int> polyIndices;
 
-  QVector<Vertex> vertices;
-  QVector<Face> faces;
-  QVector<HalfEdge> halfEdges;
+  // Per vertex: coordinates, one outgoing half-edge (-1 for isolated
+  // vertices) and the number of outgoing edges.
+  QVector<float> vertexX;
+  QVector<float> vertexY;
+  QVector<float> vertexZ;
+  QVector<int> vertexOut;
+  QVector<int> vertexValence;
+
+  // Per half-edge: origin vertex, twin (-1 on boundaries), undirected edge and
+  // face. The faces are only stored for polygon meshes.
+  QVector<int> halfEdgeOrigin;
+  QVector<int> halfEdgeTwin;
+  QVector<int> halfEdgeEdge;
+  QVector<int> halfEdgeFace;
+
+  // Face f consists of the half-edges faceOffset[f] up to faceOffset[f + 1].
+  // Empty for triangle meshes.
+  QVector<int> faceOffset;
+  QVector<QVector3D> faceNormals;
 
   int edgeCount;
+  bool triangles;
 
   // These classes require access to the private fields to prevent a bunch of
   // function calls.
   friend class MeshInitializer;
+  friend class MeshCache;
+  friend class MeshExporter;
   friend class Subdivider;
   friend class LoopSubdivider;
+  friend class StencilTable;
+  friend class IncrementalSubdivider;
+  friend class BlockedSubdivider;
+};
+
+/**
+ * @brief The Mesh::OutgoingHalfEdges class is a range over the half-edges that
+ * originate from a vertex, for use in range-based for loops. It starts at a
+ * given half-edge and rotates around the vertex from h to next(twin(h)). If it
+ * runs into a boundary, it continues on the other side of the start, rotating
+ * from h to twin(prev(h)), so every outgoing half-edge is visited exactly
+ * once. The range does not allocate any memory. The targets of the outgoing
+ * half-edges are the neighbours of the vertex; on a boundary, the origin of
+ * prevBoundaryHalfEdge is a neighbour as well.
+ */
+class Mesh::OutgoingHalfEdges {
+ public:
+  class Iterator {
+   public:
+    inline Iterator(const Mesh* mesh, int start, int h)
+        : mesh(mesh), start(start), h(h), reversed(false) {}
+
+    inline int operator*() const { return h; }
+    inline bool operator!=(const Iterator& other) const {
+      return h != other.h;
+    }
+    inline Iterator& operator++() {
+      if (!reversed) {
+        int twin = mesh->twin(h);
+        if (twin >= 0) {
+          h = mesh->next(twin);
+          if (h == start) {
+            h = -1;
+          }
+          return *this;
+        }
+        // Ran into a boundary; continue on the other side of the start.
+        reversed = true;
+        h = start;
+      }
+      h = mesh->twin(mesh->prev(h));
+      return *this;
+    }
+
+   private:
+    const Mesh* mesh;
+    int start;
+    int h;
+    bool reversed;
+  };
+
+  inline OutgoingHalfEdges(const Mesh& mesh, int start)
+      : mesh(&mesh), start(start) {}
+
+  inline Iterator begin() const { return Iterator(mesh, start, start); }
+  inline Iterator end() const { return Iterator(mesh, start, -1); }
+
+ private:
+  const Mesh* mesh;
+  int start;
 };
 
+/**
+ * @brief Mesh::outgoingHalfEdges Retrieves the half-edges originating from a
+ * vertex, starting at its outgoing half-edge.
+ * @param v Index of the vertex.
+ * @return A range over the outgoing half-edges. Empty for isolated vertices.
+ */
+inline Mesh::OutgoingHalfEdges Mesh::outgoingHalfEdges(int v) const {
+  return OutgoingHalfEdges(*this, vertexOut[v]);
+}
+
+/**
+ * @brief Mesh::outgoingHalfEdgesFrom Retrieves the half-edges originating from
+ * the origin of a half-edge, starting at that half-edge.
+ * @param h Index of the half-edge.
+ * @return A range over the outgoing half-edges.
+ */
+inline Mesh::OutgoingHalfEdges Mesh::outgoingHalfEdgesFrom(int h) const {
+  return OutgoingHalfEdges(*this, h);
+}
+
+/**
+ * @brief MeshHandle A reference-counted, immutable snapshot of a mesh. Handles
+ * are shared by everything that looks at a mesh, so passing one around never
+ * copies the mesh itself.
+ */
+using MeshHandle = QSharedPointer<const Mesh>;
+
 #endif  // MESH_H
@@ -1,5 +1,9 @@
 #include "meshrenderer.h"
 
+// Changed vertices that are at most this far apart are uploaded as a single
+// range; re-uploading a few unchanged vertices is cheaper than an extra call.
+#define MAX_UPLOAD_GAP 16
+
 /**
  * @brief MeshRenderer::MeshRenderer Creates a new mesh renderer.
  */
@@ -53,30 +57,63 @@ void MeshRenderer::initBuffers() {
 
 /**
  * @brief MeshRenderer::updateBuffers Updates the buffers based on the provided
- * mesh.
+ * mesh. The attributes of the mesh have to be extracted already.
  * @param mesh The mesh to update the buffer contents with.
  */
-void MeshRenderer::updateBuffers(Mesh& mesh) {
-    QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
-    QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
-    QVector<unsigned int>& polyIndices = mesh.getPolyIndices();
+void MeshRenderer::updateBuffers(const Mesh& mesh) {
+    const QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
+    const QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
+    const QVector<unsigned int>& polyIndices = mesh.getPolyIndices();
 
     gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
     gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexCoords.size(),
-                   vertexCoords.data(), GL_STATIC_DRAW);
+                   vertexCoords.constData(), GL_STATIC_DRAW);
 
     gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
     gl->glBufferData(GL_ARRAY_BUFFER, sizeof(QVector3D) * vertexNormals.size(),
-                   vertexNormals.data(), GL_STATIC_DRAW);
+                   vertexNormals.constData(), GL_STATIC_DRAW);
 
     gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshIndexBO);
     gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                    sizeof(unsigned int) * polyIndices.size(),
-                   polyIndices.data(), GL_STATIC_DRAW);
+                   polyIndices.constData(), GL_STATIC_DRAW);
 
     meshIBOSize = polyIndices.size();
 }
 
+/**
+ * @brief MeshRenderer::updateVertices Re-uploads the coordinates and normals
+ * of some vertices, for an edited copy of the mesh whose buffers were last
+ * uploaded. The indices are left untouched.
+ * @param mesh The edited mesh, with the connectivity of the uploaded one. Its
+ * attributes have to be up to date.
+ * @param vertices Indices of the changed vertices, in ascending order.
+ */
+void MeshRenderer::updateVertices(const Mesh& mesh,
+                                  const QVector<int>& vertices) {
+    const QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
+    const QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
+
+    int i = 0;
+    while (i < vertices.size()) {
+        int first = vertices[i];
+        int last = first;
+        while (++i < vertices.size() && vertices[i] - last <= MAX_UPLOAD_GAP) {
+            last = vertices[i];
+        }
+        GLintptr offset = sizeof(QVector3D) * first;
+        GLsizeiptr size = sizeof(QVector3D) * (last - first + 1);
+
+        gl->glBindBuffer(GL_ARRAY_BUFFER, meshCoordsBO);
+        gl->glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                            vertexCoords.constData() + first);
+
+        gl->glBindBuffer(GL_ARRAY_BUFFER, meshNormalsBO);
+        gl->glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                            vertexNormals.constData() + first);
+    }
+}
+
 /**
  * @brief MeshRenderer::updateUniforms Updates the uniforms in the phong and isohotes shader.
  */
@@ -16,7 +16,8 @@ class MeshRenderer : public Renderer {
   ~MeshRenderer() override;
 
   void updateUniforms();
-  void updateBuffers(Mesh& m);
+  void updateBuffers(const Mesh& m);
+  void updateVertices(const Mesh& m, const QVector<int>& vertices);
   void draw();
   void drawPhong();
   void drawIsophotes();
@@ -0,0 +1,506 @@
+#include "adaptivesubdivider.h"
+
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+
+#include "initialization/meshinitializer.h"
+#include "limitevaluator.h"
+#include "limitprojector.h"
+#include "loopsubdivider.h"
+#include "util/parallel.h"
+
+// Meshes with fewer faces than this are always tessellated serially; the cost
+// of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_FACES 4096
+
+/**
+ * @brief AdaptiveSubdivider::AdaptiveSubdivider Creates a new adaptive
+ * subdivider. Without any tolerance set, every face is refined to the maximum
+ * level.
+ */
+AdaptiveSubdivider::AdaptiveSubdivider()
+    : numThreads(0),
+      maxLevel(3),
+      flatnessTolerance(0.0f),
+      maxEdgePixels(0.0f) {
+  for (int i = 0; i < 16; ++i) {
+    viewProjection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+  }
+}
+
+/**
+ * @brief AdaptiveSubdivider::setNumThreads Sets the number of threads used to
+ * tessellate a mesh.
+ * @param numThreads The number of threads. 1 forces serial tessellation;
+ * values smaller than 1 use all cores.
+ */
+void AdaptiveSubdivider::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief AdaptiveSubdivider::setMaxLevel Sets the level of the most refined
+ * faces. The level is clamped to MAX_SUBDIVISION_LEVELS, so that the grid of
+ * a single face can always be indexed.
+ * @param maxLevel The maximum level.
+ */
+void AdaptiveSubdivider::setMaxLevel(int maxLevel) {
+  this->maxLevel = std::min(std::max(maxLevel, 0), MAX_SUBDIVISION_LEVELS);
+}
+
+/**
+ * @brief AdaptiveSubdivider::setFlatnessTolerance Sets the maximum distance
+ * between the tessellation and the limit surface.
+ * @param tolerance The tolerance, in model units. 0 disables the criterion.
+ */
+void AdaptiveSubdivider::setFlatnessTolerance(float tolerance) {
+  flatnessTolerance = std::max(tolerance, 0.0f);
+}
+
+/**
+ * @brief AdaptiveSubdivider::setScreenSpaceTolerance Sets the maximum length
+ * of the tessellated edges on the screen.
+ * @param viewProjection Transforms model coordinates to clip coordinates.
+ * Column-major, e.g. QMatrix4x4::constData().
+ * @param viewport Size of the viewport in pixels.
+ * @param maxEdgePixels The tolerance, in pixels.
+ */
+void AdaptiveSubdivider::setScreenSpaceTolerance(
+    const float viewProjection[16], const QSize& viewport,
+    float maxEdgePixels) {
+  std::copy(viewProjection, viewProjection + 16, this->viewProjection);
+  this->viewport = viewport;
+  this->maxEdgePixels = std::max(maxEdgePixels, 0.0f);
+}
+
+/**
+ * @brief AdaptiveSubdivider::clearScreenSpaceTolerance Disables the
+ * screen-space criterion.
+ */
+void AdaptiveSubdivider::clearScreenSpaceTolerance() { maxEdgePixels = 0.0f; }
+
+/**
+ * @brief AdaptiveSubdivider::setRegionOfInterest Restricts refinement to a
+ * region of the mesh. Faces outside of it are only refined as far as needed
+ * for a gradual transition, or as far as the enabled tolerances ask for.
+ * @param faces Indices of the faces of the region, in the mesh that is
+ * subdivided. For meshes with faces other than triangles, which are refined
+ * once first, the region becomes the children of these faces.
+ */
+void AdaptiveSubdivider::setRegionOfInterest(const QVector<int>& faces) {
+  regionFaces = faces;
+}
+
+/**
+ * @brief AdaptiveSubdivider::clearRegionOfInterest Refines the whole mesh
+ * again.
+ */
+void AdaptiveSubdivider::clearRegionOfInterest() { regionFaces.clear(); }
+
+/**
+ * @brief AdaptiveSubdivider::ringFaces Collects the faces in the k-ring of a
+ * set of vertices: the faces around the vertices for k = 1, and for every
+ * further ring also the faces around the corners of the previous ring.
+ * @param mesh The mesh the vertices belong to.
+ * @param vertices Indices of the vertices.
+ * @param rings The number of rings k.
+ * @return Indices of the faces, ring by ring.
+ */
+QVector<int> AdaptiveSubdivider::ringFaces(const Mesh& mesh,
+                                           const QVector<int>& vertices,
+                                           int rings) {
+  // Sets rather than flags per element, so that the cost is proportional to
+  // the size of the region instead of the size of the mesh.
+  QSet<int> visitedVerts;
+  QSet<int> visitedFaces;
+  QVector<int> faces;
+  QVector<int> front;
+  for (int v : vertices) {
+    if (v >= 0 && v < mesh.numVerts() && !visitedVerts.contains(v)) {
+      visitedVerts.insert(v);
+      front.append(v);
+    }
+  }
+  for (int ring = 0; ring < rings && !front.isEmpty(); ++ring) {
+    QVector<int> nextFront;
+    for (int v : front) {
+      if (mesh.out(v) < 0) {
+        continue;
+      }
+      for (int h : mesh.outgoingHalfEdges(v)) {
+        int f = mesh.face(h);
+        if (visitedFaces.contains(f)) {
+          continue;
+        }
+        visitedFaces.insert(f);
+        faces.append(f);
+        for (int k = 0; k < mesh.faceValence(f); ++k) {
+          int corner = mesh.origin(mesh.side(f) + k);
+          if (!visitedVerts.contains(corner)) {
+            visitedVerts.insert(corner);
+            nextFront.append(corner);
+          }
+        }
+      }
+    }
+    front.swap(nextFront);
+  }
+  return faces;
+}
+
+/**
+ * @brief AdaptiveSubdivider::flatnessLevel Determines the level at which a
+ * face is flat enough. Every subdivision step halves the edges, so the
+ * distance between the edges and the limit surface drops by a factor 4.
+ * @param corners The limit positions of the corners of the face.
+ * @param midpoints The limit positions of the midpoints of the edges; the
+ * first one lies on the edge from the first to the second corner.
+ * @return The level.
+ */
+int AdaptiveSubdivider::flatnessLevel(const QVector3D corners[3],
+                                      const QVector3D midpoints[3]) const {
+  float deviation = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    QVector3D chord = (corners[i] + corners[(i + 1) % 3]) / 2.0f;
+    deviation = std::max(deviation, (midpoints[i] - chord).length());
+  }
+  int level = 0;
+  while (level < maxLevel && deviation > flatnessTolerance) {
+    deviation /= 4.0f;
+    level++;
+  }
+  return level;
+}
+
+/**
+ * @brief AdaptiveSubdivider::screenSpaceLevel Determines the level at which
+ * the edges of a face are short enough on the screen. Faces crossing the near
+ * plane get the maximum level; faces entirely behind it get level 0.
+ * @param corners The limit positions of the corners of the face.
+ * @return The level.
+ */
+int AdaptiveSubdivider::screenSpaceLevel(const QVector3D corners[3]) const {
+  QVector3D pixels[3];
+  int numBehind = 0;
+  const float* m = viewProjection;
+  for (int i = 0; i < 3; ++i) {
+    float x = corners[i].x();
+    float y = corners[i].y();
+    float z = corners[i].z();
+    float clipX = m[0] * x + m[4] * y + m[8] * z + m[12];
+    float clipY = m[1] * x + m[5] * y + m[9] * z + m[13];
+    float clipW = m[3] * x + m[7] * y + m[11] * z + m[15];
+    if (clipW <= 0.0f) {
+      numBehind++;
+      continue;
+    }
+    pixels[i] = QVector3D((clipX / clipW + 1.0f) * viewport.width() / 2,
+                          (clipY / clipW + 1.0f) * viewport.height() / 2,
+                          0.0f);
+  }
+  if (numBehind > 0) {
+    return numBehind == 3 ? 0 : maxLevel;
+  }
+  float length = 0.0f;
+  for (int i = 0; i < 3; ++i) {
+    length = std::max(length, (pixels[i] - pixels[(i + 1) % 3]).length());
+  }
+  int level = 0;
+  while (level < maxLevel && length > maxEdgePixels) {
+    length /= 2.0f;
+    level++;
+  }
+  return level;
+}
+
+/**
+ * @brief AdaptiveSubdivider::regionLevels Assigns the maximum level to the
+ * faces of the region of interest. Around the region, the level drops by one
+ * per ring of faces, so that neighbouring faces differ by at most one level.
+ * @param mesh The triangle mesh.
+ * @return The level of every face.
+ */
+QVector<int> AdaptiveSubdivider::regionLevels(const Mesh& mesh) const {
+  int numFaces = mesh.numFaces();
+  QVector<int> levels(numFaces, 0);
+  QVector<int> front;
+  for (int f : regionFaces) {
+    if (f >= 0 && f < numFaces && levels[f] < maxLevel) {
+      levels[f] = maxLevel;
+      front.append(f);
+    }
+  }
+  for (int level = maxLevel - 1; level > 0 && !front.isEmpty(); --level) {
+    QVector<int> nextFront;
+    for (int f : front) {
+      for (int i = 0; i < 3; ++i) {
+        int twin = mesh.twin(3 * f + i);
+        if (twin >= 0 && levels[twin / 3] == 0) {
+          levels[twin / 3] = level;
+          nextFront.append(twin / 3);
+        }
+      }
+    }
+    front.swap(nextFront);
+  }
+  return levels;
+}
+
+/**
+ * @brief AdaptiveSubdivider::faceLevels Determines the level of every face of
+ * a triangle mesh: the highest level any of the enabled criteria or the
+ * region of interest asks for. Without any of them, every face gets the
+ * maximum level.
+ * @param mesh The triangle mesh.
+ * @return The level of every face. Empty if the mesh is not a triangle mesh.
+ */
+QVector<int> AdaptiveSubdivider::faceLevels(const Mesh& mesh) const {
+  int numFaces = mesh.numFaces();
+  if (!mesh.isTriangleMesh()) {
+    return QVector<int>();
+  }
+  bool flatness = flatnessTolerance > 0.0f;
+  bool screenSpace = maxEdgePixels > 0.0f && viewport.width() > 0 &&
+                     viewport.height() > 0;
+  bool region = !regionFaces.isEmpty();
+  if (!flatness && !screenSpace) {
+    return region ? regionLevels(mesh) : QVector<int>(numFaces, maxLevel);
+  }
+
+  // The corners and edge midpoints of every face.
+  const float params[6][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f},
+                              {0.5f, 0.0f}, {0.5f, 0.5f}, {0.0f, 0.5f}};
+  QVector<LimitSample> samples(6 * numFaces);
+  for (int f = 0; f < numFaces; ++f) {
+    for (int k = 0; k < 6; ++k) {
+      samples[6 * f + k] = {f, params[k][0], params[k][1]};
+    }
+  }
+  LimitEvaluator evaluator;
+  evaluator.setNumThreads(numThreads);
+  QVector<LimitPoint> points;
+  evaluator.evaluate(mesh, samples, points);
+
+  QVector<int> levels = region ? regionLevels(mesh) : QVector<int>(numFaces);
+  int threads =
+      numFaces >= MIN_PARALLEL_FACES ? resolveThreadCount(numThreads) : 1;
+  parallelFor(0, numFaces, threads, [&](int begin, int end, int) {
+    for (int f = begin; f < end; ++f) {
+      QVector3D corners[3];
+      QVector3D midpoints[3];
+      for (int i = 0; i < 3; ++i) {
+        corners[i] = points[6 * f + i].position;
+        midpoints[i] = points[6 * f + 3 + i].position;
+      }
+      int level = levels[f];
+      if (flatness) {
+        level = std::max(level, flatnessLevel(corners, midpoints));
+      }
+      if (screenSpace) {
+        level = std::max(level, screenSpaceLevel(corners));
+      }
+      levels[f] = level;
+    }
+  });
+  return levels;
+}
+
+/**
+ * @brief AdaptiveSubdivider::subdivide Tessellates the limit surface of a
+ * mesh. Meshes with faces other than triangles are refined once with Loop's
+ * rules first, since the limit surface is evaluated on triangles; the region
+ * of interest moves along to the children of its faces.
+ * @param mesh The control mesh.
+ * @return The tessellation, with its attributes extracted and the vertex
+ * normals set to the normals of the limit surface.
+ */
+Mesh AdaptiveSubdivider::subdivide(const Mesh& mesh) const {
+  if (!mesh.isTriangleMesh()) {
+    LoopSubdivider subdivider;
+    subdivider.setNumThreads(numThreads);
+    AdaptiveSubdivider refined = *this;
+    refined.regionFaces = LoopSubdivider::childFaces(mesh, regionFaces);
+    return refined.subdivide(subdivider.subdivide(mesh));
+  }
+  int numVerts = mesh.numVerts();
+  int numEdges = mesh.numEdges();
+  int numFaces = mesh.numFaces();
+  int threads =
+      numFaces >= MIN_PARALLEL_FACES ? resolveThreadCount(numThreads) : 1;
+  QVector<int> levels = faceLevels(mesh);
+
+  // Every edge is sampled at the coarser level of its two faces, seen from
+  // the half-edge with the higher index.
+  QVector<int> edgeSegments(numEdges);
+  QVector<int> edgeHalfEdges(numEdges);
+  parallelFor(0, mesh.numHalfEdges(), threads, [&](int begin, int end, int) {
+    for (int h = begin; h < end; ++h) {
+      int twin = mesh.twin(h);
+      if (h > twin) {
+        int level = levels[h / 3];
+        if (twin >= 0) {
+          level = std::min(level, levels[twin / 3]);
+        }
+        edgeSegments[mesh.edge(h)] = 1 << level;
+        edgeHalfEdges[mesh.edge(h)] = h;
+      }
+    }
+  });
+
+  // The vertices of the control mesh come first, followed by the samples
+  // inside every edge and then by the samples inside every face.
+  QVector<int> edgeOffsets(numEdges + 1);
+  QVector<int> faceOffsets(numFaces + 1);
+  edgeOffsets[0] = numVerts;
+  for (int e = 0; e < numEdges; ++e) {
+    edgeOffsets[e + 1] = edgeOffsets[e] + edgeSegments[e] - 1;
+  }
+  faceOffsets[0] = edgeOffsets[numEdges];
+  for (int f = 0; f < numFaces; ++f) {
+    int n = 1 << levels[f];
+    faceOffsets[f + 1] = faceOffsets[f] + (n - 1) * (n - 2) / 2;
+  }
+  int newNumVerts = faceOffsets[numFaces];
+
+  // Index of the vertex of face f at grid point (a, b), where the face is
+  // divided into n segments along every side.
+  auto gridVertex = [&](int f, int n, int a, int b) {
+    int h;
+    int k;
+    if (b == 0) {
+      h = 3 * f;
+      k = a;
+    } else if (a + b == n) {
+      h = 3 * f + 1;
+      k = b;
+    } else if (a == 0) {
+      h = 3 * f + 2;
+      k = n - b;
+    } else {
+      // Rows of interior points for b = 1, ..., n - 2.
+      return faceOffsets[f] + (b - 1) * (n - 1) - (b - 1) * b / 2 + a - 1;
+    }
+    int e = mesh.edge(h);
+    int segments = edgeSegments[e];
+    // Snap to the nearest sample of a coarser edge; halfway points move
+    // towards the nearest corner, so that no slivers form there.
+    int bias = 2 * k < n ? n / 2 - 1 : n / 2;
+    k = n == segments ? k : (k * segments + bias) / n;
+    if (k == 0) {
+      return mesh.origin(h);
+    }
+    if (k == segments) {
+      return mesh.origin(mesh.next(h));
+    }
+    bool forward = edgeHalfEdges[e] == h;
+    return edgeOffsets[e] + (forward ? k : segments - k) - 1;
+  };
+
+  // Parameters of all new vertices on the limit surface.
+  QVector<LimitSample> samples(newNumVerts - numVerts);
+  LimitSample* sampleData = samples.data();
+  parallelFor(0, numEdges, threads, [&](int begin, int end, int) {
+    for (int e = begin; e < end; ++e) {
+      int h = edgeHalfEdges[e];
+      int segments = edgeSegments[e];
+      for (int k = 1; k < segments; ++k) {
+        float lambda = float(k) / segments;
+        float u[3] = {lambda, 1.0f - lambda, 0.0f};
+        float v[3] = {0.0f, lambda, 1.0f - lambda};
+        sampleData[edgeOffsets[e] + k - 1 - numVerts] = {h / 3, u[h % 3],
+                                                        v[h % 3]};
+      }
+    }
+  });
+  parallelFor(0, numFaces, threads, [&](int begin, int end, int) {
+    for (int f = begin; f < end; ++f) {
+      int n = 1 << levels[f];
+      for (int b = 1; b < n - 1; ++b) {
+        for (int a = 1; a + b < n; ++a) {
+          sampleData[gridVertex(f, n, a, b) - numVerts] = {
+              f, float(a) / n, float(b) / n};
+        }
+      }
+    }
+  });
+  LimitEvaluator evaluator;
+  evaluator.setNumThreads(numThreads);
+  QVector<LimitPoint> points;
+  evaluator.evaluate(mesh, samples, points);
+
+  QVector<QVector3D> coords(newNumVerts);
+  QVector<QVector3D> normals(newNumVerts);
+  LimitProjector projector;
+  parallelFor(0, newNumVerts, threads, [&](int begin, int end, int) {
+    for (int v = begin; v < end; ++v) {
+      if (v < numVerts) {
+        coords[v] = projector.limitPosition(mesh, v);
+        normals[v] = projector.limitNormal(mesh, v);
+        continue;
+      }
+      const LimitPoint& point = points[v - numVerts];
+      QVector3D normal = QVector3D::crossProduct(point.du, point.dv);
+      float length = normal.length();
+      coords[v] = point.position;
+      normals[v] = length > 0.0f
+                       ? normal / length
+                       : mesh.computeFaceNormal(samples[v - numVerts].face);
+    }
+  });
+
+  // Triangulate the grid of every face, dropping the triangles that
+  // collapsed by snapping to a coarser edge. The first pass counts them.
+  QVector<int> triangleOffsets(numFaces + 1, 0);
+  QVector<int> faceCoordInd;
+  auto triangulate = [&](int f, int* output) {
+    int n = 1 << levels[f];
+    int count = 0;
+    auto addTriangle = [&](int v0, int v1, int v2) {
+      if (v0 == v1 || v1 == v2 || v2 == v0) {
+        return;
+      }
+      if (output != nullptr) {
+        output[3 * count] = v0;
+        output[3 * count + 1] = v1;
+        output[3 * count + 2] = v2;
+      }
+      count++;
+    };
+    for (int b = 0; b < n; ++b) {
+      for (int a = 0; a + b < n; ++a) {
+        addTriangle(gridVertex(f, n, a, b), gridVertex(f, n, a + 1, b),
+                    gridVertex(f, n, a, b + 1));
+        if (a + b < n - 1) {
+          addTriangle(gridVertex(f, n, a + 1, b),
+                      gridVertex(f, n, a + 1, b + 1),
+                      gridVertex(f, n, a, b + 1));
+        }
+      }
+    }
+    return count;
+  };
+  parallelFor(0, numFaces, threads, [&](int begin, int end, int) {
+    for (int f = begin; f < end; ++f) {
+      triangleOffsets[f + 1] = triangulate(f, nullptr);
+    }
+  });
+  for (int f = 0; f < numFaces; ++f) {
+    triangleOffsets[f + 1] += triangleOffsets[f];
+  }
+  faceCoordInd.resize(3 * triangleOffsets[numFaces]);
+  int* indexData = faceCoordInd.data();
+  parallelFor(0, numFaces, threads, [&](int begin, int end, int) {
+    for (int f = begin; f < end; ++f) {
+      triangulate(f, indexData + 3 * triangleOffsets[f]);
+    }
+  });
+
+  MeshInitializer initializer;
+  initializer.setNumThreads(numThreads);
+  Mesh result = initializer.constructHalfEdgeMesh(
+      coords, QVector<int>(triangleOffsets[numFaces], 3), faceCoordInd);
+  result.extractAttributes();
+  result.getVertexNorms() = normals;
+  return result;
+}
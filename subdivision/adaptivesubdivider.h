@@ -0,0 +1,71 @@
+#ifndef ADAPTIVE_SUBDIVIDER_H
+#define ADAPTIVE_SUBDIVIDER_H
+
+#include <QSize>
+#include <QVector>
+
+#include "mesh/mesh.h"
+#include "subdivider.h"
+
+/**
+ * @brief The AdaptiveSubdivider class tessellates the Loop limit surface of a
+ * mesh with a level of detail per face, instead of refining every face of the
+ * mesh equally often.
+ *
+ * A face at level l is split into 4^l triangles on a regular grid in its
+ * parameter domain, and every grid vertex is placed on the limit surface. The
+ * level of a face is the smallest level at which the tessellation deviates
+ * less than the flatness tolerance from the limit surface, and at which its
+ * edges are no longer than the screen-space tolerance; both are estimated from
+ * the limit surface at the corners and edge midpoints of the face.
+ *
+ * An edge between faces of different levels is sampled at the coarser of the
+ * two levels. The grid vertices of the finer face on that edge are snapped to
+ * the nearest of those samples, which collapses the triangles between them, so
+ * the result is a closed mesh without cracks or T-junctions.
+ *
+ * Refinement can also be restricted to a region of interest, such as the
+ * k-ring of a selected vertex: the faces of the region get the maximum level
+ * and the level drops by one per ring of faces around it, so the size of the
+ * result is proportional to the size of the region.
+ */
+class AdaptiveSubdivider : public Subdivider {
+ public:
+  AdaptiveSubdivider();
+  void setNumThreads(int numThreads);
+  void setMaxLevel(int maxLevel);
+  void setFlatnessTolerance(float tolerance);
+  void setScreenSpaceTolerance(const float viewProjection[16],
+                               const QSize& viewport, float maxEdgePixels);
+  void clearScreenSpaceTolerance();
+  void setRegionOfInterest(const QVector<int>& faces);
+  void clearRegionOfInterest();
+
+  static QVector<int> ringFaces(const Mesh& mesh, const QVector<int>& vertices,
+                                int rings);
+
+  QVector<int> faceLevels(const Mesh& mesh) const;
+  Mesh subdivide(const Mesh& mesh) const override;
+
+ private:
+  int flatnessLevel(const QVector3D corners[3],
+                    const QVector3D midpoints[3]) const;
+  int screenSpaceLevel(const QVector3D corners[3]) const;
+  QVector<int> regionLevels(const Mesh& mesh) const;
+
+  int numThreads;
+  int maxLevel;
+  // Maximum distance between the tessellation and the limit surface; 0
+  // disables the criterion.
+  float flatnessTolerance;
+  // Maximum projected edge length in pixels; 0 disables the criterion.
+  float maxEdgePixels;
+  // Column-major, like QMatrix4x4::constData(); the core library does not
+  // depend on the matrix classes of Qt Gui.
+  float viewProjection[16];
+  QSize viewport;
+  // Faces that are refined to the maximum level; empty to refine everywhere.
+  QVector<int> regionFaces;
+};
+
+#endif  // ADAPTIVE_SUBDIVIDER_H
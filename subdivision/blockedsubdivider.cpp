@@ -0,0 +1,477 @@
+#include "blockedsubdivider.h"
+
+#include <algorithm>
+
+#include "util/parallel.h"
+
+// A block is subdivided all the way to the last level once its patch ends up
+// with at most this many faces there. Together with its halo and the coarser
+// levels, such a block takes up about a megabyte, so it mostly stays in
+// the L2 cache while it is being subdivided.
+#define BLOCK_FACES 16384
+// Patches are never made smaller than this; the halo around smaller patches
+// would be larger than the patch itself.
+#define MIN_PATCH_FACES 1024
+
+/**
+ * @brief reserveMap Makes sure that a map from indices to local indices covers
+ * a number of elements. New entries are -1.
+ * @param map The map, in which every entry is -1.
+ * @param size The number of elements.
+ */
+static void reserveMap(QVector<int>& map, int size) {
+  if (map.size() < size) {
+    map.fill(-1, size);
+  }
+}
+
+/**
+ * @brief addElement Adds an element to a set, unless it is part of it
+ * already.
+ * @param index Index of the element.
+ * @param elements The elements of the set.
+ * @param map Is 0 for the elements of the set and -1 for all others.
+ */
+static void addElement(int index, QVector<int>& elements, QVector<int>& map) {
+  if (map[index] < 0) {
+    map[index] = 0;
+    elements.append(index);
+  }
+}
+
+/**
+ * @brief assignLocalIndices Numbers the elements of a set in ascending order.
+ * @param elements The elements of the set. Are sorted.
+ * @param map Is set to the local index of every element of the set.
+ */
+static void assignLocalIndices(QVector<int>& elements, QVector<int>& map) {
+  std::sort(elements.begin(), elements.end());
+  for (int i = 0; i < elements.size(); i++) {
+    map[elements[i]] = i;
+  }
+}
+
+/**
+ * @brief descendants Calculates the number of faces a number of faces is
+ * split into.
+ * @param faces The number of faces.
+ * @param levels The number of subdivision steps.
+ * @return The number of faces after the subdivision steps.
+ */
+static qint64 descendants(int faces, int levels) {
+  return qint64(faces) << (2 * std::min(levels, 15));
+}
+
+/**
+ * @brief isManifold Checks whether the faces around every vertex form a single
+ * fan, so that rotating around the vertex visits all of them.
+ * @param mesh The mesh.
+ * @return True if every vertex is manifold; false otherwise.
+ */
+static bool isManifold(const Mesh& mesh) {
+  QVector<int> outgoing(mesh.numVerts(), 0);
+  for (int h = 0; h < mesh.numHalfEdges(); h++) {
+    outgoing[mesh.origin(h)]++;
+  }
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    if (mesh.out(v) < 0) {
+      continue;
+    }
+    for (int h : mesh.outgoingHalfEdges(v)) {
+      outgoing[mesh.origin(h)]--;
+    }
+    if (outgoing[v] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief BlockedSubdivider::BlockedSubdivider Creates a new blocked
+ * subdivider that performs a single subdivision step, using all cores.
+ */
+BlockedSubdivider::BlockedSubdivider() : numThreads(0), levels(1) {}
+
+/**
+ * @brief BlockedSubdivider::setNumThreads Sets the number of threads used to
+ * subdivide a mesh. The result does not depend on the number of threads.
+ * @param numThreads The number of threads. 1 forces serial subdivision;
+ * values smaller than 1 use all cores.
+ */
+void BlockedSubdivider::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief BlockedSubdivider::setLevels Sets the number of subdivision steps.
+ * @param levels The number of steps.
+ */
+void BlockedSubdivider::setLevels(int levels) {
+  this->levels = std::max(levels, 0);
+}
+
+/**
+ * @brief BlockedSubdivider::subdivide Subdivides the provided mesh the set
+ * number of times. Meshes that are not triangle meshes get their first step
+ * from LoopSubdivider, since blocks consist of triangles. Non-manifold meshes
+ * are subdivided level by level: the halo of a block is found by rotating
+ * around its vertices, which misses faces where several fans meet.
+ * @param mesh The mesh to subdivide.
+ * @return The subdivided mesh, identical to the result of applying
+ * LoopSubdivider the same number of times.
+ */
+Mesh BlockedSubdivider::subdivide(const Mesh& mesh) const {
+  if (levels == 0) {
+    return mesh;
+  }
+  if (!mesh.isTriangleMesh()) {
+    LoopSubdivider subdivider;
+    subdivider.setNumThreads(numThreads);
+    BlockedSubdivider remaining = *this;
+    remaining.setLevels(levels - 1);
+    return remaining.subdivide(subdivider.subdivide(mesh));
+  }
+  if (!isManifold(mesh)) {
+    LoopSubdivider subdivider;
+    subdivider.setNumThreads(numThreads);
+    Mesh result = subdivider.subdivide(mesh);
+    for (int l = 1; l < levels; l++) {
+      result = subdivider.subdivide(result);
+    }
+    return result;
+  }
+
+  QVector<LevelSizes> sizes;
+  LevelSizes size = {mesh.numVerts(), mesh.numHalfEdges(), mesh.numEdges()};
+  for (int l = 0; l < levels; l++) {
+    sizes.append(size);
+    size = {size.numVerts + size.numEdges, 4 * size.numHalfEdges,
+            2 * size.numEdges + size.numHalfEdges};
+  }
+  Mesh result;
+  result.resize(size.numVerts, size.numHalfEdges, size.numHalfEdges / 3,
+                true);
+  result.edgeCount = size.numEdges;
+
+  QVector<int> faces(mesh.numFaces());
+  for (int f = 0; f < mesh.numFaces(); f++) {
+    faces[f] = f;
+  }
+  QVector<QVector<int>> patches = partition(mesh, faces, patchSize(levels));
+  parallelFor(0, patches.size(), numThreads, [&](int begin, int end, int) {
+    // Blocks are small; the threads are spent on the patches instead.
+    Workspace workspace;
+    workspace.subdivider.setNumThreads(1);
+    for (int i = begin; i < end; i++) {
+      subdivideBlock(extractBlock(mesh, nullptr, patches[i], workspace), 0,
+                     sizes, workspace, result);
+    }
+  });
+
+  // Isolated vertices are not part of any block and never move.
+  for (int v = 0; v < mesh.numVerts(); v++) {
+    if (mesh.out(v) < 0) {
+      result.setCoords(v, mesh.coords(v));
+      result.vertexValence[v] = mesh.valence(v);
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief BlockedSubdivider::partition Splits a set of faces into patches of
+ * neighbouring faces. Every patch is grown from the first face that is not in
+ * a patch yet, in breadth-first order, which keeps the patches compact and
+ * their halos small.
+ * @param mesh The triangle mesh.
+ * @param faces The faces to split.
+ * @param patchSize The maximum number of faces of a patch.
+ * @return The patches, each in ascending order.
+ */
+QVector<QVector<int>> BlockedSubdivider::partition(const Mesh& mesh,
+                                                   const QVector<int>& faces,
+                                                   int patchSize) {
+  // -1 for faces outside of the set, 0 for faces that are not in a patch yet
+  // and 1 for faces that are.
+  QVector<int> state(mesh.numFaces(), -1);
+  for (int f : faces) {
+    state[f] = 0;
+  }
+  QVector<QVector<int>> patches;
+  QVector<int> queue;
+  for (int seed : faces) {
+    if (state[seed] != 0) {
+      continue;
+    }
+    QVector<int> patch;
+    queue.resize(0);
+    queue.append(seed);
+    state[seed] = 1;
+    for (int i = 0; i < queue.size() && patch.size() < patchSize; i++) {
+      int f = queue[i];
+      patch.append(f);
+      for (int k = 0; k < 3; k++) {
+        int twin = mesh.twin(mesh.side(f) + k);
+        if (twin >= 0 && state[mesh.face(twin)] == 0) {
+          state[mesh.face(twin)] = 1;
+          queue.append(mesh.face(twin));
+        }
+      }
+    }
+    // The faces that were reached but did not fit are left for later patches.
+    for (int i = patch.size(); i < queue.size(); i++) {
+      state[queue[i]] = 0;
+    }
+    std::sort(patch.begin(), patch.end());
+    patches.append(patch);
+  }
+  return patches;
+}
+
+/**
+ * @brief BlockedSubdivider::patchSize Determines the size of the patches of
+ * blocks that still have to be subdivided a number of times.
+ * @param levels The number of remaining subdivision steps.
+ * @return The maximum number of faces of a patch.
+ */
+int BlockedSubdivider::patchSize(int levels) {
+  return std::max(MIN_PATCH_FACES, BLOCK_FACES >> (2 * std::min(levels, 15)));
+}
+
+/**
+ * @brief BlockedSubdivider::extractBlock Copies a patch and its halo into a
+ * new block. The faces, vertices and edges keep their relative order.
+ * @param mesh The triangle mesh the patch belongs to. The one-ring of every
+ * vertex of the patch has to be part of it.
+ * @param parent The block the mesh belongs to, which provides the global
+ * indices. nullptr if the mesh is the whole mesh.
+ * @param patch The faces of the patch, in ascending order.
+ * @param workspace The workspace of the calling thread.
+ * @return The block.
+ */
+BlockedSubdivider::Block BlockedSubdivider::extractBlock(
+    const Mesh& mesh, const Block* parent, const QVector<int>& patch,
+    Workspace& workspace) {
+  QVector<int>& vertexMap = workspace.vertexMap;
+  QVector<int>& edgeMap = workspace.edgeMap;
+  QVector<int>& faceMap = workspace.faceMap;
+  reserveMap(vertexMap, mesh.numVerts());
+  reserveMap(edgeMap, mesh.numEdges());
+  reserveMap(faceMap, mesh.numFaces());
+
+  // The patch and its halo: every face around a vertex of the patch. The
+  // maps mark the elements that were found until they get their index.
+  QVector<int> vertices;
+  for (int f : patch) {
+    for (int k = 0; k < 3; k++) {
+      addElement(mesh.origin(mesh.side(f) + k), vertices, vertexMap);
+    }
+  }
+  QVector<int> faces;
+  for (int v : vertices) {
+    for (int h : mesh.outgoingHalfEdges(v)) {
+      addElement(mesh.face(h), faces, faceMap);
+    }
+  }
+  QVector<int> edges;
+  for (int f : faces) {
+    for (int k = 0; k < 3; k++) {
+      addElement(mesh.origin(mesh.side(f) + k), vertices, vertexMap);
+      addElement(mesh.edge(mesh.side(f) + k), edges, edgeMap);
+    }
+  }
+  assignLocalIndices(vertices, vertexMap);
+  assignLocalIndices(edges, edgeMap);
+  assignLocalIndices(faces, faceMap);
+
+  Block block;
+  Mesh& local = block.mesh;
+  local.resize(vertices.size(), 3 * faces.size(), faces.size(), true);
+  local.edgeCount = edges.size();
+  block.vertexIds.resize(vertices.size());
+  block.halfEdgeIds.resize(3 * faces.size());
+  block.edgeIds.resize(edges.size());
+
+  const int* localVertex = vertexMap.constData();
+  const int* localEdge = edgeMap.constData();
+  const int* localFace = faceMap.constData();
+  int* origins = local.halfEdgeOrigin.data();
+  int* twins = local.halfEdgeTwin.data();
+  int* edgeIndices = local.halfEdgeEdge.data();
+  int* outs = local.vertexOut.data();
+  for (int i = 0; i < faces.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      int h = mesh.side(faces[i]) + k;
+      int g = 3 * i + k;
+      origins[g] = localVertex[mesh.origin(h)];
+      edgeIndices[g] = localEdge[mesh.edge(h)];
+      int twin = mesh.twin(h);
+      if (twin >= 0 && localFace[mesh.face(twin)] >= 0) {
+        twins[g] = 3 * localFace[mesh.face(twin)] + twin % 3;
+      }
+      block.halfEdgeIds[g] = parent ? parent->halfEdgeIds[h] : h;
+    }
+  }
+  for (int i = 0; i < vertices.size(); i++) {
+    int v = vertices[i];
+    local.setCoords(i, mesh.coords(v));
+    local.vertexValence[i] = mesh.valence(v);
+    // Vertices of the patch keep their outgoing half-edge, so the neighbours
+    // are visited in the same order.
+    int out = mesh.out(v);
+    if (localFace[mesh.face(out)] >= 0) {
+      outs[i] = 3 * localFace[mesh.face(out)] + out % 3;
+    }
+    block.vertexIds[i] = parent ? parent->vertexIds[v] : v;
+  }
+  // Vertices on the outside of the halo may have lost their outgoing
+  // half-edge; any other one will do for them.
+  for (int g = 0; g < local.numHalfEdges(); g++) {
+    if (outs[origins[g]] < 0) {
+      outs[origins[g]] = g;
+    }
+  }
+  for (int i = 0; i < edges.size(); i++) {
+    block.edgeIds[i] = parent ? parent->edgeIds[edges[i]] : edges[i];
+  }
+  for (int f : patch) {
+    block.patchFaces.append(localFace[f]);
+  }
+
+  // Leave the maps empty for the next block.
+  for (int v : vertices) {
+    vertexMap[v] = -1;
+  }
+  for (int e : edges) {
+    edgeMap[e] = -1;
+  }
+  for (int f : faces) {
+    faceMap[f] = -1;
+  }
+  return block;
+}
+
+/**
+ * @brief BlockedSubdivider::refineBlock Subdivides a block once and derives
+ * the global indices of the new elements from the subdivision indexing rules
+ * (see LoopSubdivider::topologyRefinement).
+ * @param block The block.
+ * @param sizes The sizes of the whole mesh at the level of the block.
+ * @param workspace The workspace of the calling thread.
+ * @return The subdivided block. Its patch consists of the faces that the
+ * faces of the patch were split into.
+ */
+BlockedSubdivider::Block BlockedSubdivider::refineBlock(
+    const Block& block, const LevelSizes& sizes, Workspace& workspace) const {
+  const Mesh& mesh = block.mesh;
+  int numVerts = mesh.numVerts();
+  int numHalfEdges = mesh.numHalfEdges();
+  int numEdges = mesh.numEdges();
+
+  Block child;
+  child.mesh = workspace.subdivider.subdivide(mesh);
+  child.vertexIds.resize(numVerts + numEdges);
+  child.halfEdgeIds.resize(4 * numHalfEdges);
+  child.edgeIds.resize(2 * numEdges + numHalfEdges);
+  const int* vertexIds = block.vertexIds.constData();
+  const int* halfEdgeIds = block.halfEdgeIds.constData();
+  const int* edgeIds = block.edgeIds.constData();
+  int* childVertexIds = child.vertexIds.data();
+  int* childHalfEdgeIds = child.halfEdgeIds.data();
+  int* childEdgeIds = child.edgeIds.data();
+  for (int v = 0; v < numVerts; v++) {
+    childVertexIds[v] = vertexIds[v];
+  }
+  for (int e = 0; e < numEdges; e++) {
+    childVertexIds[numVerts + e] = sizes.numVerts + edgeIds[e];
+    childEdgeIds[2 * e] = 2 * edgeIds[e];
+    childEdgeIds[2 * e + 1] = 2 * edgeIds[e] + 1;
+  }
+  for (int h = 0; h < numHalfEdges; h++) {
+    int id = halfEdgeIds[h];
+    for (int k = 0; k < 3; k++) {
+      childHalfEdgeIds[3 * h + k] = 3 * id + k;
+    }
+    childHalfEdgeIds[3 * numHalfEdges + h] = 3 * sizes.numHalfEdges + id;
+    childEdgeIds[2 * numEdges + h] = 2 * sizes.numEdges + id;
+  }
+  // Every face is split into a triangle per corner, with the index of the
+  // half-edge at that corner, and a triangle in the middle.
+  for (int f : block.patchFaces) {
+    for (int k = 0; k < 3; k++) {
+      child.patchFaces.append(3 * f + k);
+    }
+  }
+  for (int f : block.patchFaces) {
+    child.patchFaces.append(numHalfEdges + f);
+  }
+  return child;
+}
+
+/**
+ * @brief BlockedSubdivider::subdivideBlock Subdivides a block up to the last
+ * level and writes its patch into the result. Blocks that would not fit in
+ * the cache at the last level are subdivided once and split up.
+ * @param block The block.
+ * @param level The level of the block.
+ * @param sizes The sizes of the whole mesh at every level.
+ * @param workspace The workspace of the calling thread.
+ * @param result The subdivided mesh.
+ */
+void BlockedSubdivider::subdivideBlock(const Block& block, int level,
+                                       const QVector<LevelSizes>& sizes,
+                                       Workspace& workspace,
+                                       Mesh& result) const {
+  int remaining = levels - level;
+  if (remaining == 0) {
+    writeBlock(block, result);
+  } else if (descendants(block.patchFaces.size(), remaining) <= BLOCK_FACES) {
+    Block child = refineBlock(block, sizes[level], workspace);
+    for (int l = level + 1; l < levels; l++) {
+      child = refineBlock(child, sizes[l], workspace);
+    }
+    writeBlock(child, result);
+  } else {
+    Block child = refineBlock(block, sizes[level], workspace);
+    QVector<QVector<int>> patches =
+        partition(child.mesh, child.patchFaces, patchSize(remaining - 1));
+    for (const QVector<int>& patch : patches) {
+      subdivideBlock(extractBlock(child.mesh, &child, patch, workspace),
+                     level + 1, sizes, workspace, result);
+    }
+  }
+}
+
+/**
+ * @brief BlockedSubdivider::writeBlock Writes the patch of a block at the
+ * last level into the result. Every half-edge belongs to exactly one patch,
+ * and every vertex is written by the patch its outgoing half-edge belongs to,
+ * so blocks never write to the same slot.
+ * @param block The block.
+ * @param result The subdivided mesh.
+ */
+void BlockedSubdivider::writeBlock(const Block& block, Mesh& result) const {
+  const Mesh& mesh = block.mesh;
+  int* origins = result.halfEdgeOrigin.data();
+  int* twins = result.halfEdgeTwin.data();
+  int* edges = result.halfEdgeEdge.data();
+  for (int f : block.patchFaces) {
+    for (int k = 0; k < 3; k++) {
+      int h = 3 * f + k;
+      int id = block.halfEdgeIds[h];
+      int twin = mesh.twin(h);
+      origins[id] = block.vertexIds[mesh.origin(h)];
+      twins[id] = twin < 0 ? -1 : block.halfEdgeIds[twin];
+      edges[id] = block.edgeIds[mesh.edge(h)];
+
+      int v = mesh.origin(h);
+      if (mesh.out(v) == h) {
+        int vertexId = block.vertexIds[v];
+        result.setCoords(vertexId, mesh.coords(v));
+        result.vertexValence[vertexId] = mesh.valence(v);
+        result.vertexOut[vertexId] = id;
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef BLOCKED_SUBDIVIDER_H
+#define BLOCKED_SUBDIVIDER_H
+
+#include <QVector>
+
+#include "loopsubdivider.h"
+#include "mesh/mesh.h"
+#include "subdivider.h"
+
+/**
+ * @brief The BlockedSubdivider class applies several steps of Loop
+ * subdivision at once, depth-first, without materializing the intermediate
+ * levels.
+ *
+ * The mesh is partitioned into patches of faces. Every patch is copied into a
+ * small block together with a halo: the faces that share a vertex with it.
+ * The one-ring around a face determines all of its descendants, so the block
+ * can be subdivided on its own, and the descendants of the patch come out
+ * exactly as if the whole mesh had been subdivided. Blocks whose last level
+ * would not fit in the cache are subdivided one level and split into smaller
+ * blocks first. The descendants of the patch are then written directly into
+ * the final mesh.
+ *
+ * A block numbers its elements in the same order as the whole mesh does, and
+ * keeps the global index of every element at its level; the subdivision
+ * indexing rules turn these into the global indices at the next level. Since
+ * the order is preserved, every choice LoopSubdivider makes on the block (the
+ * outgoing half-edges, and thereby the order in which the stencils are
+ * summed) matches the choice it makes on the whole mesh, so the result is
+ * identical to subdividing level by level. The faces of the halo are
+ * subdivided more than once, which is the price for streaming the mesh
+ * through memory only once.
+ */
+class BlockedSubdivider : public Subdivider {
+ public:
+  BlockedSubdivider();
+  void setNumThreads(int numThreads);
+  void setLevels(int levels);
+  Mesh subdivide(const Mesh& mesh) const override;
+
+ private:
+  // A patch of faces and the faces around it, with the global index of every
+  // vertex, half-edge and undirected edge of the block at its level.
+  struct Block {
+    Mesh mesh;
+    QVector<int> vertexIds;
+    QVector<int> halfEdgeIds;
+    QVector<int> edgeIds;
+    // Faces of the patch, in ascending order.
+    QVector<int> patchFaces;
+  };
+
+  // The number of vertices, half-edges and edges of the whole mesh at a
+  // level.
+  struct LevelSizes {
+    int numVerts;
+    int numHalfEdges;
+    int numEdges;
+  };
+
+  // The state of a thread: a serial subdivider for its blocks, and the local
+  // index of every vertex, edge and face of the mesh a block is extracted
+  // from, which is -1 for elements outside of the block.
+  struct Workspace {
+    LoopSubdivider subdivider;
+    QVector<int> vertexMap;
+    QVector<int> edgeMap;
+    QVector<int> faceMap;
+  };
+
+  static QVector<QVector<int>> partition(const Mesh& mesh,
+                                         const QVector<int>& faces,
+                                         int patchSize);
+  static int patchSize(int levels);
+  static Block extractBlock(const Mesh& mesh, const Block* parent,
+                            const QVector<int>& patch, Workspace& workspace);
+  Block refineBlock(const Block& block, const LevelSizes& sizes,
+                    Workspace& workspace) const;
+  void subdivideBlock(const Block& block, int level,
+                      const QVector<LevelSizes>& sizes, Workspace& workspace,
+                      Mesh& result) const;
+  void writeBlock(const Block& block, Mesh& result) const;
+
+  int numThreads;
+  int levels;
+};
+
+#endif  // BLOCKED_SUBDIVIDER_H
@@ -0,0 +1,285 @@
+#include "incrementalsubdivider.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "loopstencils.h"
+
+/**
+ * @brief sortUnique Sorts a list of indices and removes the duplicates.
+ * @param indices The indices.
+ */
+static void sortUnique(QVector<int>& indices) {
+  std::sort(indices.begin(), indices.end());
+  indices.resize(std::unique(indices.begin(), indices.end()) - indices.begin());
+}
+
+/**
+ * @brief vertexPoint Calculates the vertex point of a vertex with the stencil
+ * that matches its type.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex.
+ * @return The coordinates of the vertex point.
+ */
+static QVector3D vertexPoint(const Mesh& mesh, int v) {
+  switch (classifyVertex(mesh, v)) {
+    case LoopStencil::Regular:
+      return loopVertexPoint<LoopStencil::Regular>(mesh, v);
+    case LoopStencil::Boundary:
+      return loopVertexPoint<LoopStencil::Boundary>(mesh, v);
+    default:
+      return loopVertexPoint<LoopStencil::Extraordinary>(mesh, v);
+  }
+}
+
+/**
+ * @brief edgePoint Calculates the edge point of an edge.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges of the edge.
+ * @return The coordinates of the edge point.
+ */
+static QVector3D edgePoint(const Mesh& mesh, int h) {
+  QVector3D first = mesh.coords(mesh.origin(h));
+  QVector3D second = mesh.coords(mesh.origin(mesh.next(h)));
+  if (mesh.isBoundaryEdge(h)) {
+    return (first + second) / 2.0;
+  }
+  QVector3D third = mesh.coords(mesh.origin(mesh.prev(mesh.twin(h))));
+  QVector3D fourth = mesh.coords(mesh.origin(mesh.next(mesh.next(h))));
+  return (first + second) * (3.0 / 8.0) + (third + fourth) * (1.0 / 8.0);
+}
+
+/**
+ * @brief vertexNormal Calculates the normal of a vertex like
+ * Mesh::recalculateNormals does, adding the contributions of the outgoing
+ * half-edges in the same order so that the results are identical.
+ * @param mesh The mesh, with up-to-date face normals.
+ * @param v Index of the vertex.
+ * @param outgoing Scratch space for the outgoing half-edges, reused between
+ * calls to avoid an allocation per vertex.
+ * @return The unit vertex normal.
+ */
+static QVector3D vertexNormal(const Mesh& mesh, int v, QVector<int>& outgoing) {
+  outgoing.resize(0);
+  if (mesh.out(v) >= 0) {
+    for (int h : mesh.outgoingHalfEdges(v)) {
+      outgoing.append(h);
+    }
+  }
+  std::sort(outgoing.begin(), outgoing.end());
+  QVector3D normal = {0, 0, 0};
+  for (int h : outgoing) {
+    QVector3D pPrev = mesh.coords(mesh.origin(mesh.prev(h)));
+    QVector3D pCur = mesh.coords(mesh.origin(h));
+    QVector3D pNext = mesh.coords(mesh.origin(mesh.next(h)));
+
+    QVector3D edgeA = (pPrev - pCur);
+    QVector3D edgeB = (pNext - pCur);
+
+    double edgeLengths = edgeA.length() * edgeB.length();
+    double edgeDot = QVector3D::dotProduct(edgeA, edgeB) / edgeLengths;
+    double angle = sqrt(1 - edgeDot * edgeDot);
+
+    normal += (angle * mesh.faceNormal(mesh.face(h))) / edgeLengths;
+  }
+  normal.normalize();
+  return normal;
+}
+
+/**
+ * @brief IncrementalSubdivider::IncrementalSubdivider Creates a new
+ * incremental subdivider without any levels.
+ */
+IncrementalSubdivider::IncrementalSubdivider() {}
+
+/**
+ * @brief IncrementalSubdivider::setLevels Starts editing a hierarchy of
+ * subdivision levels. The provided snapshots are left untouched; edits are
+ * made on copies.
+ * @param hierarchy The levels, starting with the control mesh; every level
+ * has to be the Loop subdivision of the previous one.
+ */
+void IncrementalSubdivider::setLevels(const QVector<MeshHandle>& hierarchy) {
+  meshes = hierarchy;
+  changed = QVector<QVector<int>>(meshes.size());
+}
+
+/**
+ * @brief IncrementalSubdivider::clear Stops editing and releases the levels.
+ */
+void IncrementalSubdivider::clear() {
+  meshes.clear();
+  changed.clear();
+}
+
+/**
+ * @brief IncrementalSubdivider::isEmpty Checks whether a hierarchy is being
+ * edited.
+ * @return True if there are no levels; false otherwise.
+ */
+bool IncrementalSubdivider::isEmpty() const { return meshes.isEmpty(); }
+
+/**
+ * @brief IncrementalSubdivider::numLevels Retrieves the number of levels,
+ * including the control mesh.
+ * @return The number of levels.
+ */
+int IncrementalSubdivider::numLevels() const { return meshes.size(); }
+
+/**
+ * @brief IncrementalSubdivider::level Retrieves one of the edited levels.
+ * @param level The subdivision level.
+ * @return Handle to the level as of the last edit. Later edits do not change
+ * it.
+ */
+MeshHandle IncrementalSubdivider::level(int level) const {
+  return meshes[level];
+}
+
+/**
+ * @brief IncrementalSubdivider::levels Retrieves all edited levels.
+ * @return Handles to the levels, starting with the control mesh.
+ */
+QVector<MeshHandle> IncrementalSubdivider::levels() const { return meshes; }
+
+/**
+ * @brief IncrementalSubdivider::moveVertices Moves vertices of the control
+ * mesh and updates all levels. The levels are replaced by edited copies.
+ * @param vertices Indices of the control vertices.
+ * @param coords The new coordinates of the vertices.
+ */
+void IncrementalSubdivider::moveVertices(const QVector<int>& vertices,
+                                         const QVector<QVector3D>& coords) {
+  if (meshes.isEmpty()) {
+    return;
+  }
+  QVector<QSharedPointer<Mesh>> edited;
+  for (const MeshHandle& mesh : meshes) {
+    edited.append(QSharedPointer<Mesh>(new Mesh(*mesh)));
+  }
+  Mesh& controlMesh = *edited[0];
+  QVector<int> moved;
+  for (int i = 0; i < vertices.size(); ++i) {
+    controlMesh.setCoords(vertices[i], coords[i]);
+    moved.append(vertices[i]);
+  }
+  sortUnique(moved);
+  updateAttributes(controlMesh, moved, changed[0]);
+  for (int l = 1; l < edited.size(); ++l) {
+    QVector<int> childMoved;
+    refineLevel(*edited[l - 1], moved, *edited[l], childMoved);
+    updateAttributes(*edited[l], childMoved, changed[l]);
+    moved = std::move(childMoved);
+  }
+  for (int l = 0; l < edited.size(); ++l) {
+    meshes[l] = edited[l];
+  }
+}
+
+/**
+ * @brief IncrementalSubdivider::changedVertices Retrieves the vertices of a
+ * level whose coordinates or normal changed during the last edit, i.e. in
+ * which the current handle of the level differs from the previous one.
+ * @param level The subdivision level.
+ * @return Indices of the vertices, in ascending order.
+ */
+const QVector<int>& IncrementalSubdivider::changedVertices(int level) const {
+  return changed[level];
+}
+
+/**
+ * @brief IncrementalSubdivider::refineLevel Recomputes the vertices of a level
+ * that depend on the moved vertices of its parent: the vertex points of the
+ * moved vertices and their neighbours, and the edge points of all edges of
+ * the faces around the moved vertices. On faces with more than three sides,
+ * the edge point of a side also depends on the vertex two sides ahead.
+ * @param parent The parent level.
+ * @param moved The moved vertices of the parent, in ascending order.
+ * @param child The level to update.
+ * @param childMoved Is set to the moved vertices of the child, in ascending
+ * order.
+ */
+void IncrementalSubdivider::refineLevel(const Mesh& parent,
+                                        const QVector<int>& moved, Mesh& child,
+                                        QVector<int>& childMoved) const {
+  QVector<int> vertices;
+  // One half-edge per edge: the one that is not smaller than its twin.
+  QVector<int> halfEdges;
+  for (int v : moved) {
+    vertices.append(v);
+    if (parent.out(v) < 0) {
+      continue;
+    }
+    for (int h : parent.outgoingHalfEdges(v)) {
+      int f = parent.face(h);
+      for (int k = 0; k < parent.faceValence(f); k++) {
+        int side = parent.side(f) + k;
+        vertices.append(parent.origin(side));
+        halfEdges.append(std::max(side, parent.twin(side)));
+      }
+    }
+  }
+  sortUnique(vertices);
+  sortUnique(halfEdges);
+
+  int numVerts = parent.numVerts();
+  for (int v : vertices) {
+    child.setCoords(v, vertexPoint(parent, v));
+    childMoved.append(v);
+  }
+  for (int h : halfEdges) {
+    int v = numVerts + parent.edge(h);
+    child.setCoords(v, edgePoint(parent, h));
+    childMoved.append(v);
+  }
+}
+
+/**
+ * @brief IncrementalSubdivider::updateAttributes Updates the face normals of
+ * the faces around the moved vertices, and the extracted coordinates and
+ * normals of their corners. Meshes without extracted attributes only get
+ * their face normals updated.
+ * @param mesh The mesh.
+ * @param moved The moved vertices, in ascending order.
+ * @param changed Is set to the vertices whose coordinates or normal changed,
+ * in ascending order.
+ */
+void IncrementalSubdivider::updateAttributes(Mesh& mesh,
+                                             const QVector<int>& moved,
+                                             QVector<int>& changed) const {
+  QVector<int> faces;
+  for (int v : moved) {
+    if (mesh.out(v) >= 0) {
+      for (int h : mesh.outgoingHalfEdges(v)) {
+        faces.append(mesh.face(h));
+      }
+    }
+  }
+  sortUnique(faces);
+
+  changed = moved;
+  bool faceNormals = mesh.faceNormals.size() == mesh.numFaces();
+  for (int f : faces) {
+    if (faceNormals) {
+      mesh.faceNormals[f] = mesh.computeFaceNormal(f);
+    }
+    for (int k = 0; k < mesh.faceValence(f); ++k) {
+      changed.append(mesh.origin(mesh.side(f) + k));
+    }
+  }
+  sortUnique(changed);
+
+  QVector<QVector3D>& vertexCoords = mesh.getVertexCoords();
+  QVector<QVector3D>& vertexNormals = mesh.getVertexNorms();
+  if (!faceNormals || vertexCoords.size() != mesh.numVerts() ||
+      vertexNormals.size() != mesh.numVerts()) {
+    return;
+  }
+  QVector3D* coordsData = vertexCoords.data();
+  QVector3D* normalsData = vertexNormals.data();
+  QVector<int> outgoing;
+  for (int v : changed) {
+    coordsData[v] = mesh.coords(v);
+    normalsData[v] = vertexNormal(mesh, v, outgoing);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef INCREMENTAL_SUBDIVIDER_H
+#define INCREMENTAL_SUBDIVIDER_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The IncrementalSubdivider class keeps a hierarchy of subdivision
+ * levels up to date while control vertices are edited, without subdividing
+ * the mesh again.
+ *
+ * Moving a set of vertices D of a level only changes the vertex points of D
+ * and its one-ring, and the edge points of the edges of the faces around D,
+ * in the next level. These form the set of moved vertices of the next level,
+ * so the work per level is proportional to the support of the edited control
+ * vertices at that level. The normals and extracted attributes are updated
+ * for the faces around the moved vertices only.
+ *
+ * Edits are copy-on-write: every edit works on copies of the levels and
+ * publishes them as new handles, so the handles handed out earlier remain
+ * immutable snapshots. The copies share the connectivity of the originals;
+ * only the coordinates and normals are duplicated.
+ */
+class IncrementalSubdivider {
+ public:
+  IncrementalSubdivider();
+
+  void setLevels(const QVector<MeshHandle>& hierarchy);
+  void clear();
+  bool isEmpty() const;
+  int numLevels() const;
+  MeshHandle level(int level) const;
+  QVector<MeshHandle> levels() const;
+
+  void moveVertices(const QVector<int>& vertices,
+                    const QVector<QVector3D>& coords);
+  const QVector<int>& changedVertices(int level) const;
+
+ private:
+  void refineLevel(const Mesh& parent, const QVector<int>& moved,
+                   Mesh& child, QVector<int>& childMoved) const;
+  void updateAttributes(Mesh& mesh, const QVector<int>& moved,
+                        QVector<int>& changed) const;
+
+  QVector<MeshHandle> meshes;
+  // Per level: the vertices whose coordinates or normal changed during the
+  // last edit, in ascending order.
+  QVector<QVector<int>> changed;
+};
+
+#endif  // INCREMENTAL_SUBDIVIDER_H
@@ -0,0 +1,240 @@
+#include "levelcache.h"
+
+#include <QDebug>
+#include <climits>
+
+/**
+ * @brief LevelCache::LevelCache Creates an empty level cache.
+ * @param memoryBudget The maximum number of bytes the cached levels may use.
+ */
+LevelCache::LevelCache(qint64 memoryBudget)
+    : useCounter(0), budget(memoryBudget) {}
+
+/**
+ * @brief LevelCache::setBaseMesh Replaces all levels by a new base mesh.
+ * @param baseMesh The mesh at level 0.
+ */
+void LevelCache::setBaseMesh(Mesh baseMesh) {
+  clear();
+  store(0, createSnapshot(std::move(baseMesh)));
+}
+
+/**
+ * @brief LevelCache::replaceLevels Replaces the cached levels, for instance by
+ * levels that were edited. Deeper levels are discarded, since they were
+ * computed from the old levels.
+ * @param meshes The new levels, starting with the base mesh. Their attributes
+ * have to be extracted already.
+ */
+void LevelCache::replaceLevels(const QVector<MeshHandle>& meshes) {
+  clear();
+  for (int l = 0; l < meshes.size(); l++) {
+    store(l, meshes[l]);
+  }
+  evict(0, -1);
+}
+
+/**
+ * @brief LevelCache::clear Removes all levels, including the base mesh.
+ */
+void LevelCache::clear() {
+  levels.clear();
+  lastUsed.clear();
+}
+
+/**
+ * @brief LevelCache::isEmpty Checks whether the cache has a base mesh.
+ * @return True if there is no base mesh; false otherwise.
+ */
+bool LevelCache::isEmpty() const { return levels.isEmpty(); }
+
+/**
+ * @brief LevelCache::setMemoryBudget Sets the memory budget and evicts levels
+ * until the cache fits in it.
+ * @param memoryBudget The maximum number of bytes the cached levels may use.
+ */
+void LevelCache::setMemoryBudget(qint64 memoryBudget) {
+  budget = memoryBudget;
+  evict(0, -1);
+}
+
+/**
+ * @brief LevelCache::memoryBudget Retrieves the memory budget.
+ * @return The maximum number of bytes the cached levels may use.
+ */
+qint64 LevelCache::memoryBudget() const { return budget; }
+
+/**
+ * @brief LevelCache::memoryUsage Computes the memory used by the cached
+ * levels.
+ * @return The memory usage in bytes.
+ */
+qint64 LevelCache::memoryUsage() const {
+  qint64 usage = 0;
+  for (const MeshHandle& mesh : levels) {
+    if (!mesh.isNull()) {
+      usage += mesh->memoryFootprint();
+    }
+  }
+  return usage;
+}
+
+/**
+ * @brief LevelCache::predictCounts Predicts the element counts of a level
+ * from those of the base mesh.
+ * @param level The subdivision level.
+ * @return The element counts of the level.
+ */
+LoopSubdivider::ElementCounts LevelCache::predictCounts(int level) const {
+  return LoopSubdivider::predictCounts(*levels[0], level);
+}
+
+/**
+ * @brief LevelCache::predictFootprint Predicts the memory footprint of a
+ * level without computing it.
+ * @param level The subdivision level.
+ * @return The predicted footprint in bytes.
+ */
+qint64 LevelCache::predictFootprint(int level) const {
+  if (level == 0) {
+    return levels[0]->memoryFootprint();
+  }
+  LoopSubdivider::ElementCounts counts = predictCounts(level);
+  return Mesh::predictFootprint(counts.numVertices, counts.numHalfEdges,
+                                counts.numFaces, true);
+}
+
+/**
+ * @brief LevelCache::requiredMemory Computes the least amount of memory
+ * needed to obtain a level: the base mesh, the level itself and, while it is
+ * computed, its parent.
+ * @param level The subdivision level.
+ * @return The required memory in bytes.
+ */
+qint64 LevelCache::requiredMemory(int level) const {
+  qint64 required = predictFootprint(0);
+  if (level > 1) {
+    required += predictFootprint(level - 1);
+  }
+  if (level > 0) {
+    required += predictFootprint(level);
+  }
+  return required;
+}
+
+/**
+ * @brief LevelCache::fitsBudget Checks whether a level can be obtained within
+ * the memory budget. The base mesh always fits.
+ * @param level The subdivision level.
+ * @return True if the level fits; false otherwise.
+ */
+bool LevelCache::fitsBudget(int level) const {
+  if (isEmpty() || level < 0) {
+    return false;
+  }
+  if (level == 0 || isCached(level)) {
+    return true;
+  }
+  // The arrays of a mesh are indexed with ints.
+  if (predictCounts(level).numHalfEdges > INT_MAX) {
+    return false;
+  }
+  return requiredMemory(level) <= budget;
+}
+
+/**
+ * @brief LevelCache::isCached Checks whether a level is currently cached.
+ * @param level The subdivision level.
+ * @return True if the level is cached; false otherwise.
+ */
+bool LevelCache::isCached(int level) const {
+  return level >= 0 && level < levels.size() && !levels[level].isNull();
+}
+
+/**
+ * @brief LevelCache::level Retrieves a level. If the level is not cached, it
+ * is computed from the nearest cached ancestor; the intermediate levels are
+ * cached as long as they fit in the budget.
+ * @param level The subdivision level.
+ * @return A snapshot of the level. Null if there is no base mesh or if the
+ * level does not fit in the memory budget.
+ */
+MeshHandle LevelCache::level(int level) {
+  if (!fitsBudget(level)) {
+    if (!isEmpty() && level > 0) {
+      qDebug() << ":: Level" << level << "needs about"
+               << requiredMemory(level) / (1 << 20) << "MB, the budget is"
+               << budget / (1 << 20) << "MB";
+    }
+    return MeshHandle();
+  }
+  int ancestor = level;
+  while (!isCached(ancestor)) {
+    ancestor--;
+  }
+  lastUsed[ancestor] = ++useCounter;
+  MeshHandle mesh = levels[ancestor];
+  for (int l = ancestor + 1; l <= level; l++) {
+    // Make room for the new level; its parent is still needed to compute it.
+    qint64 required = predictFootprint(l);
+    if (!isCached(l - 1)) {
+      required += mesh->memoryFootprint();
+    }
+    evict(required, l - 1);
+    mesh = createSnapshot(subdivider.subdivide(*mesh));
+    store(l, mesh);
+  }
+  return mesh;
+}
+
+/**
+ * @brief LevelCache::createSnapshot Turns a mesh into an immutable snapshot.
+ * The attributes are extracted once, here.
+ * @param mesh The mesh.
+ * @return A handle to the snapshot.
+ */
+MeshHandle LevelCache::createSnapshot(Mesh mesh) const {
+  mesh.extractAttributes();
+  return MeshHandle(new Mesh(std::move(mesh)));
+}
+
+/**
+ * @brief LevelCache::store Stores a level in the cache and marks it as most
+ * recently used.
+ * @param level The subdivision level.
+ * @param mesh The snapshot of the level.
+ */
+void LevelCache::store(int level, const MeshHandle& mesh) {
+  if (levels.size() <= level) {
+    levels.resize(level + 1);
+    lastUsed.resize(level + 1);
+  }
+  levels[level] = mesh;
+  lastUsed[level] = ++useCounter;
+}
+
+/**
+ * @brief LevelCache::evict Evicts the least recently used levels until the
+ * provided number of bytes fits in the budget next to the cached levels. The
+ * base mesh is never evicted.
+ * @param requiredBytes The number of bytes to make room for.
+ * @param sourceLevel A level that may not be evicted either; -1 if there is
+ * none.
+ */
+void LevelCache::evict(qint64 requiredBytes, int sourceLevel) {
+  qint64 usage = memoryUsage();
+  while (usage + requiredBytes > budget) {
+    int victim = -1;
+    for (int l = 1; l < levels.size(); l++) {
+      if (isCached(l) && l != sourceLevel &&
+          (victim == -1 || lastUsed[l] < lastUsed[victim])) {
+        victim = l;
+      }
+    }
+    if (victim == -1) {
+      return;
+    }
+    usage -= levels[victim]->memoryFootprint();
+    levels[victim].reset();
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include <QVector>
+
+#include "loopsubdivider.h"
+#include "mesh/mesh.h"
+
+// Default memory budget of a level cache: 4 GiB.
+#define DEFAULT_LEVEL_CACHE_BUDGET (qint64(4) << 30)
+
+/**
+ * @brief The LevelCache class holds the subdivision levels of a base mesh
+ * within a memory budget. Levels are computed on demand from the nearest
+ * cached ancestor. When the budget runs out, the least recently used levels
+ * are evicted; the base mesh is always kept. The footprint of a level is
+ * predicted from its element counts before it is computed, so levels that can
+ * never fit in the budget are refused instead of computed.
+ *
+ * Levels are handed out as immutable snapshots with their attributes already
+ * extracted. The only exception are levels that are being edited by an
+ * IncrementalSubdivider, which can be put into the cache with replaceLevels.
+ */
+class LevelCache {
+ public:
+  LevelCache(qint64 memoryBudget = DEFAULT_LEVEL_CACHE_BUDGET);
+
+  void setBaseMesh(Mesh baseMesh);
+  void replaceLevels(const QVector<MeshHandle>& meshes);
+  void clear();
+  bool isEmpty() const;
+
+  void setMemoryBudget(qint64 memoryBudget);
+  qint64 memoryBudget() const;
+  qint64 memoryUsage() const;
+
+  qint64 predictFootprint(int level) const;
+  qint64 requiredMemory(int level) const;
+  bool fitsBudget(int level) const;
+  bool isCached(int level) const;
+
+  MeshHandle level(int level);
+
+ private:
+  LoopSubdivider::ElementCounts predictCounts(int level) const;
+  MeshHandle createSnapshot(Mesh mesh) const;
+  void store(int level, const MeshHandle& mesh);
+  void evict(qint64 requiredBytes, int sourceLevel);
+
+  QVector<MeshHandle> levels;
+  QVector<quint64> lastUsed;
+  quint64 useCounter;
+  qint64 budget;
+  LoopSubdivider subdivider;
+};
+
+#endif  // LEVEL_CACHE_H
@@ -0,0 +1,735 @@
+#include "limitevaluator.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "loopstencils.h"
+#include "util/parallel.h"
+
+// Number of local subdivision steps after which points next to an
+// extraordinary or boundary vertex are interpolated from the corner limits.
+#define LIMIT_MAX_DEPTH 20
+
+// Batches with fewer samples than this are always evaluated serially; the
+// cost of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_SAMPLES 4096
+
+// Patches are subdivided in double precision: the derivatives are computed
+// from differences of points that lie very close together.
+using LimitCoords = std::array<double, 3>;
+
+/**
+ * @brief The LimitPatch struct holds a triangle together with every triangle
+ * that shares a vertex with it, using a vertex numbering of its own. The
+ * one-rings of the corners of the centre triangle are complete, which is all
+ * that is needed to subdivide the centre triangle and its surroundings once.
+ */
+struct LimitPatch {
+  std::vector<LimitCoords> points;
+  // Oriented triangles; the first one is the centre triangle.
+  std::vector<std::array<int, 3>> faces;
+};
+
+/**
+ * @brief The LimitRing struct describes the one-ring of a patch vertex.
+ */
+struct LimitRing {
+  int valence;
+  bool boundary;
+  std::vector<int> neighbours;
+  // Number of triangles containing the edge to each neighbour.
+  std::vector<int> edgeFaces;
+  // The two neighbours along the boundary, if any.
+  int boundaryNeighbours[2];
+};
+
+/**
+ * @brief The LimitWorkspace struct holds the scratch space of an evaluation,
+ * so that it can be reused for the next one.
+ */
+struct LimitWorkspace {
+  LimitRing ring;
+  LimitPatch current;
+  LimitPatch next;
+};
+
+// Exponents (a, b, c) of the monomials u^a v^b w^c of degree four, where u, v
+// and w are the barycentric coordinates of a point in a regular patch.
+static const int BOX_SPLINE_EXPONENTS[15][3] = {
+    {4, 0, 0}, {3, 1, 0}, {3, 0, 1}, {2, 2, 0}, {2, 1, 1},
+    {2, 0, 2}, {1, 3, 0}, {1, 2, 1}, {1, 1, 2}, {1, 0, 3},
+    {0, 4, 0}, {0, 3, 1}, {0, 2, 2}, {0, 1, 3}, {0, 0, 4}};
+
+// Twelve times the coefficients of the box-spline basis functions over those
+// monomials, one row per control vertex in Stam's numbering. The corners of
+// the patch are control vertices 4 (u), 7 (v) and 8 (w).
+static const int BOX_SPLINE_COEFFICIENTS[12][15] = {
+    {1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 6, 2, 12, 6, 0, 6, 6, 0, 0, 1, 2, 0, 0, 0},
+    {6, 24, 24, 24, 60, 24, 8, 36, 36, 8, 1, 6, 12, 6, 1},
+    {1, 2, 6, 0, 6, 12, 0, 0, 6, 6, 0, 0, 0, 2, 1},
+    {0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0},
+    {1, 8, 6, 24, 36, 12, 24, 60, 36, 6, 6, 24, 24, 8, 1},
+    {1, 6, 8, 12, 36, 24, 6, 36, 60, 24, 1, 8, 24, 24, 6},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 0, 0, 0},
+    {0, 0, 0, 0, 0, 0, 2, 6, 6, 2, 1, 6, 12, 6, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1}};
+
+/**
+ * @brief addScaled Adds a multiple of one point to another.
+ * @param sum The point to add to.
+ * @param weight The multiple.
+ * @param coords The point to add.
+ */
+static inline void addScaled(LimitCoords& sum, double weight,
+                             const LimitCoords& coords) {
+  for (int axis = 0; axis < 3; ++axis) {
+    sum[axis] += weight * coords[axis];
+  }
+}
+
+/**
+ * @brief patchFromMesh Creates the patch around a triangle of a mesh.
+ * @param mesh The triangle mesh.
+ * @param f Index of the centre triangle.
+ * @param patch Where to store the patch.
+ */
+static void patchFromMesh(const Mesh& mesh, int f, LimitPatch& patch) {
+  std::vector<int> faces = {f};
+  for (int i = 0; i < 3; ++i) {
+    for (int h : mesh.outgoingHalfEdges(mesh.origin(3 * f + i))) {
+      int g = mesh.face(h);
+      if (std::find(faces.begin(), faces.end(), g) == faces.end()) {
+        faces.push_back(g);
+      }
+    }
+  }
+
+  // Global index of every patch vertex.
+  std::vector<int> vertices;
+  patch.points.clear();
+  patch.faces.clear();
+  for (int g : faces) {
+    std::array<int, 3> face;
+    for (int i = 0; i < 3; ++i) {
+      int v = mesh.origin(3 * g + i);
+      auto it = std::find(vertices.begin(), vertices.end(), v);
+      face[i] = it - vertices.begin();
+      if (it == vertices.end()) {
+        vertices.push_back(v);
+        QVector3D coords = mesh.coords(v);
+        patch.points.push_back({coords.x(), coords.y(), coords.z()});
+      }
+    }
+    patch.faces.push_back(face);
+  }
+}
+
+/**
+ * @brief thirdVertex Finds the triangle containing the directed edge from a to
+ * b.
+ * @param patch The patch.
+ * @param a Index of the first vertex of the edge.
+ * @param b Index of the second vertex of the edge.
+ * @return Index of the third vertex of that triangle. -1 if there is none.
+ */
+static int thirdVertex(const LimitPatch& patch, int a, int b) {
+  for (const std::array<int, 3>& face : patch.faces) {
+    for (int i = 0; i < 3; ++i) {
+      if (face[i] == a && face[(i + 1) % 3] == b) {
+        return face[(i + 2) % 3];
+      }
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief oneRing Gathers the one-ring of a patch vertex. All triangles around
+ * the vertex have to be part of the patch.
+ * @param patch The patch.
+ * @param v Index of the vertex.
+ * @param ring Where to store the one-ring.
+ */
+static void oneRing(const LimitPatch& patch, int v, LimitRing& ring) {
+  ring.valence = 0;
+  ring.boundary = false;
+  ring.neighbours.clear();
+  ring.edgeFaces.clear();
+  auto addNeighbour = [&](int n) {
+    auto it = std::find(ring.neighbours.begin(), ring.neighbours.end(), n);
+    if (it == ring.neighbours.end()) {
+      ring.neighbours.push_back(n);
+      ring.edgeFaces.push_back(1);
+    } else {
+      ring.edgeFaces[it - ring.neighbours.begin()]++;
+    }
+  };
+  for (const std::array<int, 3>& face : patch.faces) {
+    for (int i = 0; i < 3; ++i) {
+      if (face[i] == v) {
+        ring.valence++;
+        addNeighbour(face[(i + 1) % 3]);
+        addNeighbour(face[(i + 2) % 3]);
+      }
+    }
+  }
+  int numBoundary = 0;
+  for (int k = 0; k < int(ring.neighbours.size()); ++k) {
+    if (ring.edgeFaces[k] == 1 && numBoundary < 2) {
+      ring.boundaryNeighbours[numBoundary++] = ring.neighbours[k];
+    }
+  }
+  ring.boundary = numBoundary == 2;
+}
+
+/**
+ * @brief vertexPoint Calculates the vertex point of a patch vertex.
+ * @param patch The patch.
+ * @param v Index of the vertex.
+ * @param ring Scratch space for the one-ring of the vertex.
+ * @return The coordinates of the vertex point.
+ */
+static LimitCoords vertexPoint(const LimitPatch& patch, int v,
+                               LimitRing& ring) {
+  oneRing(patch, v, ring);
+  LimitCoords result = {0.0, 0.0, 0.0};
+  if (ring.boundary) {
+    addScaled(result, 3.0 / 4.0, patch.points[v]);
+    addScaled(result, 1.0 / 8.0, patch.points[ring.boundaryNeighbours[0]]);
+    addScaled(result, 1.0 / 8.0, patch.points[ring.boundaryNeighbours[1]]);
+    return result;
+  }
+  int valence = ring.valence;
+  double alpha, beta;
+  if (valence <= LOOP_MAX_TABLE_VALENCE) {
+    alpha = LOOP_ALPHA[valence];
+    beta = LOOP_BETA[valence];
+  } else {
+    beta = loopBeta(valence);
+    alpha = 1.0 - valence * beta;
+  }
+  addScaled(result, alpha, patch.points[v]);
+  for (int n : ring.neighbours) {
+    addScaled(result, beta, patch.points[n]);
+  }
+  return result;
+}
+
+/**
+ * @brief edgePoint Calculates the edge point of a patch edge.
+ * @param patch The patch.
+ * @param a Index of one vertex of the edge.
+ * @param b Index of the other vertex of the edge.
+ * @return The coordinates of the edge point.
+ */
+static LimitCoords edgePoint(const LimitPatch& patch, int a, int b) {
+  int left = thirdVertex(patch, a, b);
+  int right = thirdVertex(patch, b, a);
+  LimitCoords result = {0.0, 0.0, 0.0};
+  if (left < 0 || right < 0) {
+    addScaled(result, 1.0 / 2.0, patch.points[a]);
+    addScaled(result, 1.0 / 2.0, patch.points[b]);
+    return result;
+  }
+  addScaled(result, 3.0 / 8.0, patch.points[a]);
+  addScaled(result, 3.0 / 8.0, patch.points[b]);
+  addScaled(result, 1.0 / 8.0, patch.points[left]);
+  addScaled(result, 1.0 / 8.0, patch.points[right]);
+  return result;
+}
+
+/**
+ * @brief limitPosition Calculates the limit position of a patch vertex. See
+ * LimitProjector::limitPosition.
+ * @param patch The patch.
+ * @param v Index of the vertex.
+ * @param ring Scratch space for the one-ring of the vertex.
+ * @return The limit position.
+ */
+static LimitCoords limitPosition(const LimitPatch& patch, int v,
+                                 LimitRing& ring) {
+  oneRing(patch, v, ring);
+  LimitCoords result = {0.0, 0.0, 0.0};
+  if (ring.boundary) {
+    addScaled(result, 2.0 / 3.0, patch.points[v]);
+    addScaled(result, 1.0 / 6.0, patch.points[ring.boundaryNeighbours[0]]);
+    addScaled(result, 1.0 / 6.0, patch.points[ring.boundaryNeighbours[1]]);
+    return result;
+  }
+  int valence = ring.valence;
+  double beta = valence <= LOOP_MAX_TABLE_VALENCE ? LOOP_BETA[valence]
+                                                  : loopBeta(valence);
+  double chi = 1.0 / (3.0 / (8.0 * beta) + valence);
+  addScaled(result, 1.0 - valence * chi, patch.points[v]);
+  for (int n : ring.neighbours) {
+    addScaled(result, chi, patch.points[n]);
+  }
+  return result;
+}
+
+/**
+ * @brief subdividePatch Subdivides a patch once and extracts the patch around
+ * one of the four sub-triangles of its centre triangle. Only the points the
+ * new patch consists of are computed.
+ * @param patch The patch.
+ * @param child The sub-triangle: 0, 1 or 2 for the one at the corresponding
+ * corner of the centre triangle; 3 for the middle one.
+ * @param result Where to store the new patch.
+ * @param ring Scratch space for one-rings.
+ */
+static void subdividePatch(const LimitPatch& patch, int child,
+                           LimitPatch& result, LimitRing& ring) {
+  // A new point is identified by (v, -1) for the vertex point of v and by
+  // (a, b) with a < b for the edge point of edge ab.
+  using Key = std::pair<int, int>;
+  auto vertexKey = [](int v) { return Key(v, -1); };
+  auto edgeKey = [](int a, int b) {
+    return Key(std::min(a, b), std::max(a, b));
+  };
+  const std::array<int, 3>& centre = patch.faces[0];
+  auto isCorner = [&](int v) {
+    return v == centre[0] || v == centre[1] || v == centre[2];
+  };
+
+  // The sub-triangles whose points can be computed: those at the corners of
+  // the centre triangle, and the middle ones of triangles sharing an edge with
+  // it. These include all sub-triangles around the chosen one.
+  std::vector<std::array<Key, 3>> children;
+  for (const std::array<int, 3>& face : patch.faces) {
+    int corners = 0;
+    for (int i = 0; i < 3; ++i) {
+      int a = face[i];
+      if (isCorner(a)) {
+        children.push_back({vertexKey(a), edgeKey(a, face[(i + 1) % 3]),
+                            edgeKey(face[(i + 2) % 3], a)});
+        corners++;
+      }
+    }
+    if (corners >= 2) {
+      children.push_back({edgeKey(face[2], face[0]), edgeKey(face[0], face[1]),
+                          edgeKey(face[1], face[2])});
+    }
+  }
+  std::array<Key, 3> target;
+  if (child < 3) {
+    int a = centre[child];
+    target = {vertexKey(a), edgeKey(a, centre[(child + 1) % 3]),
+              edgeKey(centre[(child + 2) % 3], a)};
+  } else {
+    target = {edgeKey(centre[2], centre[0]), edgeKey(centre[0], centre[1]),
+              edgeKey(centre[1], centre[2])};
+  }
+
+  std::vector<Key> keys;
+  result.points.clear();
+  result.faces.clear();
+  auto pointIndex = [&](const Key& key) {
+    auto it = std::find(keys.begin(), keys.end(), key);
+    if (it != keys.end()) {
+      return int(it - keys.begin());
+    }
+    keys.push_back(key);
+    result.points.push_back(key.second < 0
+                                ? vertexPoint(patch, key.first, ring)
+                                : edgePoint(patch, key.first, key.second));
+    return int(keys.size()) - 1;
+  };
+  auto addFace = [&](const std::array<Key, 3>& face) {
+    result.faces.push_back(
+        {pointIndex(face[0]), pointIndex(face[1]), pointIndex(face[2])});
+  };
+
+  addFace(target);
+  for (const std::array<Key, 3>& face : children) {
+    if (face == target) {
+      continue;
+    }
+    bool touches = false;
+    for (const Key& key : face) {
+      touches |= key == target[0] || key == target[1] || key == target[2];
+    }
+    if (touches) {
+      addFace(face);
+    }
+  }
+}
+
+/**
+ * @brief isRegularPatch Checks whether the centre triangle of a patch is a
+ * regular patch: all its corners are interior vertices of valence 6.
+ * @param patch The patch.
+ * @param ring Scratch space for one-rings.
+ * @return True if the centre triangle is regular; false otherwise.
+ */
+static bool isRegularPatch(const LimitPatch& patch, LimitRing& ring) {
+  for (int v : patch.faces[0]) {
+    oneRing(patch, v, ring);
+    if (ring.boundary || ring.valence != 6) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief gatherRegularPatch Gathers the twelve control points of a regular
+ * patch in Stam's numbering:
+ *
+ *       1   2
+ *     3   4   5
+ *   6   7   8   9
+ *    10  11  12
+ *
+ * where 4, 7 and 8 are the corners of the centre triangle.
+ * @param patch The patch. Its centre triangle has to be regular.
+ * @param points Where to store the control points.
+ */
+static void gatherRegularPatch(const LimitPatch& patch,
+                               LimitCoords points[12]) {
+  const std::array<int, 3>& centre = patch.faces[0];
+  int v4 = centre[0];
+  int v7 = centre[1];
+  int v8 = centre[2];
+  int v3 = thirdVertex(patch, v7, v4);
+  int v1 = thirdVertex(patch, v3, v4);
+  int v2 = thirdVertex(patch, v1, v4);
+  int v5 = thirdVertex(patch, v4, v8);
+  int v6 = thirdVertex(patch, v7, v3);
+  int v10 = thirdVertex(patch, v7, v6);
+  int v11 = thirdVertex(patch, v8, v7);
+  int v12 = thirdVertex(patch, v8, v11);
+  int v9 = thirdVertex(patch, v8, v12);
+  const int indices[12] = {v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12};
+  for (int i = 0; i < 12; ++i) {
+    points[i] = patch.points[indices[i]];
+  }
+}
+
+/**
+ * @brief evaluateBoxSpline Evaluates a regular patch.
+ * @param points The control points of the patch.
+ * @param s Parameter of the second corner.
+ * @param t Parameter of the third corner.
+ * @param result Where to store the position and its derivatives with respect
+ * to s and t.
+ */
+static void evaluateBoxSpline(const LimitCoords points[12], double s, double t,
+                              LimitCoords result[3]) {
+  const double bary[3] = {1.0 - s - t, s, t};
+  double powers[3][5];
+  for (int k = 0; k < 3; ++k) {
+    powers[k][0] = 1.0;
+    for (int e = 1; e <= 4; ++e) {
+      powers[k][e] = powers[k][e - 1] * bary[k];
+    }
+  }
+  // Every monomial and its partial derivatives with respect to u, v and w.
+  double monomials[15][4];
+  for (int m = 0; m < 15; ++m) {
+    const int* e = BOX_SPLINE_EXPONENTS[m];
+    monomials[m][0] = powers[0][e[0]] * powers[1][e[1]] * powers[2][e[2]];
+    for (int k = 0; k < 3; ++k) {
+      double derivative = e[k];
+      for (int j = 0; j < 3 && derivative != 0.0; ++j) {
+        derivative *= powers[j][j == k ? e[j] - 1 : e[j]];
+      }
+      monomials[m][k + 1] = derivative;
+    }
+  }
+
+  for (int k = 0; k < 3; ++k) {
+    result[k] = {0.0, 0.0, 0.0};
+  }
+  for (int i = 0; i < 12; ++i) {
+    double weight[4] = {0.0, 0.0, 0.0, 0.0};
+    for (int m = 0; m < 15; ++m) {
+      int coefficient = BOX_SPLINE_COEFFICIENTS[i][m];
+      for (int k = 0; k < 4; ++k) {
+        weight[k] += coefficient * monomials[m][k];
+      }
+    }
+    // Moving along s or t trades weight of the first corner for weight of the
+    // second or third one.
+    addScaled(result[0], weight[0] / 12.0, points[i]);
+    addScaled(result[1], (weight[2] - weight[1]) / 12.0, points[i]);
+    addScaled(result[2], (weight[3] - weight[1]) / 12.0, points[i]);
+  }
+}
+
+/**
+ * @brief interpolateCorners Approximates the limit surface over the centre
+ * triangle of a patch by the linear interpolation of its corner limits.
+ * @param patch The patch.
+ * @param s Parameter of the second corner.
+ * @param t Parameter of the third corner.
+ * @param result Where to store the position and its derivatives with respect
+ * to s and t.
+ * @param ring Scratch space for one-rings.
+ */
+static void interpolateCorners(const LimitPatch& patch, double s, double t,
+                               LimitCoords result[3], LimitRing& ring) {
+  LimitCoords corners[3];
+  for (int i = 0; i < 3; ++i) {
+    corners[i] = limitPosition(patch, patch.faces[0][i], ring);
+  }
+  result[0] = {0.0, 0.0, 0.0};
+  addScaled(result[0], 1.0 - s - t, corners[0]);
+  addScaled(result[0], s, corners[1]);
+  addScaled(result[0], t, corners[2]);
+  for (int k = 1; k < 3; ++k) {
+    result[k] = corners[k];
+    addScaled(result[k], -1.0, corners[0]);
+  }
+}
+
+/**
+ * @brief selectChild Determines the sub-triangle of the centre triangle that
+ * contains a point and maps the parameters of the point to that sub-triangle.
+ * The sub-triangles are oriented like the ones created by LoopSubdivider: the
+ * one at corner i starts at that corner, the middle one starts at the edge
+ * point of the edge before the first corner.
+ * @param s Parameter of the second corner; replaced by that of the child.
+ * @param t Parameter of the third corner; replaced by that of the child.
+ * @param step Where to store the derivatives of the new parameters with
+ * respect to the old ones.
+ * @return The sub-triangle. See subdividePatch.
+ */
+static int selectChild(double& s, double& t, double step[2][2]) {
+  double oldS = s;
+  double oldT = t;
+  int child;
+  if (oldS + oldT <= 0.5) {
+    child = 0;
+    s = 2.0 * oldS;
+    t = 2.0 * oldT;
+    step[0][0] = 2.0, step[0][1] = 0.0, step[1][0] = 0.0, step[1][1] = 2.0;
+  } else if (oldS >= 0.5) {
+    child = 1;
+    s = 2.0 * oldT;
+    t = 2.0 - 2.0 * oldS - 2.0 * oldT;
+    step[0][0] = 0.0, step[0][1] = 2.0, step[1][0] = -2.0, step[1][1] = -2.0;
+  } else if (oldT >= 0.5) {
+    child = 2;
+    s = 2.0 - 2.0 * oldS - 2.0 * oldT;
+    t = 2.0 * oldS;
+    step[0][0] = -2.0, step[0][1] = -2.0, step[1][0] = 2.0, step[1][1] = 0.0;
+  } else {
+    child = 3;
+    s = 1.0 - 2.0 * oldT;
+    t = 2.0 * oldS + 2.0 * oldT - 1.0;
+    step[0][0] = 0.0, step[0][1] = -2.0, step[1][0] = 2.0, step[1][1] = 2.0;
+  }
+  // Guard against rounding pushing the point out of the sub-triangle.
+  s = std::max(s, 0.0);
+  t = std::max(t, 0.0);
+  return child;
+}
+
+/**
+ * @brief toLimitPoint Converts a position and its derivatives within a
+ * sub-triangle to a limit point.
+ * @param result The position and its derivatives with respect to the
+ * parameters of the sub-triangle.
+ * @param jacobian The derivatives of the parameters of the sub-triangle with
+ * respect to those of the triangle the point was requested on.
+ * @return The limit point.
+ */
+static LimitPoint toLimitPoint(const LimitCoords result[3],
+                               const double jacobian[2][2]) {
+  LimitCoords du = {0.0, 0.0, 0.0};
+  LimitCoords dv = {0.0, 0.0, 0.0};
+  addScaled(du, jacobian[0][0], result[1]);
+  addScaled(du, jacobian[1][0], result[2]);
+  addScaled(dv, jacobian[0][1], result[1]);
+  addScaled(dv, jacobian[1][1], result[2]);
+  LimitPoint point;
+  point.position = QVector3D(result[0][0], result[0][1], result[0][2]);
+  point.du = QVector3D(du[0], du[1], du[2]);
+  point.dv = QVector3D(dv[0], dv[1], dv[2]);
+  return point;
+}
+
+/**
+ * @brief evaluatePatch Evaluates the limit surface over the centre triangle of
+ * a patch.
+ * @param patch The patch.
+ * @param s Parameter of the second corner.
+ * @param t Parameter of the third corner.
+ * @param workspace Scratch space.
+ * @return The point on the limit surface.
+ */
+static LimitPoint evaluatePatch(const LimitPatch& patch, double s, double t,
+                                LimitWorkspace& workspace) {
+  const LimitPatch* current = &patch;
+  // Derivatives of the parameters within the current sub-triangle with
+  // respect to the parameters of the patch.
+  double jacobian[2][2] = {{1.0, 0.0}, {0.0, 1.0}};
+  LimitCoords result[3];
+  for (int depth = 0;; ++depth) {
+    if (isRegularPatch(*current, workspace.ring)) {
+      LimitCoords points[12];
+      gatherRegularPatch(*current, points);
+      evaluateBoxSpline(points, s, t, result);
+      break;
+    }
+    if (depth == LIMIT_MAX_DEPTH) {
+      interpolateCorners(*current, s, t, result, workspace.ring);
+      break;
+    }
+    double step[2][2];
+    int child = selectChild(s, t, step);
+    subdividePatch(*current, child, workspace.next, workspace.ring);
+    std::swap(workspace.current, workspace.next);
+    current = &workspace.current;
+    double product[2][2];
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        product[i][j] =
+            step[i][0] * jacobian[0][j] + step[i][1] * jacobian[1][j];
+      }
+    }
+    std::copy(&product[0][0], &product[0][0] + 4, &jacobian[0][0]);
+  }
+  return toLimitPoint(result, jacobian);
+}
+
+/**
+ * @brief clampParameters Moves parameters outside of a triangle to the
+ * nearest point of the triangle along the line through its first corner.
+ * @param u Parameter of the second corner.
+ * @param v Parameter of the third corner.
+ * @param s Where to store the clamped parameter of the second corner.
+ * @param t Where to store the clamped parameter of the third corner.
+ */
+static void clampParameters(float u, float v, double& s, double& t) {
+  s = std::max(double(u), 0.0);
+  t = std::max(double(v), 0.0);
+  if (s + t > 1.0) {
+    double sum = s + t;
+    s /= sum;
+    t /= sum;
+  }
+}
+
+/**
+ * @brief LimitEvaluator::LimitEvaluator Creates a new limit evaluator. By
+ * default, large batches are evaluated using all cores.
+ */
+LimitEvaluator::LimitEvaluator() : numThreads(0) {}
+
+/**
+ * @brief LimitEvaluator::setNumThreads Sets the number of threads used to
+ * evaluate batches of samples.
+ * @param numThreads The number of threads. 1 forces serial evaluation; values
+ * smaller than 1 use all cores.
+ */
+void LimitEvaluator::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief LimitEvaluator::isValidSample Checks whether a sample can be
+ * evaluated on a mesh.
+ * @param mesh The mesh.
+ * @param face Index of the triangle of the sample.
+ * @return True if the mesh is a triangle mesh containing the triangle; false
+ * otherwise.
+ */
+bool LimitEvaluator::isValidSample(const Mesh& mesh, int face) const {
+  return mesh.isTriangleMesh() && face >= 0 && face < mesh.numFaces();
+}
+
+/**
+ * @brief LimitEvaluator::evaluate Evaluates the limit surface at a single
+ * point. Parameters outside of the triangle are clamped to it.
+ * @param mesh The triangle mesh.
+ * @param face Index of the triangle.
+ * @param u Parameter of the second corner of the triangle.
+ * @param v Parameter of the third corner of the triangle.
+ * @param point Where to store the point on the limit surface.
+ * @return True if the point was evaluated; false if the mesh is not a triangle
+ * mesh or does not contain the triangle.
+ */
+bool LimitEvaluator::evaluate(const Mesh& mesh, int face, float u, float v,
+                              LimitPoint& point) const {
+  if (!isValidSample(mesh, face)) {
+    qDebug() << ":: Cannot evaluate the limit surface on face" << face;
+    return false;
+  }
+  LimitPatch patch;
+  LimitWorkspace workspace;
+  patchFromMesh(mesh, face, patch);
+  double s, t;
+  clampParameters(u, v, s, t);
+  point = evaluatePatch(patch, s, t, workspace);
+  return true;
+}
+
+/**
+ * @brief LimitEvaluator::evaluate Evaluates the limit surface at a batch of
+ * points. Consecutive samples on the same triangle share the work of
+ * gathering its patch (and, for regular patches, its control points), so it
+ * pays off to sort the samples by triangle.
+ * @param mesh The triangle mesh.
+ * @param samples The points to evaluate.
+ * @param points Where to store the points on the limit surface, in the order
+ * of the samples. Invalid samples result in a zero point.
+ * @return True if all samples were evaluated; false otherwise.
+ */
+bool LimitEvaluator::evaluate(const Mesh& mesh,
+                              const QVector<LimitSample>& samples,
+                              QVector<LimitPoint>& points) const {
+  int numSamples = samples.size();
+  points.resize(numSamples);
+  const LimitSample* sampleData = samples.constData();
+  LimitPoint* pointData = points.data();
+  int threads = numSamples >= MIN_PARALLEL_SAMPLES
+                    ? resolveThreadCount(numThreads)
+                    : 1;
+  std::vector<char> valid(threads, 1);
+  parallelFor(0, numSamples, threads, [&](int begin, int end, int threadIdx) {
+    const double identity[2][2] = {{1.0, 0.0}, {0.0, 1.0}};
+    LimitWorkspace workspace;
+    LimitPatch patch;
+    int patchFace = -1;
+    bool regular = false;
+    LimitCoords controlPoints[12];
+    for (int i = begin; i < end; ++i) {
+      const LimitSample& sample = sampleData[i];
+      if (!isValidSample(mesh, sample.face)) {
+        pointData[i] = LimitPoint();
+        valid[threadIdx] = 0;
+        continue;
+      }
+      if (sample.face != patchFace) {
+        patchFromMesh(mesh, sample.face, patch);
+        patchFace = sample.face;
+        regular = isRegularPatch(patch, workspace.ring);
+        if (regular) {
+          gatherRegularPatch(patch, controlPoints);
+        }
+      }
+      double s, t;
+      clampParameters(sample.u, sample.v, s, t);
+      if (regular) {
+        LimitCoords result[3];
+        evaluateBoxSpline(controlPoints, s, t, result);
+        pointData[i] = toLimitPoint(result, identity);
+      } else {
+        pointData[i] = evaluatePatch(patch, s, t, workspace);
+      }
+    }
+  });
+  bool allValid = std::all_of(valid.begin(), valid.end(),
+                              [](char flag) { return flag != 0; });
+  if (!allValid) {
+    qDebug() << ":: Some limit surface samples lie on invalid faces";
+  }
+  return allValid;
+}
@@ -0,0 +1,61 @@
+#ifndef LIMIT_EVALUATOR_H
+#define LIMIT_EVALUATOR_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The LimitSample struct identifies a point on a triangle of a mesh by
+ * the index of the triangle and two parameters: the point lies at
+ * (1 - u - v) * p0 + u * p1 + v * p2, where p0, p1 and p2 are the origins of
+ * the half-edges 3 * face, 3 * face + 1 and 3 * face + 2.
+ */
+struct LimitSample {
+  int face;
+  float u;
+  float v;
+};
+
+/**
+ * @brief The LimitPoint struct holds a point of the limit surface and the
+ * partial derivatives of the surface with respect to the parameters u and v.
+ */
+struct LimitPoint {
+  QVector3D position;
+  QVector3D du;
+  QVector3D dv;
+};
+
+/**
+ * @brief The LimitEvaluator class evaluates the Loop limit surface of a
+ * triangle mesh at arbitrary parameters, without subdividing the mesh.
+ *
+ * Triangles whose corners are interior vertices of valence 6 form a regular
+ * patch: the limit surface over them is a quartic box spline of the twelve
+ * surrounding vertices, which is evaluated directly (Stam, "Evaluation of
+ * Loop subdivision surfaces", 1998). Other triangles are subdivided locally,
+ * one level at a time, descending into the sub-triangle that contains the
+ * parameter until that sub-triangle is regular. Points that are still next to
+ * an extraordinary or boundary vertex after the maximum depth are interpolated
+ * from the limit positions of the sub-triangle corners; the sub-triangle is
+ * then so small that this is exact up to rounding.
+ */
+class LimitEvaluator {
+ public:
+  LimitEvaluator();
+  void setNumThreads(int numThreads);
+
+  bool evaluate(const Mesh& mesh, int face, float u, float v,
+                LimitPoint& point) const;
+  bool evaluate(const Mesh& mesh, const QVector<LimitSample>& samples,
+                QVector<LimitPoint>& points) const;
+
+ private:
+  bool isValidSample(const Mesh& mesh, int face) const;
+
+  int numThreads;
+};
+
+#endif  // LIMIT_EVALUATOR_H
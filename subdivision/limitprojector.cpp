@@ -0,0 +1,184 @@
+#include "limitprojector.h"
+
+#include <cmath>
+
+#include "loopstencils.h"
+#include "util/parallel.h"
+
+// Meshes with fewer vertices than this are always projected serially; the
+// cost of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_VERTICES 16384
+
+/**
+ * @brief LimitProjector::LimitProjector Creates a new limit projector. By
+ * default, large meshes are projected using all cores.
+ */
+LimitProjector::LimitProjector() : numThreads(0) {}
+
+/**
+ * @brief LimitProjector::setNumThreads Sets the number of threads used to
+ * project a mesh.
+ * @param numThreads The number of threads. 1 forces serial projection; values
+ * smaller than 1 use all cores.
+ */
+void LimitProjector::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief LimitProjector::project Projects all vertices of a mesh onto the
+ * limit surface. The topology is left untouched.
+ * @param mesh The mesh to project.
+ * @return A copy of the mesh with the vertices at their limit positions. Its
+ * attributes are extracted, with the vertex normals set to the limit normals.
+ */
+Mesh LimitProjector::project(const Mesh& mesh) const {
+  int numVerts = mesh.numVerts();
+  QVector<QVector3D> positions(numVerts);
+  QVector<QVector3D> normals(numVerts);
+  QVector3D* positionData = positions.data();
+  QVector3D* normalData = normals.data();
+  int threads =
+      numVerts >= MIN_PARALLEL_VERTICES ? resolveThreadCount(numThreads) : 1;
+  parallelFor(0, numVerts, threads, [&](int begin, int end, int) {
+    for (int v = begin; v < end; ++v) {
+      positionData[v] = limitPosition(mesh, v);
+      normalData[v] = limitNormal(mesh, v);
+    }
+  });
+
+  Mesh projected = mesh;
+  for (int v = 0; v < numVerts; ++v) {
+    projected.setCoords(v, positions[v]);
+  }
+  projected.extractAttributes();
+  projected.getVertexNorms() = normals;
+  return projected;
+}
+
+/**
+ * @brief LimitProjector::firstOutgoingHalfEdge Finds the half-edge to start
+ * walking the one-ring of a vertex from. For boundary vertices, this is the
+ * outgoing half-edge that follows the incoming boundary half-edge, so that
+ * rotating from h to next(twin(h)) visits the neighbours from one boundary
+ * neighbour to the other.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return Index of the half-edge. -1 if the vertex is isolated.
+ */
+int LimitProjector::firstOutgoingHalfEdge(const Mesh& mesh, int v) const {
+  if (mesh.out(v) < 0) {
+    return -1;
+  }
+  int h = mesh.prevBoundaryHalfEdge(v);
+  return h < 0 ? mesh.out(v) : mesh.next(h);
+}
+
+/**
+ * @brief LimitProjector::limitPosition Calculates the position a vertex
+ * converges to under repeated Loop subdivision.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return The limit position of the vertex.
+ */
+QVector3D LimitProjector::limitPosition(const Mesh& mesh, int v) const {
+  int start = firstOutgoingHalfEdge(mesh, v);
+  if (start < 0) {
+    return mesh.coords(v);
+  }
+  QVector3D coords = mesh.coords(v);
+  // Boundary vertex: limit of the cubic B-spline boundary curve.
+  if (mesh.isBoundaryEdge(mesh.prev(start))) {
+    QVector3D first = mesh.coords(mesh.origin(mesh.prev(start)));
+    QVector3D last =
+        mesh.coords(mesh.origin(mesh.next(mesh.nextBoundaryHalfEdge(v))));
+    return (first + last) / 6.0f + coords * (2.0f / 3.0f);
+  }
+  // Inner vertex
+  int valence = 0;
+  QVector3D sum = {0.0f, 0.0f, 0.0f};
+  for (int h : mesh.outgoingHalfEdgesFrom(start)) {
+    sum += mesh.coords(mesh.origin(mesh.next(h)));
+    valence++;
+  }
+  double beta = valence <= LOOP_MAX_TABLE_VALENCE ? LOOP_BETA[valence]
+                                                  : loopBeta(valence);
+  double chi = 1.0 / (3.0 / (8.0 * beta) + valence);
+  return coords * float(1.0 - valence * chi) + sum * float(chi);
+}
+
+/**
+ * @brief LimitProjector::limitNormal Calculates the normal of the limit
+ * surface at the limit position of a vertex, as the cross product of the two
+ * limit tangents. The normal is oriented like the faces around the vertex.
+ * Degenerate one-rings fall back to the normal of one of those faces.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return The unit limit normal. Zero for isolated vertices.
+ */
+QVector3D LimitProjector::limitNormal(const Mesh& mesh, int v) const {
+  int start = firstOutgoingHalfEdge(mesh, v);
+  if (start < 0) {
+    return QVector3D();
+  }
+  QVector3D coords = mesh.coords(v);
+  QVector3D tangentA;
+  QVector3D tangentB;
+  if (mesh.isBoundaryEdge(mesh.prev(start))) {
+    // Neighbours r0, ..., rk, from one boundary neighbour to the other, where
+    // k is the number of faces around the vertex.
+    int k = 0;
+    QVector3D last;
+    for (int h : mesh.outgoingHalfEdgesFrom(start)) {
+      last = mesh.coords(mesh.origin(mesh.next(h)));
+      k++;
+    }
+    QVector3D first = mesh.coords(mesh.origin(mesh.prev(start)));
+    tangentA = first - last;
+    if (k == 1) {
+      tangentB = first + last - 2.0f * coords;
+    } else {
+      // Left eigenvector of the local subdivision matrix for the eigenvalue
+      // 3/8 + cos(pi / k) / 4: sin(i * pi / k) for the inner neighbours, and a
+      // and b for the vertex itself and the two boundary neighbours.
+      double theta = M_PI / k;
+      double lambda = 0.375 + 0.25 * cos(theta);
+      double sum = 0.0;
+      int i = 1;
+      for (int h : mesh.outgoingHalfEdgesFrom(start)) {
+        if (i == k) {
+          break;
+        }
+        float weight = float(sin(i * theta));
+        tangentB += weight * mesh.coords(mesh.origin(mesh.next(h)));
+        sum += weight;
+        i++;
+      }
+      double inner = sin(theta);
+      double det = (lambda - 0.5) * (lambda - 0.75) - 0.125;
+      double a = ((lambda - 0.5) * 0.375 * sum + 0.125 * inner) / det;
+      double b = (0.125 * inner * (lambda - 0.75) + 0.046875 * sum) / det;
+      tangentB += float(a) * coords + float(b) * (first + last);
+    }
+  } else {
+    int valence = mesh.valence(v);
+    int i = 0;
+    for (int h : mesh.outgoingHalfEdgesFrom(start)) {
+      double angle = 2.0 * M_PI * i / valence;
+      QVector3D neighbour = mesh.coords(mesh.origin(mesh.next(h)));
+      tangentA += float(cos(angle)) * neighbour;
+      tangentB += float(sin(angle)) * neighbour;
+      i++;
+    }
+  }
+
+  // The one-ring is walked against the orientation of the faces, hence the
+  // order of the tangents.
+  QVector3D normal = QVector3D::crossProduct(tangentB, tangentA);
+  float length = normal.length();
+  if (length == 0.0f) {
+    return mesh.computeFaceNormal(mesh.face(start));
+  }
+  // don't use normalized, since this presents issues with small numbers
+  return normal / length;
+}
@@ -0,0 +1,36 @@
+#ifndef LIMIT_PROJECTOR_H
+#define LIMIT_PROJECTOR_H
+
+#include <QVector3D>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The LimitProjector class moves the vertices of a mesh to their
+ * positions on the Loop limit surface and computes the exact limit normals
+ * there. Both only depend on the one-ring of a vertex, so any subdivision
+ * level can be projected, and a coarse level shades like a much finer one.
+ *
+ * All masks are left eigenvectors of the local subdivision matrix of a vertex.
+ * Interior vertices use the closed-form masks for Loop's stencil; boundary
+ * vertices use the masks of the cubic B-spline boundary curve, with the
+ * tangent across the boundary derived for the interior rules this subdivider
+ * applies next to the boundary.
+ */
+class LimitProjector {
+ public:
+  LimitProjector();
+  void setNumThreads(int numThreads);
+
+  Mesh project(const Mesh& mesh) const;
+
+  QVector3D limitPosition(const Mesh& mesh, int v) const;
+  QVector3D limitNormal(const Mesh& mesh, int v) const;
+
+ private:
+  int firstOutgoingHalfEdge(const Mesh& mesh, int v) const;
+
+  int numThreads;
+};
+
+#endif  // LIMIT_PROJECTOR_H
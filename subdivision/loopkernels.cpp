@@ -0,0 +1,230 @@
+#include "loopkernels.h"
+
+#include "loopstencils.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LOOP_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Weights of the endpoints and of the opposite vertices of an interior edge.
+#define EDGE_WEIGHT (3.0f / 8.0f)
+#define OPPOSITE_WEIGHT (1.0f / 8.0f)
+
+/**
+ * @brief edgePointsScalar Scalar version of LoopKernels::edgePoints.
+ */
+static void edgePointsScalar(const float* const coords[3], const int* indices,
+                             const int* targets, int count,
+                             float* const newCoords[3]) {
+  const int* a = indices;
+  const int* b = indices + LOOP_KERNEL_BATCH_SIZE;
+  const int* c = indices + 2 * LOOP_KERNEL_BATCH_SIZE;
+  const int* d = indices + 3 * LOOP_KERNEL_BATCH_SIZE;
+  for (int axis = 0; axis < 3; ++axis) {
+    const float* p = coords[axis];
+    for (int i = 0; i < count; ++i) {
+      newCoords[axis][targets[i]] = (p[a[i]] + p[b[i]]) * EDGE_WEIGHT +
+                                    (p[c[i]] + p[d[i]]) * OPPOSITE_WEIGHT;
+    }
+  }
+}
+
+/**
+ * @brief regularVertexPointsScalar Scalar version of
+ * LoopKernels::regularVertexPoints.
+ */
+static void regularVertexPointsScalar(const float* const coords[3],
+                                      const int* indices, const int* targets,
+                                      int count, float* const newCoords[3]) {
+  for (int axis = 0; axis < 3; ++axis) {
+    const float* p = coords[axis];
+    for (int i = 0; i < count; ++i) {
+      float sum = 0.0f;
+      for (int k = 1; k <= 6; ++k) {
+        sum += p[indices[k * LOOP_KERNEL_BATCH_SIZE + i]];
+      }
+      newCoords[axis][targets[i]] =
+          p[indices[i]] * LOOP_ALPHA[6] + sum * LOOP_BETA[6];
+    }
+  }
+}
+
+#ifdef LOOP_KERNELS_X86
+
+// The vectorized kernels below must not be compiled with FMA enabled: fusing
+// the multiplications and additions would change the rounding.
+
+/**
+ * @brief gatherSSE Loads four coordinates by index.
+ */
+__attribute__((target("sse4.1"))) static inline __m128 gatherSSE(
+    const float* p, const int* index) {
+  return _mm_setr_ps(p[index[0]], p[index[1]], p[index[2]], p[index[3]]);
+}
+
+/**
+ * @brief scatter Stores a vector of computed coordinates at their targets.
+ */
+static inline void scatter(float* out, const float* values, const int* targets,
+                           int width) {
+  for (int j = 0; j < width; ++j) {
+    out[targets[j]] = values[j];
+  }
+}
+
+/**
+ * @brief edgePointsSSE SSE4.1 version of LoopKernels::edgePoints. Computes
+ * four edge points at once.
+ */
+__attribute__((target("sse4.1"))) static void edgePointsSSE(
+    const float* const coords[3], const int* indices, const int* targets,
+    int count, float* const newCoords[3]) {
+  const __m128 edgeWeight = _mm_set1_ps(EDGE_WEIGHT);
+  const __m128 oppositeWeight = _mm_set1_ps(OPPOSITE_WEIGHT);
+  alignas(16) float values[4];
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float* p = coords[axis];
+      __m128 a = gatherSSE(p, indices + i);
+      __m128 b = gatherSSE(p, indices + LOOP_KERNEL_BATCH_SIZE + i);
+      __m128 c = gatherSSE(p, indices + 2 * LOOP_KERNEL_BATCH_SIZE + i);
+      __m128 d = gatherSSE(p, indices + 3 * LOOP_KERNEL_BATCH_SIZE + i);
+      __m128 point = _mm_add_ps(_mm_mul_ps(_mm_add_ps(a, b), edgeWeight),
+                                _mm_mul_ps(_mm_add_ps(c, d), oppositeWeight));
+      _mm_store_ps(values, point);
+      scatter(newCoords[axis], values, targets + i, 4);
+    }
+  }
+  edgePointsScalar(coords, indices + i, targets + i, count - i, newCoords);
+}
+
+/**
+ * @brief regularVertexPointsSSE SSE4.1 version of
+ * LoopKernels::regularVertexPoints. Computes four vertex points at once.
+ */
+__attribute__((target("sse4.1"))) static void regularVertexPointsSSE(
+    const float* const coords[3], const int* indices, const int* targets,
+    int count, float* const newCoords[3]) {
+  const __m128 alpha = _mm_set1_ps(LOOP_ALPHA[6]);
+  const __m128 beta = _mm_set1_ps(LOOP_BETA[6]);
+  alignas(16) float values[4];
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float* p = coords[axis];
+      __m128 sum = _mm_setzero_ps();
+      for (int k = 1; k <= 6; ++k) {
+        sum = _mm_add_ps(
+            sum, gatherSSE(p, indices + k * LOOP_KERNEL_BATCH_SIZE + i));
+      }
+      __m128 point = _mm_add_ps(_mm_mul_ps(gatherSSE(p, indices + i), alpha),
+                                _mm_mul_ps(sum, beta));
+      _mm_store_ps(values, point);
+      scatter(newCoords[axis], values, targets + i, 4);
+    }
+  }
+  regularVertexPointsScalar(coords, indices + i, targets + i, count - i,
+                            newCoords);
+}
+
+/**
+ * @brief gatherAVX2 Loads eight coordinates by index.
+ */
+__attribute__((target("avx2"))) static inline __m256 gatherAVX2(
+    const float* p, const int* index) {
+  __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index));
+  return _mm256_i32gather_ps(p, offsets, 4);
+}
+
+/**
+ * @brief edgePointsAVX2 AVX2 version of LoopKernels::edgePoints. Computes
+ * eight edge points at once.
+ */
+__attribute__((target("avx2"))) static void edgePointsAVX2(
+    const float* const coords[3], const int* indices, const int* targets,
+    int count, float* const newCoords[3]) {
+  const __m256 edgeWeight = _mm256_set1_ps(EDGE_WEIGHT);
+  const __m256 oppositeWeight = _mm256_set1_ps(OPPOSITE_WEIGHT);
+  alignas(32) float values[8];
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float* p = coords[axis];
+      __m256 a = gatherAVX2(p, indices + i);
+      __m256 b = gatherAVX2(p, indices + LOOP_KERNEL_BATCH_SIZE + i);
+      __m256 c = gatherAVX2(p, indices + 2 * LOOP_KERNEL_BATCH_SIZE + i);
+      __m256 d = gatherAVX2(p, indices + 3 * LOOP_KERNEL_BATCH_SIZE + i);
+      __m256 point =
+          _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(a, b), edgeWeight),
+                        _mm256_mul_ps(_mm256_add_ps(c, d), oppositeWeight));
+      _mm256_store_ps(values, point);
+      scatter(newCoords[axis], values, targets + i, 8);
+    }
+  }
+  edgePointsSSE(coords, indices + i, targets + i, count - i, newCoords);
+}
+
+/**
+ * @brief regularVertexPointsAVX2 AVX2 version of
+ * LoopKernels::regularVertexPoints. Computes eight vertex points at once.
+ */
+__attribute__((target("avx2"))) static void regularVertexPointsAVX2(
+    const float* const coords[3], const int* indices, const int* targets,
+    int count, float* const newCoords[3]) {
+  const __m256 alpha = _mm256_set1_ps(LOOP_ALPHA[6]);
+  const __m256 beta = _mm256_set1_ps(LOOP_BETA[6]);
+  alignas(32) float values[8];
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float* p = coords[axis];
+      __m256 sum = _mm256_setzero_ps();
+      for (int k = 1; k <= 6; ++k) {
+        sum = _mm256_add_ps(
+            sum, gatherAVX2(p, indices + k * LOOP_KERNEL_BATCH_SIZE + i));
+      }
+      __m256 point =
+          _mm256_add_ps(_mm256_mul_ps(gatherAVX2(p, indices + i), alpha),
+                        _mm256_mul_ps(sum, beta));
+      _mm256_store_ps(values, point);
+      scatter(newCoords[axis], values, targets + i, 8);
+    }
+  }
+  regularVertexPointsSSE(coords, indices + i, targets + i, count - i,
+                         newCoords);
+}
+
+#endif  // LOOP_KERNELS_X86
+
+/**
+ * @brief supportedLoopKernels Retrieves every kernel set this processor
+ * supports, ordered from slowest to fastest. The scalar set always comes first,
+ * so the other sets can be checked against it.
+ * @return The supported kernel sets.
+ */
+QVector<LoopKernels> supportedLoopKernels() {
+  QVector<LoopKernels> kernels = {
+      {"scalar", edgePointsScalar, regularVertexPointsScalar}};
+#ifdef LOOP_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    kernels.append({"SSE4.1", edgePointsSSE, regularVertexPointsSSE});
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.append({"AVX2", edgePointsAVX2, regularVertexPointsAVX2});
+  }
+#endif
+  return kernels;
+}
+
+/**
+ * @brief loopKernels Retrieves the fastest kernels this processor supports.
+ * The instruction set is detected on the first call.
+ * @return The kernel set.
+ */
+const LoopKernels& loopKernels() {
+  static const LoopKernels kernels = supportedLoopKernels().last();
+  return kernels;
+}
@@ -0,0 +1,40 @@
+#ifndef LOOP_KERNELS_H
+#define LOOP_KERNELS_H
+
+#include <QVector>
+
+// Maximum number of points a kernel computes per call.
+#define LOOP_KERNEL_BATCH_SIZE 256
+
+/**
+ * @brief The LoopKernels struct holds batched kernels that compute Loop
+ * subdivision points directly on the separate x, y and z coordinate arrays of
+ * a mesh. Every kernel takes the indices of the points in its stencil, stored
+ * per stencil entry: entry k of point i is indices[k * LOOP_KERNEL_BATCH_SIZE +
+ * i]. The results are written to newCoords at the indices in targets.
+ *
+ * The vectorized kernels perform exactly the same floating-point operations
+ * in the same order as the scalar ones, so every kernel set produces the same
+ * bits.
+ */
+struct LoopKernels {
+  // Name of the instruction set used by the kernels.
+  const char* name;
+
+  // Edge points of interior edges. The stencil consists of the two endpoints
+  // of the edge, followed by the two opposite vertices.
+  void (*edgePoints)(const float* const coords[3], const int* indices,
+                     const int* targets, int count, float* const newCoords[3]);
+
+  // Vertex points of regular (interior, valence 6) vertices. The stencil
+  // consists of the vertex itself, followed by its six neighbours in the order
+  // in which they are summed.
+  void (*regularVertexPoints)(const float* const coords[3], const int* indices,
+                              const int* targets, int count,
+                              float* const newCoords[3]);
+};
+
+QVector<LoopKernels> supportedLoopKernels();
+const LoopKernels& loopKernels();
+
+#endif  // LOOP_KERNELS_H
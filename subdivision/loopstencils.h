@@ -0,0 +1,231 @@
+#ifndef LOOP_STENCILS_H
+#define LOOP_STENCILS_H
+
+#include <QVector3D>
+#include <cmath>
+
+#include "mesh/mesh.h"
+
+// Interior vertices up to this valence use precomputed stencil weights.
+#define LOOP_MAX_TABLE_VALENCE 16
+
+/**
+ * @brief loopBeta Calculates the weight of the neighbours of an interior
+ * vertex using Loop's stencil.
+ * @param valence The valence of the vertex.
+ * @return The weight of every neighbour.
+ */
+inline float loopBeta(int valence) {
+  float center = (0.375f + (0.25f * cos(6.2831853f / (float)valence)));
+  return (0.625f - (center * center)) / (float)valence;
+}
+
+// loopBeta(n) for every valence n up to LOOP_MAX_TABLE_VALENCE, rounded
+// exactly as loopBeta rounds it.
+constexpr float LOOP_BETA[LOOP_MAX_TABLE_VALENCE + 1] = {
+    0.0f,          0.234375f,     0.3046875f,    0.1875f,
+    0.12109375f,   0.084093228f,  0.0625f,       0.0490249172f,
+    0.0400678068f, 0.0337850191f, 0.0291777551f, 0.025673477f,
+    0.0229266863f, 0.0207192283f, 0.0189078059f, 0.0173949953f,
+    0.0161125287f};
+
+// 1 - n * loopBeta(n), the weight of the vertex itself, for every valence n up
+// to LOOP_MAX_TABLE_VALENCE.
+constexpr float LOOP_ALPHA[LOOP_MAX_TABLE_VALENCE + 1] = {
+    1.0f,         0.765625f,    0.390625f,    0.4375f,
+    0.515625f,    0.579533875f, 0.625f,       0.656825542f,
+    0.679457545f, 0.695934832f, 0.708222449f, 0.717591763f,
+    0.724879742f, 0.730650067f, 0.735290706f, 0.739075065f,
+    0.74219954f};
+
+/**
+ * @brief The LoopStencil enum lists the stencils used to compute vertex
+ * points. Every stencil has a kernel of its own, so vertices can be bucketed
+ * by stencil and each bucket processed without branching on the vertex type.
+ */
+enum class LoopStencil {
+  // Interior vertex with valence 6, which after the first subdivision step
+  // holds for almost every vertex.
+  Regular,
+  // Interior vertex with any other valence.
+  Extraordinary,
+  // Vertex on a boundary.
+  Boundary
+};
+
+#define NUM_LOOP_STENCILS 3
+
+/**
+ * @brief classifyVertex Determines the stencil to use for a vertex.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return The stencil of the vertex.
+ */
+inline LoopStencil classifyVertex(const Mesh& mesh, int v) {
+  if (mesh.isBoundaryVertex(v)) {
+    return LoopStencil::Boundary;
+  }
+  return mesh.valence(v) == 6 ? LoopStencil::Regular
+                              : LoopStencil::Extraordinary;
+}
+
+/**
+ * @brief sumNeighbours Sums the coordinates of the neighbours of an interior
+ * vertex. The sum starts right after the outgoing half-edge and ends with it;
+ * changing the order would change the rounding of the result.
+ * @tparam Valence The valence of the vertex.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return The sum of the neighbour coordinates.
+ */
+template <int Valence>
+inline QVector3D sumNeighbours(const Mesh& mesh, int v) {
+  QVector3D sum = {0.0f, 0.0f, 0.0f};
+  int h = mesh.next(mesh.twin(mesh.out(v)));
+  for (int i = 0; i < Valence; ++i) {
+    sum += mesh.coords(mesh.origin(mesh.next(h)));
+    h = mesh.next(mesh.twin(h));
+  }
+  return sum;
+}
+
+/**
+ * @brief gatherRegularStencil Gathers the stencil of a regular vertex for the
+ * batched kernels: the vertex itself, followed by its neighbours in the order
+ * in which sumNeighbours adds them.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @param indices Where to store the seven vertex indices.
+ * @param stride Distance between two consecutive indices in the output.
+ */
+inline void gatherRegularStencil(const Mesh& mesh, int v, int* indices,
+                                 int stride) {
+  indices[0] = v;
+  int h = mesh.next(mesh.twin(mesh.out(v)));
+  for (int k = 1; k <= 6; ++k) {
+    indices[k * stride] = mesh.origin(mesh.next(h));
+    h = mesh.next(mesh.twin(h));
+  }
+}
+
+/**
+ * @brief gatherEdgeStencil Gathers the stencil of an interior edge for the
+ * batched kernels: the two endpoints, followed by the two opposite vertices.
+ * @param mesh The mesh the edge belongs to.
+ * @param h Index of one of the half-edges of the edge.
+ * @param indices Where to store the four vertex indices.
+ * @param stride Distance between two consecutive indices in the output.
+ */
+inline void gatherEdgeStencil(const Mesh& mesh, int h, int* indices,
+                              int stride) {
+  indices[0] = mesh.origin(h);
+  indices[stride] = mesh.origin(mesh.next(h));
+  indices[2 * stride] = mesh.origin(mesh.prev(mesh.twin(h)));
+  indices[3 * stride] = mesh.origin(mesh.next(mesh.next(h)));
+}
+
+/**
+ * @brief loopVertexPoint Calculates the vertex point of a vertex using the
+ * kernel of the provided stencil. The vertex has to be of that stencil.
+ * @tparam Stencil The stencil of the vertex.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex.
+ * @return The coordinates of the vertex point.
+ */
+template <LoopStencil Stencil>
+QVector3D loopVertexPoint(const Mesh& mesh, int v);
+
+template <>
+inline QVector3D loopVertexPoint<LoopStencil::Regular>(const Mesh& mesh,
+                                                       int v) {
+  return mesh.coords(v) * LOOP_ALPHA[6] +
+         sumNeighbours<6>(mesh, v) * LOOP_BETA[6];
+}
+
+template <>
+inline QVector3D loopVertexPoint<LoopStencil::Extraordinary>(const Mesh& mesh,
+                                                             int v) {
+  int valence = mesh.valence(v);
+  if (mesh.out(v) < 0) {
+    // Isolated vertex
+    return mesh.coords(v);
+  }
+  QVector3D sum = {0.0f, 0.0f, 0.0f};
+  int start = mesh.next(mesh.twin(mesh.out(v)));
+  for (int h : mesh.outgoingHalfEdgesFrom(start)) {
+    sum += mesh.coords(mesh.origin(mesh.next(h)));
+  }
+  if (valence <= LOOP_MAX_TABLE_VALENCE) {
+    return mesh.coords(v) * LOOP_ALPHA[valence] + sum * LOOP_BETA[valence];
+  }
+  float beta = loopBeta(valence);
+  return mesh.coords(v) * (1.0 - (valence * beta)) + sum * beta;
+}
+
+template <>
+inline QVector3D loopVertexPoint<LoopStencil::Boundary>(const Mesh& mesh,
+                                                        int v) {
+  // Next and previous boundary point
+  QVector3D coord1 =
+      mesh.coords(mesh.origin(mesh.next(mesh.nextBoundaryHalfEdge(v))));
+  QVector3D coord2 = mesh.coords(mesh.origin(mesh.prevBoundaryHalfEdge(v)));
+  return (1.0 / 8.0) * (coord1 + coord2) + (3.0 / 4.0) * mesh.coords(v);
+}
+
+/**
+ * @brief forEachVertexPointWeight Enumerates the weights of the stencil of a
+ * vertex point: the vertex point equals the sum of weight * coords(index) over
+ * all pairs passed to the function. An index can be passed more than once.
+ * @param mesh The control mesh.
+ * @param v Index of the vertex.
+ * @param function Invoked as function(index, weight) for every stencil entry.
+ */
+template <typename Function>
+void forEachVertexPointWeight(const Mesh& mesh, int v,
+                              const Function& function) {
+  if (mesh.out(v) < 0) {
+    // Isolated vertex
+    function(v, 1.0);
+  } else if (mesh.isBoundaryVertex(v)) {
+    function(v, 3.0 / 4.0);
+    function(mesh.origin(mesh.next(mesh.nextBoundaryHalfEdge(v))), 1.0 / 8.0);
+    function(mesh.origin(mesh.prevBoundaryHalfEdge(v)), 1.0 / 8.0);
+  } else {
+    int valence = mesh.valence(v);
+    double alpha, beta;
+    if (valence <= LOOP_MAX_TABLE_VALENCE) {
+      alpha = LOOP_ALPHA[valence];
+      beta = LOOP_BETA[valence];
+    } else {
+      beta = loopBeta(valence);
+      alpha = 1.0 - valence * beta;
+    }
+    function(v, alpha);
+    for (int h : mesh.outgoingHalfEdges(v)) {
+      function(mesh.origin(mesh.next(h)), beta);
+    }
+  }
+}
+
+/**
+ * @brief forEachEdgePointWeight Enumerates the weights of the stencil of an
+ * edge point. See forEachVertexPointWeight.
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges of the edge.
+ * @param function Invoked as function(index, weight) for every stencil entry.
+ */
+template <typename Function>
+void forEachEdgePointWeight(const Mesh& mesh, int h,
+                            const Function& function) {
+  if (mesh.isBoundaryEdge(h)) {
+    function(mesh.origin(h), 1.0 / 2.0);
+    function(mesh.origin(mesh.next(h)), 1.0 / 2.0);
+  } else {
+    function(mesh.origin(h), 3.0 / 8.0);
+    function(mesh.origin(mesh.next(h)), 3.0 / 8.0);
+    function(mesh.origin(mesh.prev(mesh.twin(h))), 1.0 / 8.0);
+    function(mesh.origin(mesh.next(mesh.next(h))), 1.0 / 8.0);
+  }
+}
+
+#endif  // LOOP_STENCILS_H
@@ -1,11 +1,43 @@
 #include "loopsubdivider.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <climits>
+
+#include "loopkernels.h"
+#include "loopstencils.h"
+#include "util/parallel.h"
+
+// Meshes with fewer half-edges than this are always subdivided serially; the
+// cost of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_HALF_EDGES 65536
 
 /**
  * @brief LoopSubdivider::LoopSubdivider Creates a new empty Loop subdivider.
+ * By default, large meshes are subdivided using all cores, with the fastest
+ * kernels the processor supports.
+ */
+LoopSubdivider::LoopSubdivider() : numThreads(0), kernels(&loopKernels()) {}
+
+/**
+ * @brief LoopSubdivider::setNumThreads Sets the number of threads used to
+ * subdivide a mesh. The result does not depend on the number of threads.
+ * @param numThreads The number of threads. 1 forces serial subdivision;
+ * values smaller than 1 use all cores.
+ */
+void LoopSubdivider::setNumThreads(int numThreads) {
+    this->numThreads = numThreads;
+}
+
+/**
+ * @brief LoopSubdivider::setKernels Sets the kernels used to calculate the
+ * regular vertex points and the interior edge points. Every kernel set
+ * produces the same result; this exists to test exactly that.
+ * @param kernels The kernel set, which must outlive the subdivider.
  */
-LoopSubdivider::LoopSubdivider() {}
+void LoopSubdivider::setKernels(const LoopKernels& kernels) {
+    this->kernels = &kernels;
+}
 
 /**
  * @brief LoopSubdivider::subdivide Subdivides the provided control mesh and
@@ -16,128 +48,226 @@ LoopSubdivider::LoopSubdivider() {}
  * @return The mesh resulting of applying a single subdivision step on the
  * control mesh.
  */
-Mesh LoopSubdivider::subdivide(Mesh& controlMesh) const {
+Mesh LoopSubdivider::subdivide(const Mesh& controlMesh) const {
+    int threads = 1;
+    if (controlMesh.numHalfEdges() >= MIN_PARALLEL_HALF_EDGES) {
+        threads = resolveThreadCount(numThreads);
+    }
     Mesh newMesh;
     reserveSizes(controlMesh, newMesh);
-    geometryRefinement(controlMesh, newMesh);
-    topologyRefinement(controlMesh, newMesh);
+    geometryRefinement(controlMesh, newMesh, threads);
+    topologyRefinement(controlMesh, newMesh, threads);
     return newMesh;
 }
 
+/**
+ * @brief LoopSubdivider::predictCounts Predicts the element counts after a
+ * number of subdivision steps without subdividing, following the same rules
+ * as reserveSizes: every step maps V, E, F, H to V + E, 2E + 2H - 3F, 2H - 2F
+ * and 6H - 6F, which is 2E + 3F, 4F and 4H for triangle meshes. Counting
+ * stops once the half-edges no longer fit in an int, since such a mesh cannot
+ * be represented anyway.
+ * @param controlMesh The control mesh.
+ * @param levels The number of subdivision steps.
+ * @return The predicted element counts.
+ */
+LoopSubdivider::ElementCounts LoopSubdivider::predictCounts(
+        const Mesh& controlMesh, int levels) {
+    ElementCounts counts = {controlMesh.numVerts(), controlMesh.numHalfEdges(),
+                            controlMesh.numFaces(), controlMesh.numEdges()};
+    for (int l = 0; l < levels && counts.numHalfEdges <= INT_MAX; l++) {
+        qint64 numHalfEdges = counts.numHalfEdges;
+        qint64 numFaces = counts.numFaces;
+        counts.numVertices += counts.numEdges;
+        counts.numEdges = 2 * counts.numEdges + 2 * numHalfEdges - 3 * numFaces;
+        counts.numFaces = 2 * numHalfEdges - 2 * numFaces;
+        counts.numHalfEdges = 6 * numHalfEdges - 6 * numFaces;
+    }
+    return counts;
+}
+
+/**
+ * @brief LoopSubdivider::childFaces Finds the faces that a set of faces is
+ * split into by one subdivision step: the corner triangle of every half-edge
+ * h, which is face h, and the triangles of the inner polygon, see
+ * innerHalfEdge.
+ * @param controlMesh The control mesh.
+ * @param faces Indices of faces of the control mesh. Invalid indices are
+ * skipped.
+ * @return Indices of the faces in the subdivided mesh.
+ */
+QVector<int> LoopSubdivider::childFaces(const Mesh& controlMesh,
+                                        const QVector<int>& faces) {
+    QVector<int> children;
+    for (int f : faces) {
+        if (f < 0 || f >= controlMesh.numFaces()) {
+            continue;
+        }
+        int side = controlMesh.side(f);
+        int n = controlMesh.faceValence(f);
+        for (int k = 0; k < n; k++) {
+            children.append(side + k);
+        }
+        int first = controlMesh.numHalfEdges() + side - 2 * f;
+        for (int t = 0; t < n - 2; t++) {
+            children.append(first + t);
+        }
+    }
+    return children;
+}
+
 /**
  * @brief LoopSubdivider::reserveSizes Resizes the vertex, half-edge and face
- * vectors. Aslo recalculates the edge count.
+ * arrays. Aslo recalculates the edge count. Loop subdivision generates only
+ * triangles, so the new mesh is a triangle mesh without any face data. Every
+ * half-edge cuts off a corner triangle, and the inner polygon of a face with
+ * n sides is split into n - 2 triangles, so a triangle mesh gets 4F faces.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh. At this point, the mesh is fully empty.
  */
-void LoopSubdivider::reserveSizes(Mesh& controlMesh, Mesh& newMesh) const {
-    int newNumEdges = 2 * controlMesh.numEdges() + 3 * controlMesh.numFaces();
-    int newNumFaces = controlMesh.numFaces() * 4;
-    int newNumHalfEdges = controlMesh.numHalfEdges() * 4;
+void LoopSubdivider::reserveSizes(const Mesh& controlMesh,
+                                  Mesh& newMesh) const {
+    int numHalfEdges = controlMesh.numHalfEdges();
+    int numFaces = controlMesh.numFaces();
+    int newNumEdges = 2 * controlMesh.numEdges() + 2 * numHalfEdges -
+                      3 * numFaces;
+    int newNumFaces = 2 * numHalfEdges - 2 * numFaces;
+    int newNumHalfEdges = 6 * numHalfEdges - 6 * numFaces;
     int newNumVerts = controlMesh.numVerts() + controlMesh.numEdges();
 
-    newMesh.getVertices().resize(newNumVerts);
-    newMesh.getHalfEdges().resize(newNumHalfEdges);
-    newMesh.getFaces().resize(newNumFaces);
+    newMesh.resize(newNumVerts, newNumHalfEdges, newNumFaces, true);
     newMesh.edgeCount = newNumEdges;
 }
 
+/**
+ * @brief applyStencil Calculates the vertex points of a bucket of vertices
+ * that all use the same stencil.
+ * @tparam Stencil The stencil of the vertices.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ * @param bucket Indices of the vertices.
+ * @param size Number of vertices in the bucket.
+ */
+template <LoopStencil Stencil>
+static void applyStencil(const Mesh& controlMesh, Mesh& newMesh,
+                         const int* bucket, int size) {
+    for (int i = 0; i < size; i++) {
+        int v = bucket[i];
+        newMesh.setCoords(v, loopVertexPoint<Stencil>(controlMesh, v));
+    }
+}
+
 /**
  * @brief LoopSubdivider::geometryRefinement Performs the geometry refinement.
  * In other words, it calculates the coordinates of the vertex and edge points.
+ * Every vertex and edge point has its own slot in the new mesh, so the points
+ * can be computed in parallel. The vertices are first bucketed by stencil, per
+ * block of vertices, after which every bucket is handled by the kernel of its
+ * stencil. Regular vertices and interior edges, which make up almost the
+ * entire mesh, are computed by the batched (vectorized) kernels.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh. At the start of this function, the only
  * guarantee you have of this newMesh is that the vertex, half-edge and face
- * vectors have the correct sizes.
+ * arrays have the correct sizes.
+ * @param numThreads The number of threads to use.
  */
-void LoopSubdivider::geometryRefinement(Mesh& controlMesh,
-                                        Mesh& newMesh) const {
-    QVector<Vertex>& newVertices = newMesh.getVertices();
-    QVector<Vertex>& vertices = controlMesh.getVertices();
-
+void LoopSubdivider::geometryRefinement(const Mesh& controlMesh,
+                                        Mesh& newMesh, int numThreads) const {
+    const float* const coords[3] = {controlMesh.vertexX.constData(),
+                                    controlMesh.vertexY.constData(),
+                                    controlMesh.vertexZ.constData()};
+    float* const newCoords[3] = {newMesh.vertexX.data(),
+                                 newMesh.vertexY.data(),
+                                 newMesh.vertexZ.data()};
     // Vertex Points
-    for (int v = 0; v < controlMesh.numVerts(); v++) {
-        QVector3D coords = vertexPoint(vertices[v]);
-        Vertex vertPoint(coords, nullptr, vertices[v].valence, v);
-        newVertices[v] = vertPoint;
-    }
-    // Edge Points
-    QVector<HalfEdge>& halfEdges = controlMesh.getHalfEdges();
-    for (int h = 0; h < controlMesh.numHalfEdges(); h++) {
-    HalfEdge currentEdge = halfEdges[h];
-    // Only create a new vertex per set of halfEdges (i.e. once per undirected edge)
-    if (h > currentEdge.twinIdx()) {
-        QVector3D coords = edgePoint(currentEdge);
-        int v = controlMesh.numVerts() + currentEdge.edgeIdx();
-
-        // checking the valence at the boundaries and setting it 4
-        int valence = 6;
-        if (currentEdge.isBoundaryEdge()){
-            valence = 4;
+    parallelFor(0, controlMesh.numVerts(), numThreads,
+                [&](int begin, int end, int) {
+        int buckets[NUM_LOOP_STENCILS][LOOP_KERNEL_BATCH_SIZE];
+        int stencils[7 * LOOP_KERNEL_BATCH_SIZE];
+        for (int block = begin; block < end; block += LOOP_KERNEL_BATCH_SIZE) {
+            int blockEnd = std::min(block + LOOP_KERNEL_BATCH_SIZE, end);
+            int sizes[NUM_LOOP_STENCILS] = {0, 0, 0};
+            for (int v = block; v < blockEnd; v++) {
+                int stencil = int(classifyVertex(controlMesh, v));
+                buckets[stencil][sizes[stencil]++] = v;
+                newMesh.vertexValence[v] = controlMesh.valence(v);
+            }
+            const int* regular = buckets[int(LoopStencil::Regular)];
+            int numRegular = sizes[int(LoopStencil::Regular)];
+            for (int i = 0; i < numRegular; i++) {
+                gatherRegularStencil(controlMesh, regular[i], stencils + i,
+                                     LOOP_KERNEL_BATCH_SIZE);
+            }
+            kernels->regularVertexPoints(coords, stencils, regular, numRegular,
+                                         newCoords);
+            applyStencil<LoopStencil::Extraordinary>(
+                controlMesh, newMesh, buckets[int(LoopStencil::Extraordinary)],
+                sizes[int(LoopStencil::Extraordinary)]);
+            applyStencil<LoopStencil::Boundary>(
+                controlMesh, newMesh, buckets[int(LoopStencil::Boundary)],
+                sizes[int(LoopStencil::Boundary)]);
         }
-        Vertex edgePointVert = Vertex(coords, nullptr, valence, v);
-        newVertices[v] = edgePointVert;
+    });
+    // Edge Points
+    parallelFor(0, controlMesh.numHalfEdges(), numThreads,
+                [&](int begin, int end, int) {
+        int stencils[4 * LOOP_KERNEL_BATCH_SIZE];
+        int targets[LOOP_KERNEL_BATCH_SIZE];
+        for (int block = begin; block < end; block += LOOP_KERNEL_BATCH_SIZE) {
+            int blockEnd = std::min(block + LOOP_KERNEL_BATCH_SIZE, end);
+            int count = 0;
+            for (int h = block; h < blockEnd; h++) {
+                // Only create a new vertex per set of halfEdges (i.e. once per
+                // undirected edge)
+                if (h > controlMesh.twin(h)) {
+                    int v = controlMesh.numVerts() + controlMesh.edge(h);
+                    // checking the valence at the boundaries and setting it 4
+                    int valence = 6;
+                    if (controlMesh.isBoundaryEdge(h)){
+                        newMesh.setCoords(v, edgePoint(controlMesh, h));
+                        valence = 4;
+                    } else {
+                        gatherEdgeStencil(controlMesh, h, stencils + count,
+                                          LOOP_KERNEL_BATCH_SIZE);
+                        targets[count++] = v;
+                    }
+                    if (!controlMesh.isTriangleMesh()) {
+                        valence += fanValence(controlMesh, h) +
+                                   fanValence(controlMesh, controlMesh.twin(h));
+                    }
+                    newMesh.vertexValence[v] = valence;
+                }
+            }
+            kernels->edgePoints(coords, stencils, targets, count, newCoords);
         }
-    }
-}
-
-/**
- * @brief LoopSubdivider::vertexPoint Calculates the new position of the
- * provided vertex.
- * @param vertex The vertex to calculate the new position of. Note that this
- * vertex is the vertex from the control mesh.
- * @return The coordinates of the new vertex point.
- */
-QVector3D LoopSubdivider::vertexPoint(const Vertex& vertex) const {
-    QVector3D outputVertex;
-    int valence = vertex.valence;
-    //Boundary vertex
-    if (vertex.isBoundaryVertex()){
-         // Getting coords of next boundary point
-         QVector3D coord1 = vertex.nextBoundaryHalfEdge()->next->origin->coords;
-         // Getting coords of previous boundary point
-         QVector3D coord2 = vertex.prevBoundaryHalfEdge()->origin->coords;
-
-         outputVertex = (1.0/8.0) * (coord1 + coord2) + (3.0/4.0) * vertex.coords;
-    }
-    // Inner vertex
-    else{
-        // Calculate beta for the given vertex using valence
-        float beta = calculateBeta(valence);
-        // Find surrounding vertex coords
-        std::vector<QVector3D> surroundingList = getSurroundingCoords(vertex);
-        // Sum of all neighbour vertices
-        QVector3D sumNeighbourCoords = getSumOfNeighborVertices(surroundingList,valence);
-
-        // Output coords
-        outputVertex = vertex.coords * (1.0 - (valence * beta)) + (sumNeighbourCoords * beta) ;
-    }
-    return outputVertex;
+    });
 }
 
 /**
  * @brief LoopSubdivider::edgePoint Calculates the position of the edge point.
- * @param edge One of the half-edges that lives on the edge to calculate
+ * @param mesh The control mesh.
+ * @param h Index of one of the half-edges that lives on the edge to calculate
  * the edge point. Note that this half-edge is the half-edge from the control
  * mesh.
  * @return The coordinates of the new edge point.
  */
-QVector3D LoopSubdivider::edgePoint(const HalfEdge& edge) const {
+QVector3D LoopSubdivider::edgePoint(const Mesh& mesh, int h) const {
 
-    QVector3D edgePt = edge.origin->coords;
+    QVector3D edgePt = mesh.coords(mesh.origin(h));
     QVector3D outputEdgeVertex;
     // Boundary vertex
-    if (edge.isBoundaryEdge()){
-        edgePt += edge.next->origin->coords;
+    if (mesh.isBoundaryEdge(h)){
+        edgePt += mesh.coords(mesh.origin(mesh.next(h)));
         edgePt /= 2.0;
         outputEdgeVertex = edgePt;
     }
     // Inner vertex
     else{
-        QVector3D edgePt2 = edge.next->origin->coords;
-        QVector3D edgePt3 = edge.twin->prev->origin->coords;
-        QVector3D edgePt4 = edge.next->next->origin->coords;
-        outputEdgeVertex = (edgePt + edgePt2)*(3.0/8.0) + (edgePt3 + edgePt4)*(1.0/8.0);
+        QVector3D edgePt2 = mesh.coords(mesh.origin(mesh.next(h)));
+        QVector3D edgePt3 = mesh.coords(mesh.origin(mesh.prev(mesh.twin(h))));
+        QVector3D edgePt4 = mesh.coords(mesh.origin(mesh.next(mesh.next(h))));
+        outputEdgeVertex = (edgePt + edgePt2)*(3.0/8.0) +
+                           (edgePt3 + edgePt4)*(1.0/8.0);
     }
     return outputEdgeVertex;
 }
@@ -145,127 +275,211 @@ QVector3D LoopSubdivider::edgePoint(const HalfEdge& edge) const {
 /**
  * @brief LoopSubdivider::topologyRefinement Performs the topology refinement.
  * Already takes into consideration the boundaries, so you do not need to alter
- * the geometry refinement for this assignment.
+ * the geometry refinement for this assignment. Every half-edge is split into
+ * its own four slots of the new mesh, so the half-edges can be split in
+ * parallel. Faces with more than three sides also get the diagonals of their
+ * inner polygon, see innerHalfEdge.
  * @param controlMesh The control mesh.
  * @param newMesh The new mesh.
+ * @param numThreads The number of threads to use.
  */
-void LoopSubdivider::topologyRefinement(Mesh& controlMesh,
-                                        Mesh& newMesh) const {
-    for (int f = 0; f < newMesh.numFaces(); ++f) {
-        newMesh.faces[f].index = f;
-        // Loop subdivision generates only triangles
-        newMesh.faces[f].valence = 3;
-    }
-
+void LoopSubdivider::topologyRefinement(const Mesh& controlMesh,
+                                        Mesh& newMesh, int numThreads) const {
     // Split halfedges
-    for (int h = 0; h < controlMesh.numHalfEdges(); ++h) {
-        HalfEdge* edge = &controlMesh.halfEdges[h];
+    parallelFor(0, controlMesh.numHalfEdges(), numThreads,
+                [&](int begin, int end, int) {
+        for (int h = begin; h < end; ++h) {
+            int twin = controlMesh.twin(h);
+            int prev = controlMesh.prev(h);
+            int prevTwin = controlMesh.twin(prev);
 
-        int h1 = 3 * h;
-        int h2 = 3 * h + 1;
-        int h3 = 3 * h + 2;
-        int h4 = 3 * controlMesh.numHalfEdges() + h;
+            int h1 = 3 * h;
+            int h2 = 3 * h + 1;
+            int h3 = 3 * h + 2;
+            int h4 = innerHalfEdge(controlMesh, h);
 
-        int twinIdx1 = edge->twinIdx() < 0 ? -1 : 3 * edge->twin->next->index + 2;
-        int twinIdx2 = 3 * controlMesh.numHalfEdges() + h;
-        int twinIdx3 = 3 * edge->prev->twinIdx();
-        int twinIdx4 = 3 * h + 1;
+            int twinIdx1 = twin < 0 ? -1 : 3 * controlMesh.next(twin) + 2;
+            int twinIdx2 = h4;
+            int twinIdx3 = prevTwin < 0 ? -1 : 3 * prevTwin;
+            int twinIdx4 = 3 * h + 1;
 
-        int vertIdx1 = edge->origin->index;
-        int vertIdx2 = controlMesh.numVerts() + edge->edgeIndex;
-        int vertIdx3 = controlMesh.numVerts() + edge->prev->edgeIndex;
-        int vertIdx4 = vertIdx3;
+            int vertIdx1 = controlMesh.origin(h);
+            int vertIdx2 = controlMesh.numVerts() + controlMesh.edge(h);
+            int vertIdx3 = controlMesh.numVerts() + controlMesh.edge(prev);
+            int vertIdx4 = vertIdx3;
 
-        int edgeIdx1 = 2 * edge->edgeIndex + (h > edge->twinIdx() ? 0 : 1);
-        int edgeIdx2 = 2 * controlMesh.numEdges() + h;
-        int edgeIdx3 = 2 * edge->prev->edgeIndex +
-                       (edge->prevIdx() > edge->prev->twinIdx() ? 1 : 0);
-        int edgeIdx4 = 2 * controlMesh.numEdges() + h;
+            int edgeIdx1 = 2 * controlMesh.edge(h) + (h > twin ? 0 : 1);
+            int edgeIdx2 = 2 * controlMesh.numEdges() + h;
+            int edgeIdx3 =
+                2 * controlMesh.edge(prev) + (prev > prevTwin ? 1 : 0);
+            int edgeIdx4 = 2 * controlMesh.numEdges() + h;
 
-        setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1);
-        setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2);
-        setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3);
-        setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4);
-    }
+            setHalfEdgeData(newMesh, h1, edgeIdx1, vertIdx1, twinIdx1);
+            setHalfEdgeData(newMesh, h2, edgeIdx2, vertIdx2, twinIdx2);
+            setHalfEdgeData(newMesh, h3, edgeIdx3, vertIdx3, twinIdx3);
+            setHalfEdgeData(newMesh, h4, edgeIdx4, vertIdx4, twinIdx4);
+
+            int f = controlMesh.face(h);
+            if (h == controlMesh.side(f) && controlMesh.faceValence(f) > 3) {
+                setDiagonals(controlMesh, newMesh, f);
+            }
+        }
+    });
+    setOutgoingHalfEdges(controlMesh, newMesh, numThreads);
 }
 
 /**
- * @brief LoopSubdivider::setHalfEdgeData Sets the data of a single half-edge
- * (and the corresponding vertex and face)
- * @param newMesh The new mesh this half-edge will live in.
- * @param h Index of the half-edge.
- * @param edgeIdx Index of the (undirected) edge this half-edge will belong to.
- * @param vertIdx Index of the vertex that this half-edge will originate from.
- * @param twinIdx Index of the twin of this half-edge. -1 if the half-edge lies
- * on a boundary.
+ * @brief LoopSubdivider::setOutgoingHalfEdges Sets the outgoing half-edge of
+ * every vertex in the new mesh. Several split half-edges originate from the
+ * same vertex, so instead of letting them race for the slot, every vertex
+ * picks the half-edge that topologyRefinement creates last when run serially
+ * (half-edge h of the control mesh creates 3h, 3h + 1, 3h + 2 and
+ * innerHalfEdge(h), which is 3H + h in a triangle mesh, in that order). The
+ * outgoing half-edge determines where the traversal of the neighbours starts,
+ * so this keeps the result independent of the number of threads.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ * @param numThreads The number of threads to use.
  */
-void LoopSubdivider::setHalfEdgeData(Mesh& newMesh, int h, int edgeIdx,
-                                     int vertIdx, int twinIdx) const {
-    HalfEdge* halfEdge = &newMesh.halfEdges[h];
-
-    halfEdge->edgeIndex = edgeIdx;
-    halfEdge->index = h;
-    halfEdge->origin = &newMesh.vertices[vertIdx];
-    halfEdge->face = &newMesh.faces[halfEdge->faceIdx()];
-    halfEdge->next = &newMesh.halfEdges[halfEdge->nextIdx()];
-    halfEdge->prev = &newMesh.halfEdges[halfEdge->prevIdx()];
-    halfEdge->twin = twinIdx < 0 ? nullptr : &newMesh.halfEdges[twinIdx];
-
-    halfEdge->origin->out = halfEdge;
-    halfEdge->origin->index = vertIdx;
-    halfEdge->face->side = halfEdge;
+void LoopSubdivider::setOutgoingHalfEdges(const Mesh& controlMesh,
+                                          Mesh& newMesh,
+                                          int numThreads) const {
+    int numHalfEdges = controlMesh.numHalfEdges();
+    // Vertex points: 3h originates from the origin of h.
+    parallelFor(0, controlMesh.numVerts(), numThreads,
+                [&](int begin, int end, int) {
+        for (int v = begin; v < end; v++) {
+            int h = lastOutgoingHalfEdge(controlMesh, v);
+            if (h >= 0) {
+                newMesh.vertexOut[v] = 3 * h;
+            }
+        }
+    });
+    // Edge points: 3h + 1 originates from the edge point of h; 3h + 2 and
+    // innerHalfEdge(h) originate from the edge point of prev(h).
+    parallelFor(0, numHalfEdges, numThreads, [&](int begin, int end, int) {
+        for (int h = begin; h < end; h++) {
+            int twin = controlMesh.twin(h);
+            if (h > twin) {
+                int out = std::max(4 * h + 1, 4 * controlMesh.next(h) + 3);
+                if (twin >= 0) {
+                    out = std::max({out, 4 * twin + 1,
+                                    4 * controlMesh.next(twin) + 3});
+                }
+                // Decode the creation order into the half-edge index.
+                int v = controlMesh.numVerts() + controlMesh.edge(h);
+                newMesh.vertexOut[v] = out % 4 == 3
+                                           ? innerHalfEdge(controlMesh, out / 4)
+                                           : 3 * (out / 4) + out % 4;
+            }
+        }
+    });
 }
 
 /**
- * @brief LoopSubdivider::calculateBeta Calculates the beta value using
- * Loop's stencil and using input valence value.
- * @param valence The valence of a given vertex.
+ * @brief LoopSubdivider::lastOutgoingHalfEdge Finds the outgoing half-edge of
+ * a vertex with the highest index.
+ * @param mesh The mesh the vertex belongs to.
+ * @param v Index of the vertex.
+ * @return Index of the half-edge. -1 if the vertex is isolated.
  */
-float LoopSubdivider::calculateBeta(int valence) const{
-    float beta= .0;
-    // Using Loop's stencil
-    float center = (0.375f + (0.25f * cos(6.2831853f / (float)valence)));
-    beta = (0.625f - (center * center)) / (float)valence;
-    return beta;
+int LoopSubdivider::lastOutgoingHalfEdge(const Mesh& mesh, int v) const {
+    int last = -1;
+    for (int h : mesh.outgoingHalfEdges(v)) {
+        last = std::max(last, h);
+    }
+    return last;
 }
 
 /**
- * @brief LoopSubdivider::getSurroundingCoords Iterates through half-edges and find
- * the list of coordinates connected to the given vertex in parameter.
- * @param vertex The initial vertex.
+ * @brief LoopSubdivider::innerHalfEdge Finds the half-edge of the new mesh
+ * that runs along the inner polygon of a face, from the edge point of prev(h)
+ * to the edge point of h. The inner polygon of a face with n sides is fanned
+ * out from the edge point of its last side into n - 2 triangles. These follow
+ * the H corner triangles, starting at triangle H + side(f) - 2f. In a triangle
+ * mesh, this is simply half-edge 3H + h.
+ * @param controlMesh The control mesh.
+ * @param h Index of the half-edge in the control mesh.
+ * @return Index of the half-edge in the new mesh.
  */
-std::vector<QVector3D> LoopSubdivider::getSurroundingCoords(const Vertex& vertex) const{
-    // List of surrounding vertex coordinates
-    std::vector<QVector3D> surroundingList;
-
-    HalfEdge *originHe = vertex.out;
-    HalfEdge *he = originHe->next;
-    Vertex *firstVertex = he->origin;
-    surroundingList.push_back(he->origin->coords);
-
-    // Keep traversing through surrounding vertices until
-    // we reach the first vertex.
-    do{
-        he = he->next;
-        surroundingList.push_back(he->origin->coords);
-        he = he->twin->next;
+int LoopSubdivider::innerHalfEdge(const Mesh& controlMesh, int h) const {
+    int numHalfEdges = controlMesh.numHalfEdges();
+    if (controlMesh.isTriangleMesh()) {
+        return 3 * numHalfEdges + h;
+    }
+    int f = controlMesh.face(h);
+    int side = controlMesh.side(f);
+    int n = controlMesh.faceValence(f);
+    int first = 3 * numHalfEdges + 3 * (side - 2 * f);
+    int k = h - side;
+    if (k == 0) {
+        return first;
     }
-    while(he->next->origin != firstVertex);
+    return k == n - 1 ? first + 3 * (n - 3) + 2 : first + 3 * (k - 1) + 1;
+}
 
-    return surroundingList;
+/**
+ * @brief LoopSubdivider::fanValence Determines the number of diagonals of the
+ * inner polygon of the face of a half-edge that end at the edge point of the
+ * half-edge. The polygon is fanned out from the edge point of its last side
+ * to the edge points of its second up to its third-to-last side.
+ * @param controlMesh The control mesh.
+ * @param h Index of the half-edge; -1 on a boundary.
+ * @return The number of diagonals.
+ */
+int LoopSubdivider::fanValence(const Mesh& controlMesh, int h) const {
+    if (h < 0) {
+        return 0;
+    }
+    int f = controlMesh.face(h);
+    int n = controlMesh.faceValence(f);
+    int k = h - controlMesh.side(f);
+    if (k == n - 1) {
+        return n - 3;
+    }
+    return k >= 1 && k <= n - 3 ? 1 : 0;
 }
 
 /**
- * @brief LoopSubdivider::getSumOfNeighborVertices Finds the sum
- * of all neighbouring verties in surroundingList.
- * @param surroundingList The list of coordinates of surrounding neighbours
- * @param valence The valence of origin vertex.
+ * @brief LoopSubdivider::setDiagonals Sets the half-edges of the diagonals of
+ * the inner polygon of a face with more than three sides, between consecutive
+ * triangles of its fan. The diagonals are numbered after the edges of the
+ * corner triangles.
+ * @param controlMesh The control mesh.
+ * @param newMesh The new mesh.
+ * @param f Index of the face in the control mesh.
  */
-QVector3D LoopSubdivider::getSumOfNeighborVertices(std::vector<QVector3D> surroundingList, int valence) const{
-    QVector3D sumVertex = {0.0f, 0.0f, 0.0f};
-    for (int i = 0; i < valence; i++){
-        sumVertex += surroundingList.back();
-        surroundingList.pop_back();
+void LoopSubdivider::setDiagonals(const Mesh& controlMesh, Mesh& newMesh,
+                                  int f) const {
+    int side = controlMesh.side(f);
+    int n = controlMesh.faceValence(f);
+    int first = 3 * controlMesh.numHalfEdges() + 3 * (side - 2 * f);
+    int firstEdge = 2 * controlMesh.numEdges() + controlMesh.numHalfEdges() +
+                    side - 3 * f;
+    int apex = controlMesh.numVerts() + controlMesh.edge(side + n - 1);
+    for (int j = 0; j < n - 3; j++) {
+        // Triangle j ends at the apex, triangle j + 1 starts there.
+        int toApex = first + 3 * j + 2;
+        int fromApex = first + 3 * (j + 1);
+        int vertIdx = controlMesh.numVerts() + controlMesh.edge(side + j + 1);
+        setHalfEdgeData(newMesh, toApex, firstEdge + j, vertIdx, fromApex);
+        setHalfEdgeData(newMesh, fromApex, firstEdge + j, apex, toApex);
     }
-    return sumVertex;
+}
+
+/**
+ * @brief LoopSubdivider::setHalfEdgeData Sets the data of a single half-edge.
+ * The face and the next and previous half-edges follow from the index.
+ * @param newMesh The new mesh this half-edge will live in.
+ * @param h Index of the half-edge.
+ * @param edgeIdx Index of the (undirected) edge this half-edge will belong to.
+ * @param vertIdx Index of the vertex that this half-edge will originate from.
+ * @param twinIdx Index of the twin of this half-edge. -1 if the half-edge lies
+ * on a boundary.
+ */
+void LoopSubdivider::setHalfEdgeData(Mesh& newMesh, int h, int edgeIdx,
+                                     int vertIdx, int twinIdx) const {
+    newMesh.halfEdgeEdge[h] = edgeIdx;
+    newMesh.halfEdgeOrigin[h] = vertIdx;
+    newMesh.halfEdgeTwin[h] = twinIdx;
 }
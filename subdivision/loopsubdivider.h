@@ -3,7 +3,8 @@
 
 #include "mesh/mesh.h"
 #include "subdivider.h"
-#include "../settings.h"
+
+struct LoopKernels;
 
 /**
  * @brief The LoopSubdivider class is a subdivider class that performs Loop
@@ -11,28 +12,45 @@
  */
 class LoopSubdivider : public Subdivider {
  public:
+  /**
+   * @brief The ElementCounts struct holds the element counts of a mesh.
+   */
+  struct ElementCounts {
+    qint64 numVertices;
+    qint64 numHalfEdges;
+    qint64 numFaces;
+    qint64 numEdges;
+  };
+
   LoopSubdivider();
-  Mesh subdivide(Mesh& controlMesh) const override;
-  void updateCurrentMesh(Mesh& newMesh)const;
-  int findClosest(const QVector2D& p, const float maxDist);
+  void setNumThreads(int numThreads);
+  void setKernels(const LoopKernels& kernels);
+  Mesh subdivide(const Mesh& controlMesh) const override;
+
+  static ElementCounts predictCounts(const Mesh& controlMesh, int levels);
+  static QVector<int> childFaces(const Mesh& controlMesh,
+                                 const QVector<int>& faces);
 
  private:
-  void reserveSizes(Mesh& controlMesh, Mesh& newMesh) const;
-  void geometryRefinement(Mesh& controlMesh, Mesh& newMesh) const;
-  void topologyRefinement(Mesh& controlMesh, Mesh& newMesh) const;
+  void reserveSizes(const Mesh& controlMesh, Mesh& newMesh) const;
+  void geometryRefinement(const Mesh& controlMesh, Mesh& newMesh,
+                          int numThreads) const;
+  void topologyRefinement(const Mesh& controlMesh, Mesh& newMesh,
+                          int numThreads) const;
+  void setOutgoingHalfEdges(const Mesh& controlMesh, Mesh& newMesh,
+                            int numThreads) const;
+  int lastOutgoingHalfEdge(const Mesh& mesh, int v) const;
+  int innerHalfEdge(const Mesh& controlMesh, int h) const;
+  int fanValence(const Mesh& controlMesh, int h) const;
+  void setDiagonals(const Mesh& controlMesh, Mesh& newMesh, int f) const;
 
   void setHalfEdgeData(Mesh& newMesh, int h, int edgeIdx, int vertIdx,
                        int twinIdx) const;
 
-  QVector3D vertexPoint(const Vertex& vertex) const;
-  QVector3D edgePoint(const HalfEdge& edge) const;
-  float calculateBeta(int valence) const;
-
-  std::vector <QVector3D> getSurroundingCoords(const Vertex& vertex) const;
-  QVector3D getSumOfNeighborVertices(const std::vector<QVector3D> surroundingList, int valence) const;
-
-  Settings *settings;
+  QVector3D edgePoint(const Mesh& mesh, int h) const;
 
+  int numThreads;
+  const LoopKernels* kernels;
 };
 
 #endif  // LOOP_SUBDIVIDER_H
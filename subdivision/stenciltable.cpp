@@ -0,0 +1,286 @@
+#include "stenciltable.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+
+#include "loopstencils.h"
+#include "loopsubdivider.h"
+#include "util/parallel.h"
+
+// Tables with fewer vertices than this are always built and evaluated
+// serially; the cost of spawning threads outweighs the gain for them.
+#define MIN_PARALLEL_ROWS 16384
+
+/**
+ * @brief StencilTable::StencilTable Creates an empty stencil table. By
+ * default, large tables are built and evaluated using all cores.
+ */
+StencilTable::StencilTable()
+    : controlVertexCount(0), levelCount(0), numThreads(0) {}
+
+/**
+ * @brief StencilTable::setNumThreads Sets the number of threads used to build
+ * and evaluate the table.
+ * @param numThreads The number of threads. 1 forces serial evaluation; values
+ * smaller than 1 use all cores.
+ */
+void StencilTable::setNumThreads(int numThreads) {
+  this->numThreads = numThreads;
+}
+
+/**
+ * @brief StencilTable::build Builds the stencils of the vertices of a
+ * subdivision level of the provided control mesh.
+ * @param controlMesh The control mesh. Only its topology is used.
+ * @param levels The number of subdivision steps.
+ */
+void StencilTable::build(const Mesh& controlMesh, int levels) {
+  controlVertexCount = controlMesh.numVerts();
+  levelCount = 0;
+
+  // Level 0: every vertex is its own stencil.
+  offsets.resize(controlVertexCount + 1);
+  columns.resize(controlVertexCount);
+  weights.fill(1.0f, controlVertexCount);
+  for (int v = 0; v < controlVertexCount; ++v) {
+    offsets[v] = v;
+    columns[v] = v;
+  }
+  offsets[controlVertexCount] = controlVertexCount;
+
+  LoopSubdivider subdivider;
+  subdivider.setNumThreads(numThreads);
+  Mesh mesh = controlMesh;
+  for (int l = 0; l < levels; ++l) {
+    composeLevel(mesh);
+    if (l + 1 < levels) {
+      mesh = subdivider.subdivide(mesh);
+    }
+  }
+}
+
+/**
+ * @brief StencilTable::clear Removes all stencils.
+ */
+void StencilTable::clear() {
+  offsets.clear();
+  columns.clear();
+  weights.clear();
+  controlVertexCount = 0;
+  levelCount = 0;
+}
+
+/**
+ * @brief StencilTable::isEmpty Checks whether the table has been built.
+ * @return True if the table contains no stencils; false otherwise.
+ */
+bool StencilTable::isEmpty() const { return offsets.isEmpty(); }
+
+/**
+ * @brief StencilTable::numLevels Retrieves the number of subdivision steps the
+ * table covers.
+ * @return The number of subdivision steps.
+ */
+int StencilTable::numLevels() const { return levelCount; }
+
+/**
+ * @brief StencilTable::numControlVertices Retrieves the number of vertices of
+ * the control mesh.
+ * @return The number of control vertices.
+ */
+int StencilTable::numControlVertices() const { return controlVertexCount; }
+
+/**
+ * @brief StencilTable::numVertices Retrieves the number of vertices of the
+ * subdivided mesh, which equals the number of stencils.
+ * @return The number of vertices.
+ */
+int StencilTable::numVertices() const {
+  return isEmpty() ? 0 : offsets.size() - 1;
+}
+
+/**
+ * @brief StencilTable::numWeights Retrieves the total number of weights of
+ * all stencils.
+ * @return The number of weights.
+ */
+int StencilTable::numWeights() const { return weights.size(); }
+
+/**
+ * @brief StencilTable::threadCount Determines the number of threads to use for
+ * a table with the provided number of stencils.
+ * @param numRows The number of stencils.
+ * @return The number of threads.
+ */
+int StencilTable::threadCount(int numRows) const {
+  return numRows >= MIN_PARALLEL_ROWS ? resolveThreadCount(numThreads) : 1;
+}
+
+/**
+ * @brief StencilTable::composeLevel Extends the table by one subdivision step.
+ * The stencil of a new vertex is the Loop stencil of that vertex, with every
+ * vertex of the current level replaced by its own stencil in the table.
+ * @param mesh The mesh at the current level of the table.
+ */
+void StencilTable::composeLevel(const Mesh& mesh) {
+  int numVerts = mesh.numVerts();
+  int numRows = numVerts + mesh.numEdges();
+  int threads = threadCount(numRows);
+  const int* offsetData = offsets.constData();
+  const int* columnData = columns.constData();
+  const float* weightData = weights.constData();
+
+  // One half-edge per edge, to find the edge points.
+  QVector<int> edgeHalfEdges(mesh.numEdges());
+  int* edgeHalfEdgeData = edgeHalfEdges.data();
+  parallelFor(0, mesh.numHalfEdges(), threads, [&](int begin, int end, int) {
+    for (int h = begin; h < end; ++h) {
+      if (h > mesh.twin(h)) {
+        edgeHalfEdgeData[mesh.edge(h)] = h;
+      }
+    }
+  });
+
+  // The new stencils of a contiguous range of vertices.
+  struct Chunk {
+    std::vector<int> sizes;
+    std::vector<int> columns;
+    std::vector<float> weights;
+  };
+  std::vector<Chunk> chunks(threads);
+
+  parallelFor(0, numRows, threads, [&](int begin, int end, int threadIdx) {
+    Chunk& chunk = chunks[threadIdx];
+    chunk.sizes.reserve(end - begin);
+    // Position of every control vertex within the stencil that is being
+    // composed; -1 if it is not part of it yet.
+    std::vector<int> position(controlVertexCount, -1);
+    std::vector<std::pair<int, double>> stencil;
+
+    auto addStencil = [&](int v, double weight) {
+      for (int k = offsetData[v]; k < offsetData[v + 1]; ++k) {
+        int c = columnData[k];
+        if (position[c] < 0) {
+          position[c] = stencil.size();
+          stencil.emplace_back(c, 0.0);
+        }
+        stencil[position[c]].second += weight * weightData[k];
+      }
+    };
+
+    for (int row = begin; row < end; ++row) {
+      if (row < numVerts) {
+        forEachVertexPointWeight(mesh, row, addStencil);
+      } else {
+        forEachEdgePointWeight(mesh, edgeHalfEdgeData[row - numVerts],
+                               addStencil);
+      }
+      std::sort(stencil.begin(), stencil.end());
+      chunk.sizes.push_back(stencil.size());
+      for (const std::pair<int, double>& entry : stencil) {
+        chunk.columns.push_back(entry.first);
+        chunk.weights.push_back(entry.second);
+        position[entry.first] = -1;
+      }
+      stencil.clear();
+    }
+  });
+
+  // Stitch the chunks together.
+  QVector<int> newOffsets(numRows + 1);
+  QVector<int> chunkOffsets(threads + 1, 0);
+  int row = 0;
+  newOffsets[0] = 0;
+  for (int t = 0; t < threads; ++t) {
+    for (int size : chunks[t].sizes) {
+      newOffsets[row + 1] = newOffsets[row] + size;
+      row++;
+    }
+    chunkOffsets[t + 1] = chunkOffsets[t] + chunks[t].columns.size();
+  }
+  QVector<int> newColumns(newOffsets[numRows]);
+  QVector<float> newWeights(newOffsets[numRows]);
+  int* newColumnData = newColumns.data();
+  float* newWeightData = newWeights.data();
+  parallelFor(0, threads, threads, [&](int begin, int end, int) {
+    for (int t = begin; t < end; ++t) {
+      std::copy(chunks[t].columns.begin(), chunks[t].columns.end(),
+                newColumnData + chunkOffsets[t]);
+      std::copy(chunks[t].weights.begin(), chunks[t].weights.end(),
+                newWeightData + chunkOffsets[t]);
+    }
+  });
+
+  offsets = newOffsets;
+  columns = newColumns;
+  weights = newWeights;
+  levelCount++;
+}
+
+/**
+ * @brief StencilTable::evaluate Computes the positions of the subdivided
+ * vertices from the positions of the control vertices.
+ * @param controlCoords The coordinates of the control vertices.
+ * @return The coordinates of the subdivided vertices. Empty if the number of
+ * control vertices does not match the table.
+ */
+QVector<QVector3D> StencilTable::evaluate(
+    const QVector<QVector3D>& controlCoords) const {
+  if (controlCoords.size() != controlVertexCount) {
+    qDebug() << ":: Stencil table expects" << controlVertexCount
+             << "control vertices, got" << controlCoords.size();
+    return QVector<QVector3D>();
+  }
+  QVector<QVector3D> coords(numVertices());
+  const QVector3D* control = controlCoords.constData();
+  QVector3D* output = coords.data();
+  int threads = threadCount(numVertices());
+  parallelFor(0, numVertices(), threads, [&](int begin, int end, int) {
+    for (int i = begin; i < end; ++i) {
+      QVector3D sum = {0.0f, 0.0f, 0.0f};
+      for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+        sum += weights[k] * control[columns[k]];
+      }
+      output[i] = sum;
+    }
+  });
+  return coords;
+}
+
+/**
+ * @brief StencilTable::apply Moves the vertices of a subdivided mesh to the
+ * positions that follow from the vertices of the control mesh. The topology of
+ * the subdivided mesh is left untouched; its attributes have to be extracted
+ * again afterwards.
+ * @param controlMesh The control mesh with the new vertex positions.
+ * @param refinedMesh The subdivided mesh to update.
+ * @return True if the meshes match the table; false otherwise.
+ */
+bool StencilTable::apply(const Mesh& controlMesh, Mesh& refinedMesh) const {
+  if (controlMesh.numVerts() != controlVertexCount ||
+      refinedMesh.numVerts() != numVertices()) {
+    qDebug() << ":: Stencil table does not match the meshes";
+    return false;
+  }
+  const float* const control[3] = {controlMesh.vertexX.constData(),
+                                   controlMesh.vertexY.constData(),
+                                   controlMesh.vertexZ.constData()};
+  float* const output[3] = {refinedMesh.vertexX.data(),
+                            refinedMesh.vertexY.data(),
+                            refinedMesh.vertexZ.data()};
+  int threads = threadCount(numVertices());
+  parallelFor(0, numVertices(), threads, [&](int begin, int end, int) {
+    for (int axis = 0; axis < 3; ++axis) {
+      const float* p = control[axis];
+      for (int i = begin; i < end; ++i) {
+        float sum = 0.0f;
+        for (int k = offsets[i]; k < offsets[i + 1]; ++k) {
+          sum += weights[k] * p[columns[k]];
+        }
+        output[axis][i] = sum;
+      }
+    }
+  });
+  return true;
+}
@@ -0,0 +1,51 @@
+#ifndef STENCIL_TABLE_H
+#define STENCIL_TABLE_H
+
+#include <QVector3D>
+#include <QVector>
+
+#include "mesh/mesh.h"
+
+/**
+ * @brief The StencilTable class expresses every vertex of a subdivision level
+ * as a weighted sum of the vertices of the control mesh. The table only
+ * depends on the topology of the control mesh, so once it is built, moving the
+ * control vertices around costs a single sparse matrix-vector product instead
+ * of a full subdivision per level.
+ *
+ * The weights are stored as a sparse matrix in compressed row format: the
+ * stencil of vertex i consists of the entries offsets[i] up to offsets[i + 1]
+ * of columns (control vertex indices) and weights. The tables are built by
+ * composing the Loop rules level by level. Evaluating a table gives the same
+ * positions as subdividing, up to floating-point rounding.
+ */
+class StencilTable {
+ public:
+  StencilTable();
+  void setNumThreads(int numThreads);
+
+  void build(const Mesh& controlMesh, int levels);
+  void clear();
+
+  bool isEmpty() const;
+  int numLevels() const;
+  int numControlVertices() const;
+  int numVertices() const;
+  int numWeights() const;
+
+  QVector<QVector3D> evaluate(const QVector<QVector3D>& controlCoords) const;
+  bool apply(const Mesh& controlMesh, Mesh& refinedMesh) const;
+
+ private:
+  void composeLevel(const Mesh& mesh);
+  int threadCount(int numRows) const;
+
+  QVector<int> offsets;
+  QVector<int> columns;
+  QVector<float> weights;
+  int controlVertexCount;
+  int levelCount;
+  int numThreads;
+};
+
+#endif  // STENCIL_TABLE_H
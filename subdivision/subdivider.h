@@ -3,6 +3,10 @@
 
 #include "mesh/mesh.h"
 
+// Every subdivision step quadruples the number of half-edges, so beyond this
+// many steps even a single triangle has more half-edges than an int can index.
+#define MAX_SUBDIVISION_LEVELS 14
+
 /**
  * @brief The Subdivider class is an abstract class that allows for subdividing
  * meshes.
@@ -10,7 +14,7 @@
 class Subdivider {
  public:
   virtual ~Subdivider();
-  virtual Mesh subdivide(Mesh& mesh) const = 0;
+  virtual Mesh subdivide(const Mesh& mesh) const = 0;
 };
 
 #endif  // SUBDIVIDER_H
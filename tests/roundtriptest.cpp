@@ -0,0 +1,66 @@
+#include <QFileInfo>
+#include <QTextStream>
+#include <cstring>
+
+#include "cli/subdivisionjob.h"
+#include "initialization/meshfile.h"
+#include "initialization/meshinitializer.h"
+
+/**
+ * @brief loadMesh Loads a mesh file without changing its coordinates.
+ * @param fileName Path of the file.
+ * @param mesh Is set to the loaded mesh.
+ * @return True if the file was loaded; false otherwise.
+ */
+static bool loadMesh(const QString& fileName, Mesh& mesh) {
+  std::unique_ptr<MeshFile> file = MeshFile::open(fileName, 0, false);
+  if (!file || !file->loadedSuccessfully()) {
+    return false;
+  }
+  MeshInitializer initializer;
+  mesh = initializer.constructHalfEdgeMesh(*file);
+  return true;
+}
+
+/**
+ * @brief main Runs every model passed on the command line through the batch
+ * pipeline without subdividing it, and checks that the exported vertices have
+ * exactly the coordinates of the input file.
+ * @param argc Argument count.
+ * @param argv The directory to write the results to, followed by the paths of
+ * the models to check.
+ * @return 0 if all coordinates are identical, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  QTextStream out(stdout);
+  bool passed = argc > 2;
+  SubdivisionJobRunner runner;
+  for (int i = 2; i < argc; i++) {
+    SubdivisionJob job;
+    job.input = argv[i];
+    job.output = QString("%1/%2.ply")
+                     .arg(argv[1], QFileInfo(job.input).completeBaseName());
+    job.levels = 0;
+    SubdivisionResult result = runner.run(job);
+    Mesh input;
+    Mesh output;
+    if (!result.success || !loadMesh(job.input, input) ||
+        !loadMesh(job.output, output)) {
+      out << QString("%1: round trip failed %2").arg(job.input, result.error)
+          << Qt::endl;
+      passed = false;
+      continue;
+    }
+    bool identical = input.numVerts() == output.numVerts();
+    for (int v = 0; identical && v < input.numVerts(); v++) {
+      QVector3D p = input.coords(v);
+      QVector3D q = output.coords(v);
+      identical = std::memcmp(&p, &q, sizeof(p)) == 0;
+    }
+    out << QString("%1: exported coordinates %2")
+               .arg(job.input, identical ? "match" : "differ")
+        << Qt::endl;
+    passed &= identical;
+  }
+  return passed ? 0 : 1;
+}
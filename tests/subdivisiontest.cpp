@@ -0,0 +1,267 @@
+#include <QSet>
+#include <QTextStream>
+#include <cstring>
+
+#include "initialization/meshinitializer.h"
+#include "initialization/objfile.h"
+#include "subdivision/adaptivesubdivider.h"
+#include "subdivision/blockedsubdivider.h"
+#include "subdivision/incrementalsubdivider.h"
+#include "subdivision/loopkernels.h"
+#include "subdivision/loopsubdivider.h"
+
+// Number of subdivision steps every model is checked at.
+#define TEST_LEVELS 4
+
+/**
+ * @brief firstDifference Compares two meshes bit for bit: the coordinates,
+ * valences and outgoing half-edges of the vertices, and the origins, twins
+ * and edges of the half-edges.
+ * @param expected The expected mesh.
+ * @param actual The mesh to check.
+ * @return A description of the first difference, or an empty string when the
+ * meshes are identical.
+ */
+static QString firstDifference(const Mesh& expected, const Mesh& actual) {
+  if (expected.numVerts() != actual.numVerts() ||
+      expected.numHalfEdges() != actual.numHalfEdges() ||
+      expected.numFaces() != actual.numFaces() ||
+      expected.numEdges() != actual.numEdges()) {
+    return "element counts differ";
+  }
+  for (int v = 0; v < expected.numVerts(); v++) {
+    QVector3D p = expected.coords(v);
+    QVector3D q = actual.coords(v);
+    if (std::memcmp(&p, &q, sizeof(p)) != 0) {
+      return QString("coordinates of vertex %1 differ").arg(v);
+    }
+    if (expected.valence(v) != actual.valence(v) ||
+        expected.out(v) != actual.out(v)) {
+      return QString("connectivity of vertex %1 differs").arg(v);
+    }
+  }
+  for (int h = 0; h < expected.numHalfEdges(); h++) {
+    if (expected.origin(h) != actual.origin(h) ||
+        expected.twin(h) != actual.twin(h) ||
+        expected.edge(h) != actual.edge(h)) {
+      return QString("half-edge %1 differs").arg(h);
+    }
+  }
+  return QString();
+}
+
+/**
+ * @brief check Reports whether a mesh matches the reference.
+ * @param out The stream to report to.
+ * @param model The model that was subdivided.
+ * @param level The number of subdivision steps.
+ * @param variant The subdivider that produced the mesh.
+ * @param expected The reference mesh.
+ * @param actual The mesh to check.
+ * @return True if the meshes are identical.
+ */
+static bool check(QTextStream& out, const QString& model, int level,
+                  const QString& variant, const Mesh& expected,
+                  const Mesh& actual) {
+  QString difference = firstDifference(expected, actual);
+  if (difference.isEmpty()) {
+    return true;
+  }
+  out << QString("%1, level %2, %3: %4")
+             .arg(model)
+             .arg(level)
+             .arg(variant, difference)
+      << Qt::endl;
+  return false;
+}
+
+/**
+ * @brief checkEquivalence Checks that every kernel set and BlockedSubdivider
+ * produce exactly the same meshes as repeatedly applying LoopSubdivider with
+ * the scalar kernels.
+ * @param out The stream to report to.
+ * @param model Name of the mesh.
+ * @param base The mesh to subdivide.
+ * @return True if all meshes are identical.
+ */
+static bool checkEquivalence(QTextStream& out, const QString& model,
+                             const Mesh& base) {
+  QVector<LoopKernels> kernels = supportedLoopKernels();
+  bool passed = true;
+  LoopSubdivider reference;
+  reference.setNumThreads(1);
+  reference.setKernels(kernels[0]);
+  QVector<Mesh> current(kernels.size(), base);
+  Mesh expected = base;
+  for (int level = 1; level <= TEST_LEVELS; level++) {
+    expected = reference.subdivide(expected);
+    for (int k = 0; k < kernels.size(); k++) {
+      LoopSubdivider subdivider;
+      subdivider.setKernels(kernels[k]);
+      current[k] = subdivider.subdivide(current[k]);
+      passed &= check(out, model, level,
+                      QString("%1 kernels").arg(kernels[k].name), expected,
+                      current[k]);
+    }
+    for (int threads : {1, 4}) {
+      BlockedSubdivider blocked;
+      blocked.setNumThreads(threads);
+      blocked.setLevels(level);
+      passed &= check(out, model, level,
+                      QString("blocked, %1 threads").arg(threads), expected,
+                      blocked.subdivide(base));
+    }
+  }
+  out << QString("%1: checked %2 kernel sets and the blocked subdivider up to "
+                 "level %3")
+             .arg(model)
+             .arg(kernels.size())
+             .arg(TEST_LEVELS)
+      << Qt::endl;
+  return passed;
+}
+
+/**
+ * @brief checkIncrementalEdit Moves a vertex of a mesh with
+ * IncrementalSubdivider, and checks that the updated levels are identical to
+ * subdividing the moved mesh from scratch and that the levels handed out
+ * before the edit are left untouched.
+ * @param out The stream to report to.
+ * @param model Name of the mesh.
+ * @param base The mesh to edit.
+ * @return True if the checks pass.
+ */
+static bool checkIncrementalEdit(QTextStream& out, const QString& model,
+                                 const Mesh& base) {
+  LoopSubdivider subdivider;
+  QVector<MeshHandle> levels = {MeshHandle(new Mesh(base))};
+  for (int level = 1; level <= 2; level++) {
+    levels.append(MeshHandle(new Mesh(subdivider.subdivide(*levels.last()))));
+  }
+  Mesh original = *levels.last();
+  IncrementalSubdivider incremental;
+  incremental.setLevels(levels);
+  incremental.moveVertices({0}, {base.coords(0) + QVector3D(0.1, 0.2, 0.3)});
+
+  Mesh expected = *incremental.level(0);
+  bool passed = check(out, model, 2, "original level", original,
+                      *levels.last());
+  for (int level = 1; level <= 2; level++) {
+    expected = subdivider.subdivide(expected);
+    passed &= check(out, model, level, "incremental edit", expected,
+                    *incremental.level(level));
+  }
+  return passed;
+}
+
+/**
+ * @brief checkPolygonMesh Checks the first subdivision step of a cube made of
+ * quads, which must be a consistent triangle mesh, and checks that a region
+ * of interest on the cube is refined in the children of its faces.
+ * @param out The stream to report to.
+ * @return True if the checks pass.
+ */
+static bool checkPolygonMesh(QTextStream& out) {
+  QVector<QVector3D> coords = {{-1, -1, -1}, {1, -1, -1}, {1, 1, -1},
+                               {-1, 1, -1},  {-1, -1, 1}, {1, -1, 1},
+                               {1, 1, 1},    {-1, 1, 1}};
+  QVector<int> indices = {0, 3, 2, 1, 4, 5, 6, 7, 0, 1, 5, 4,
+                          1, 2, 6, 5, 2, 3, 7, 6, 3, 0, 4, 7};
+  MeshInitializer initializer;
+  Mesh cube = initializer.constructHalfEdgeMesh(coords, QVector<int>(6, 4),
+                                                indices);
+  bool passed = checkEquivalence(out, "quad cube", cube);
+  passed &= checkIncrementalEdit(out, "quad cube", cube);
+
+  LoopSubdivider subdivider;
+  Mesh refined = subdivider.subdivide(cube);
+  LoopSubdivider::ElementCounts counts = LoopSubdivider::predictCounts(cube, 1);
+  bool consistent = refined.isTriangleMesh() &&
+                    refined.numVerts() == counts.numVertices &&
+                    refined.numHalfEdges() == counts.numHalfEdges &&
+                    refined.numFaces() == counts.numFaces &&
+                    refined.numEdges() == counts.numEdges;
+  for (int h = 0; consistent && h < refined.numHalfEdges(); h++) {
+    int twin = refined.twin(h);
+    consistent = twin >= 0 && refined.twin(twin) == h &&
+                 refined.edge(twin) == refined.edge(h) &&
+                 refined.origin(twin) == refined.origin(refined.next(h));
+  }
+  for (int v = 0; consistent && v < refined.numVerts(); v++) {
+    int count = 0;
+    for (int h : refined.outgoingHalfEdges(v)) {
+      consistent = consistent && refined.origin(h) == v;
+      count++;
+    }
+    consistent = consistent && count == refined.valence(v);
+  }
+  if (!consistent) {
+    out << "quad cube: the first level is not a consistent triangle mesh"
+        << Qt::endl;
+    return false;
+  }
+
+  // The region around a corner consists of three quads, which are split into
+  // six triangles each. Only those may reach the maximum level.
+  QVector<int> region = AdaptiveSubdivider::ringFaces(cube, {0}, 1);
+  QSet<int> regionVertices;
+  for (int f : region) {
+    for (int k = 0; k < cube.faceValence(f); k++) {
+      int h = cube.side(f) + k;
+      regionVertices.insert(cube.origin(h));
+      regionVertices.insert(cube.numVerts() + cube.edge(h));
+    }
+  }
+  AdaptiveSubdivider adaptive;
+  adaptive.setMaxLevel(3);
+  adaptive.setRegionOfInterest(LoopSubdivider::childFaces(cube, region));
+  QVector<int> levels = adaptive.faceLevels(refined);
+  int numRefined = 0;
+  bool inRegion = true;
+  for (int f = 0; f < levels.size(); f++) {
+    if (levels[f] < 3) {
+      continue;
+    }
+    numRefined++;
+    for (int k = 0; k < 3; k++) {
+      if (!regionVertices.contains(refined.origin(3 * f + k))) {
+        inRegion = false;
+      }
+    }
+  }
+  if (!inRegion || numRefined != 18) {
+    out << "quad cube: the region of interest is refined in the wrong faces"
+        << Qt::endl;
+    return false;
+  }
+  return passed;
+}
+
+/**
+ * @brief main Checks that every kernel set, BlockedSubdivider and
+ * IncrementalSubdivider produce exactly the same meshes as repeatedly
+ * applying LoopSubdivider with the scalar kernels, on every model passed on
+ * the command line and on a mesh made of quads.
+ * @param argc Argument count.
+ * @param argv Paths of the OBJ models to check.
+ * @return 0 if all checks pass, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+  QTextStream out(stdout);
+  bool passed = argc > 1;
+  for (int i = 1; i < argc; i++) {
+    QString model = argv[i];
+    OBJFile file(model);
+    if (!file.loadedSuccessfully()) {
+      out << QString("%1: failed to load").arg(model) << Qt::endl;
+      passed = false;
+      continue;
+    }
+    MeshInitializer initializer;
+    Mesh base = initializer.constructHalfEdgeMesh(file);
+    passed &= checkEquivalence(out, model, base);
+    passed &= checkIncrementalEdit(out, model, base);
+  }
+  passed &= checkPolygonMesh(out);
+  return passed ? 0 : 1;
+}
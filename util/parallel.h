@@ -0,0 +1,60 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QThread>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief resolveThreadCount Translates a requested thread count into the
+ * number of threads to actually use.
+ * @param requested The requested number of threads. Values smaller than 1
+ * select the number of cores of the machine.
+ * @return The number of threads to use. Always at least 1.
+ */
+inline int resolveThreadCount(int requested) {
+  if (requested < 1) {
+    return std::max(1, QThread::idealThreadCount());
+  }
+  return requested;
+}
+
+/**
+ * @brief parallelFor Splits the range [begin, end) into one contiguous chunk
+ * per thread and invokes body(chunkBegin, chunkEnd, threadIdx) for every
+ * chunk. The calling thread processes the first chunk itself and the function
+ * only returns once all chunks are done. Chunks never overlap, so the body may
+ * freely write to per-index output slots.
+ * @param begin Start of the range.
+ * @param end End of the range (exclusive).
+ * @param numThreads Number of threads to use. See resolveThreadCount.
+ * @param body The function to invoke for every chunk.
+ */
+template <typename Function>
+void parallelFor(int begin, int end, int numThreads, const Function& body) {
+  int count = end - begin;
+  if (count <= 0) {
+    return;
+  }
+  numThreads = std::min(resolveThreadCount(numThreads), count);
+  if (numThreads == 1) {
+    body(begin, end, 0);
+    return;
+  }
+
+  auto chunkStart = [=](int t) {
+    return begin + int(qint64(count) * t / numThreads);
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(numThreads - 1);
+  for (int t = 1; t < numThreads; ++t) {
+    workers.emplace_back(body, chunkStart(t), chunkStart(t + 1), t);
+  }
+  body(begin, chunkStart(1), 0);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+#endif  // PARALLEL_H